@@ -0,0 +1,549 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <print>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Generates the bindings of a flat message schema (host/common/flat_message.hpp): views and builders for the
+// host, and structs with accessors for the C and Zig plugins. A schema declares structs, each before its first use:
+//
+//   # Comment
+//   struct Point {
+//       i32 x;
+//       i32 y;
+//   }
+//
+// Field types are bool, i8 to i64, u8 to u64, f32, f64, string, earlier structs, and list<T> of any of these
+
+struct ScalarType {
+    std::string_view name;
+    std::string_view cpp;
+    std::string_view c;
+    uint32_t size;
+};
+
+constexpr ScalarType scalar_types[] = {
+    { "bool", "bool", "bool", 1 },
+    { "i8", "int8_t", "int8_t", 1 },
+    { "i16", "int16_t", "int16_t", 2 },
+    { "i32", "int32_t", "int32_t", 4 },
+    { "i64", "int64_t", "int64_t", 8 },
+    { "u8", "uint8_t", "uint8_t", 1 },
+    { "u16", "uint16_t", "uint16_t", 2 },
+    { "u32", "uint32_t", "uint32_t", 4 },
+    { "u64", "uint64_t", "uint64_t", 8 },
+    { "f32", "float", "float", 4 },
+    { "f64", "double", "double", 8 },
+};
+
+// Names the generated code uses itself, or that are keywords in one of the target languages
+constexpr std::string_view reserved_names[] = {
+    "address", "alignment", "and", "auto", "bool", "break", "builder", "case", "char", "class", "const", "continue",
+    "default", "delete", "do", "double", "else", "enum", "error", "export", "extern", "false", "float", "fn", "for",
+    "if", "inline", "int", "list", "long", "message", "new", "null", "offset", "or", "private", "pub", "register",
+    "return", "scalar", "set", "set_string", "short", "signed", "size", "static", "string", "struct", "structure",
+    "switch", "template", "test", "this", "true", "try", "type", "union", "unsigned", "var", "void", "while",
+};
+
+enum class ValueKind { Scalar, String, Struct };
+
+// A field's type without list<>
+struct ValueType {
+    ValueKind kind = ValueKind::Scalar;
+    const ScalarType* scalar = nullptr;
+    size_t structure = 0;
+};
+
+struct Field {
+    std::string name;
+    bool list = false;
+    ValueType type;
+    uint32_t offset = 0;
+};
+
+struct Struct {
+    std::string name;
+    std::vector<Field> fields;
+    uint32_t size = 0;
+    uint32_t alignment = 1;
+};
+
+struct Schema {
+    std::string file_name;
+    std::vector<Struct> structs;
+};
+
+struct Token {
+    std::string text;
+    size_t line;
+};
+
+static bool is_identifier(const std::string_view text) {
+    return !text.empty() && (std::isalpha(static_cast<unsigned char>(text[0])) || text[0] == '_') &&
+        std::ranges::all_of(text, [](const char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; });
+}
+
+static std::optional<std::vector<Token>> tokenize(const std::string_view path, const std::string_view source) {
+    std::vector<Token> tokens;
+    size_t line = 1;
+    for (size_t i = 0; i < source.size();) {
+        const char c = source[i];
+        if (c == '\n') {
+            line++;
+            i++;
+        }
+        else if (std::isspace(static_cast<unsigned char>(c))) {
+            i++;
+        }
+        else if (c == '#') {
+            while (i < source.size() && source[i] != '\n') {
+                i++;
+            }
+        }
+        else if (std::string_view("{}<>;").find(c) != std::string_view::npos) {
+            tokens.push_back({ std::string(1, c), line });
+            i++;
+        }
+        else if (std::isalnum(static_cast<unsigned char>(c)) || c == '_') {
+            const size_t start = i;
+            while (i < source.size() && (std::isalnum(static_cast<unsigned char>(source[i])) || source[i] == '_')) {
+                i++;
+            }
+            tokens.push_back({ std::string(source.substr(start, i - start)), line });
+        }
+        else {
+            std::println("ERROR: {}:{}: Unexpected character '{}'", path, line, c);
+            return std::nullopt;
+        }
+    }
+    return tokens;
+}
+
+static std::pair<uint32_t, uint32_t> value_layout(const Schema& schema, const ValueType& type) {
+    switch (type.kind) {
+    case ValueKind::Scalar:
+        return { type.scalar->size, type.scalar->size };
+    case ValueKind::String:
+        return { 8, 4 };
+    case ValueKind::Struct:
+        return { schema.structs[type.structure].size, schema.structs[type.structure].alignment };
+    }
+    return { 0, 1 };
+}
+
+class Parser {
+public:
+    Parser(std::string_view path, std::vector<Token> tokens) : path(path), tokens(std::move(tokens)) {}
+
+    std::optional<Schema> parse() {
+        Schema schema;
+        schema.file_name = std::filesystem::path(path).filename().string();
+        while (position < tokens.size()) {
+            if (!expect("struct")) {
+                return std::nullopt;
+            }
+            auto structure = parse_struct(schema);
+            if (!structure) {
+                return std::nullopt;
+            }
+            schema.structs.push_back(std::move(*structure));
+        }
+        if (schema.structs.empty()) {
+            std::println("ERROR: {}: Schema declares no structs", path);
+            return std::nullopt;
+        }
+        return schema;
+    }
+
+private:
+    std::optional<Struct> parse_struct(const Schema& schema) {
+        Struct structure;
+        const size_t name_token = position;
+        const auto name = identifier();
+        if (!name) {
+            return std::nullopt;
+        }
+        if (!std::isupper(static_cast<unsigned char>((*name)[0]))) {
+            return error_at(name_token, std::format("Struct name \"{}\" must start with an uppercase letter", *name));
+        }
+        if (find_struct(schema, *name)) {
+            return error_at(name_token, std::format("Struct \"{}\" is declared twice", *name));
+        }
+        structure.name = *name;
+        if (!expect("{")) {
+            return std::nullopt;
+        }
+        while (!peek("}")) {
+            const size_t field_token = position;
+            auto field = parse_field(schema);
+            if (!field) {
+                return std::nullopt;
+            }
+            const auto duplicate = std::ranges::find(structure.fields, field->name, &Field::name);
+            if (duplicate != structure.fields.end()) {
+                return error_at(field_token, std::format("Field \"{}\" is declared twice", field->name));
+            }
+            // Laid out like a C struct, so the plugins can use the generated structs as-is
+            const auto [size, alignment] = field->list ? std::pair { 8u, 4u } : value_layout(schema, field->type);
+            field->offset = (structure.size + alignment - 1) / alignment * alignment;
+            structure.size = field->offset + size;
+            structure.alignment = std::max(structure.alignment, alignment);
+            structure.fields.push_back(std::move(*field));
+        }
+        position++;
+        if (structure.fields.empty()) {
+            return error_at(name_token, std::format("Struct \"{}\" has no fields", structure.name));
+        }
+        structure.size = (structure.size + structure.alignment - 1) / structure.alignment * structure.alignment;
+        return structure;
+    }
+
+    std::optional<Field> parse_field(const Schema& schema) {
+        Field field;
+        size_t type_token = position;
+        const auto type_name = identifier();
+        if (!type_name) {
+            return std::nullopt;
+        }
+        std::string value_name = *type_name;
+        if (*type_name == "list") {
+            field.list = true;
+            type_token = position + 1;
+            const auto element = expect("<") ? identifier() : std::nullopt;
+            if (!element) {
+                return std::nullopt;
+            }
+            if (*element == "list") {
+                return error_at(type_token, "Lists of lists are not supported, wrap the inner list in a struct");
+            }
+            if (!expect(">")) {
+                return std::nullopt;
+            }
+            value_name = *element;
+        }
+        const auto type = resolve_type(schema, value_name);
+        if (!type) {
+            return error_at(type_token, std::format("Unknown type \"{}\", structs must be declared before they are used", value_name));
+        }
+        field.type = *type;
+        const size_t name_token = position;
+        const auto name = identifier();
+        if (!name || !expect(";")) {
+            return std::nullopt;
+        }
+        if (std::ranges::find(reserved_names, *name) != std::end(reserved_names) || name->starts_with("init_") || name->starts_with("set_")) {
+            return error_at(name_token, std::format("Field name \"{}\" is reserved", *name));
+        }
+        field.name = *name;
+        return field;
+    }
+
+    static std::optional<ValueType> resolve_type(const Schema& schema, const std::string_view name) {
+        if (name == "string") {
+            return ValueType { .kind = ValueKind::String };
+        }
+        const auto scalar = std::ranges::find(scalar_types, name, &ScalarType::name);
+        if (scalar != std::end(scalar_types)) {
+            return ValueType { .kind = ValueKind::Scalar, .scalar = &*scalar };
+        }
+        if (const auto structure = find_struct(schema, name)) {
+            return ValueType { .kind = ValueKind::Struct, .structure = *structure };
+        }
+        return std::nullopt;
+    }
+
+    static std::optional<size_t> find_struct(const Schema& schema, const std::string_view name) {
+        const auto found = std::ranges::find(schema.structs, name, &Struct::name);
+        if (found == schema.structs.end()) {
+            return std::nullopt;
+        }
+        return static_cast<size_t>(found - schema.structs.begin());
+    }
+
+    bool peek(const std::string_view text) const { return position < tokens.size() && tokens[position].text == text; }
+
+    bool expect(const std::string_view text) {
+        if (!peek(text)) {
+            error(std::format("Expected \"{}\"", text));
+            return false;
+        }
+        position++;
+        return true;
+    }
+
+    std::optional<std::string> identifier() {
+        if (position >= tokens.size() || !is_identifier(tokens[position].text)) {
+            return error("Expected a name");
+        }
+        return tokens[position++].text;
+    }
+
+    // Reports a problem with the token at `token`
+    std::nullopt_t error_at(const size_t token, const std::string_view message) const {
+        std::println("ERROR: {}:{}: {}", path, tokens[token].line, message);
+        return std::nullopt;
+    }
+
+    // Reports an unexpected token at the current position
+    std::nullopt_t error(const std::string_view message) const {
+        if (position < tokens.size()) {
+            std::println("ERROR: {}:{}: {}, found \"{}\"", path, tokens[position].line, message, tokens[position].text);
+        }
+        else {
+            std::println("ERROR: {}: {} at the end of the file", path, message);
+        }
+        return std::nullopt;
+    }
+
+    std::string_view path;
+    std::vector<Token> tokens;
+    size_t position = 0;
+};
+
+static std::string describe(const Schema& schema, const Field& field) {
+    std::string type;
+    switch (field.type.kind) {
+    case ValueKind::Scalar:
+        type = field.type.scalar->name;
+        break;
+    case ValueKind::String:
+        type = "string";
+        break;
+    case ValueKind::Struct:
+        type = schema.structs[field.type.structure].name;
+        break;
+    }
+    return field.list ? std::format("list<{}>", type) : type;
+}
+
+// Type of a list element or struct field in the host bindings
+static std::string cpp_type(const Schema& schema, const ValueType& type, const std::string_view suffix) {
+    switch (type.kind) {
+    case ValueKind::Scalar:
+        return std::string(type.scalar->cpp);
+    case ValueKind::String:
+        return "FlatString";
+    case ValueKind::Struct:
+        return schema.structs[type.structure].name + std::string(suffix);
+    }
+    return {};
+}
+
+static std::string generate_cpp(const Schema& schema) {
+    std::string out = std::format("// Generated by plugin_bindgen from {}, do not edit\n#pragma once\n\n#include \"flat_message.hpp\"\n", schema.file_name);
+    for (const auto& structure : schema.structs) {
+        const auto& name = structure.name;
+        std::format_to(std::back_inserter(out),
+            "\nclass {}View : public FlatView {{\npublic:\n    static constexpr uint32_t size = {};\n    static constexpr uint32_t alignment = {};\n\n    using FlatView::FlatView;\n\n",
+            name, structure.size, structure.alignment);
+        for (const auto& field : structure.fields) {
+            const auto type = cpp_type(schema, field.type, "View");
+            if (field.list) {
+                std::format_to(std::back_inserter(out), "    std::optional<FlatList<{}>> {}() const {{ return list<{}>({}); }}\n", type, field.name, type, field.offset);
+            }
+            else if (field.type.kind == ValueKind::String) {
+                std::format_to(std::back_inserter(out), "    std::optional<std::string_view> {}() const {{ return string({}); }}\n", field.name, field.offset);
+            }
+            else if (field.type.kind == ValueKind::Struct) {
+                std::format_to(std::back_inserter(out), "    {} {}() const {{ return structure<{}>({}); }}\n", type, field.name, type, field.offset);
+            }
+            else {
+                std::format_to(std::back_inserter(out), "    {} {}() const {{ return scalar<{}>({}); }}\n", type, field.name, type, field.offset);
+            }
+        }
+        out += "};\n";
+
+        std::format_to(std::back_inserter(out),
+            "\nclass {}Builder : public FlatStructBuilder {{\npublic:\n    static constexpr uint32_t size = {};\n    static constexpr uint32_t alignment = {};\n\n    using FlatStructBuilder::FlatStructBuilder;\n\n",
+            name, structure.size, structure.alignment);
+        for (const auto& field : structure.fields) {
+            const auto type = cpp_type(schema, field.type, "Builder");
+            if (field.list) {
+                std::format_to(std::back_inserter(out), "    FlatListBuilder<{}> init_{}(const uint32_t count) const {{ return list<{}>({}, count); }}\n", type, field.name, type, field.offset);
+            }
+            else if (field.type.kind == ValueKind::String) {
+                std::format_to(std::back_inserter(out), "    void set_{}(const std::string_view value) const {{ set_string({}, value); }}\n", field.name, field.offset);
+            }
+            else if (field.type.kind == ValueKind::Struct) {
+                std::format_to(std::back_inserter(out), "    {} {}() const {{ return structure<{}>({}); }}\n", type, field.name, type, field.offset);
+            }
+            else {
+                std::format_to(std::back_inserter(out), "    void set_{}(const {} value) const {{ set<{}>({}, value); }}\n", field.name, type, type, field.offset);
+            }
+        }
+        out += "};\n";
+    }
+    return out;
+}
+
+// Type of a list element or struct field in the C bindings
+static std::string c_type(const Schema& schema, const ValueType& type) {
+    switch (type.kind) {
+    case ValueKind::Scalar:
+        return std::string(type.scalar->c);
+    case ValueKind::String:
+        return "flat_ref";
+    case ValueKind::Struct:
+        return schema.structs[type.structure].name;
+    }
+    return {};
+}
+
+static std::string generate_c(const Schema& schema, const std::string_view guard) {
+    std::string out = std::format("// Generated by plugin_bindgen from {}, do not edit\n#ifndef {}\n#define {}\n\n#include <stdbool.h>\n\n#include \"plugin_flat.h\"\n", schema.file_name, guard, guard);
+    for (const auto& structure : schema.structs) {
+        const auto& name = structure.name;
+        std::format_to(std::back_inserter(out), "\ntypedef struct {} {{\n", name);
+        for (const auto& field : structure.fields) {
+            if (field.list || field.type.kind == ValueKind::String) {
+                std::format_to(std::back_inserter(out), "    flat_ref {}; // {}\n", field.name, describe(schema, field));
+            }
+            else {
+                std::format_to(std::back_inserter(out), "    {} {};\n", c_type(schema, field.type), field.name);
+            }
+        }
+        std::format_to(std::back_inserter(out), "}} {};\n\n_Static_assert(sizeof({}) == {}", name, name, structure.size);
+        for (const auto& field : structure.fields) {
+            std::format_to(std::back_inserter(out), " && offsetof({}, {}) == {}", name, field.name, field.offset);
+        }
+        out += ", \"layout must match the host's\");\n";
+
+        std::format_to(std::back_inserter(out), "\nstatic inline {}* {}_new(plugin_arena* arena) {{\n    return flat_new(arena, sizeof({}), _Alignof({}));\n}}\n", name, name, name, name);
+        for (const auto& field : structure.fields) {
+            if (field.list) {
+                const auto type = c_type(schema, field.type);
+                std::format_to(std::back_inserter(out),
+                    "\nstatic inline const {}* {}_{}(const {}* message, uint32_t* count) {{\n    return flat_list(&message->{}, count);\n}}\n",
+                    type, name, field.name, name, field.name);
+                std::format_to(std::back_inserter(out),
+                    "\nstatic inline {}* {}_init_{}({}* message, plugin_arena* arena, const uint32_t count) {{\n    return flat_init_list(&message->{}, arena, sizeof({}), _Alignof({}), count);\n}}\n",
+                    type, name, field.name, name, field.name, type, type);
+            }
+            else if (field.type.kind == ValueKind::String) {
+                std::format_to(std::back_inserter(out),
+                    "\nstatic inline const char* {}_{}(const {}* message, uint32_t* length) {{\n    return flat_string(&message->{}, length);\n}}\n",
+                    name, field.name, name, field.name);
+                std::format_to(std::back_inserter(out),
+                    "\nstatic inline int {}_set_{}({}* message, plugin_arena* arena, const char* value, const uint32_t length) {{\n    return flat_set_string(&message->{}, arena, value, length);\n}}\n",
+                    name, field.name, name, field.name);
+            }
+        }
+    }
+    out += "\n#endif\n";
+    return out;
+}
+
+// Type of a list element or struct field in the Zig bindings
+static std::string zig_type(const Schema& schema, const ValueType& type) {
+    switch (type.kind) {
+    case ValueKind::Scalar:
+        return std::string(type.scalar->name);
+    case ValueKind::String:
+        return "flat.String";
+    case ValueKind::Struct:
+        return schema.structs[type.structure].name;
+    }
+    return {};
+}
+
+static std::string generate_zig(const Schema& schema) {
+    std::string out = std::format("// Generated by plugin_bindgen from {}, do not edit\nconst std = @import(\"std\");\nconst flat = @import(\"flat.zig\");\n", schema.file_name);
+    for (const auto& structure : schema.structs) {
+        std::format_to(std::back_inserter(out), "\npub const {} = extern struct {{\n", structure.name);
+        for (const auto& field : structure.fields) {
+            const auto type = zig_type(schema, field.type);
+            std::format_to(std::back_inserter(out), "    {}: {},\n", field.name, field.list ? std::format("flat.List({})", type) : type);
+        }
+        out += "};\n";
+    }
+    out += "\ncomptime {\n";
+    for (const auto& structure : schema.structs) {
+        std::format_to(std::back_inserter(out), "    std.debug.assert(@sizeOf({}) == {});\n", structure.name, structure.size);
+        for (const auto& field : structure.fields) {
+            std::format_to(std::back_inserter(out), "    std.debug.assert(@offsetOf({}, \"{}\") == {});\n", structure.name, field.name, field.offset);
+        }
+    }
+    out += "}\n";
+    return out;
+}
+
+static bool write_file(const std::filesystem::path& path, const std::string_view text) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file || !file.write(text.data(), static_cast<std::streamsize>(text.size()))) {
+        std::println("ERROR: Failed to write \"{}\"", path.string());
+        return false;
+    }
+    return true;
+}
+
+// Header guard of a generated C header, e.g. POINTS_SCHEMA_H for points_schema.h
+static std::string header_guard(const std::filesystem::path& path) {
+    std::string guard;
+    for (const char c : path.filename().string()) {
+        guard += std::isalnum(static_cast<unsigned char>(c)) ? static_cast<char>(std::toupper(static_cast<unsigned char>(c))) : '_';
+    }
+    return guard;
+}
+
+int main(int argc, char** argv) {
+    std::filesystem::path schema_path;
+    std::filesystem::path cpp_path;
+    std::filesystem::path c_path;
+    std::filesystem::path zig_path;
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if (arg.starts_with("--cpp=")) {
+            cpp_path = arg.substr(std::string_view("--cpp=").size());
+        }
+        else if (arg.starts_with("--c=")) {
+            c_path = arg.substr(std::string_view("--c=").size());
+        }
+        else if (arg.starts_with("--zig=")) {
+            zig_path = arg.substr(std::string_view("--zig=").size());
+        }
+        else if (schema_path.empty() && !arg.starts_with("--")) {
+            schema_path = arg;
+        }
+        else {
+            schema_path.clear();
+            break;
+        }
+    }
+    if (schema_path.empty() || (cpp_path.empty() && c_path.empty() && zig_path.empty())) {
+        std::println("Usage: {} <schema> [--cpp=<file.hpp>] [--c=<file.h>] [--zig=<file.zig>]", argv[0]);
+        return 1;
+    }
+
+    std::ifstream file(schema_path, std::ios::binary);
+    if (!file) {
+        std::println("ERROR: Failed to open schema \"{}\"", schema_path.string());
+        return 1;
+    }
+    std::stringstream source;
+    source << file.rdbuf();
+
+    const auto path = schema_path.string();
+    auto tokens = tokenize(path, source.str());
+    const auto schema = tokens ? Parser(path, std::move(*tokens)).parse() : std::nullopt;
+    if (!schema) {
+        return 1;
+    }
+    if (!cpp_path.empty() && !write_file(cpp_path, generate_cpp(*schema))) {
+        return 1;
+    }
+    if (!c_path.empty() && !write_file(c_path, generate_c(*schema, header_guard(c_path)))) {
+        return 1;
+    }
+    if (!zig_path.empty() && !write_file(zig_path, generate_zig(*schema))) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <print>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct BenchScenario {
+    std::string_view name;
+    // Number of timed samples, percentiles are computed over these
+    size_t samples = 1000;
+    // Invocations per sample. Batching amortizes the clock reads for operations that take nanoseconds
+    size_t batch = 1;
+    // Operations a single invocation performs, e.g. host calls made by one guest loop
+    size_t ops_per_invocation = 1;
+};
+
+// Writes one JSON object per scenario and line, so runs can be diffed and tracked over time
+class BenchReport {
+public:
+    explicit BenchReport(const std::filesystem::path& output_path) : output(output_path) {}
+
+    bool is_open() const { return output.is_open(); }
+
+    // Engine the following scenarios run on, a single report can compare several
+    void set_engine(const std::string_view name, const std::string_view version) {
+        engine = name;
+        engine_version = version;
+    }
+
+    // Times `invoke()` according to `scenario`. A failed invocation aborts the scenario and is reported instead
+    template<typename Invoke>
+    void run(const std::string_view plugin, const BenchScenario& scenario, Invoke&& invoke) {
+        using clock = std::chrono::steady_clock;
+        std::vector<double> ns_per_op;
+        ns_per_op.reserve(scenario.samples);
+        const double ops_per_sample = static_cast<double>(scenario.batch * scenario.ops_per_invocation);
+        for (size_t sample = 0; sample < scenario.samples; sample++) {
+            const auto start = clock::now();
+            for (size_t i = 0; i < scenario.batch; i++) {
+                if (!invoke()) {
+                    std::println("ERROR: Scenario {} failed for plugin {}", scenario.name, plugin);
+                    write_line(R"("status":"failed")", plugin, scenario.name);
+                    return;
+                }
+            }
+            const auto elapsed = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+            ns_per_op.push_back(elapsed / ops_per_sample);
+        }
+        record(plugin, scenario.name, std::move(ns_per_op), ops_per_sample);
+    }
+
+    // Reports samples measured elsewhere, e.g. by the engine itself, like a scenario run with run()
+    void record(const std::string_view plugin, const std::string_view scenario, std::vector<double> ns_per_op, const double ops_per_sample = 1) {
+        if (ns_per_op.empty()) {
+            skip(plugin, scenario, "no samples");
+            return;
+        }
+        std::ranges::sort(ns_per_op);
+        double total = 0;
+        for (const double value : ns_per_op) {
+            total += value;
+        }
+        const auto percentile = [&](const double p) {
+            return ns_per_op[std::min(ns_per_op.size() - 1, static_cast<size_t>(p * static_cast<double>(ns_per_op.size())))];
+        };
+        write_line(std::format(R"("status":"ok","ops":{},"ns_per_op":{:.1f},"p50_ns":{:.1f},"p90_ns":{:.1f},"p99_ns":{:.1f},"min_ns":{:.1f},"max_ns":{:.1f})",
+            static_cast<size_t>(ops_per_sample) * ns_per_op.size(), total / static_cast<double>(ns_per_op.size()),
+            percentile(0.5), percentile(0.9), percentile(0.99), ns_per_op.front(), ns_per_op.back()), plugin, scenario);
+    }
+
+    void skip(const std::string_view plugin, const std::string_view scenario, const std::string_view reason) {
+        write_line(std::format(R"("status":"skipped","reason":"{}")", escape(reason)), plugin, scenario);
+    }
+
+private:
+    static std::string escape(const std::string_view text) {
+        std::string escaped;
+        for (const char c : text) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+                escaped += c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20) {
+                escaped += std::format("\\u{:04x}", static_cast<int>(c));
+            }
+            else {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+
+    void write_line(const std::string_view fields, const std::string_view plugin, const std::string_view scenario) {
+        const auto line = std::format(R"({{"engine":"{}","engine_version":"{}","plugin":"{}","scenario":"{}",{}}})",
+            escape(engine), escape(engine_version), escape(plugin), escape(scenario), fields);
+        std::println(output, "{}", line);
+        output.flush();
+        std::println("{}", line);
+    }
+
+    std::ofstream output;
+    std::string engine;
+    std::string engine_version;
+};
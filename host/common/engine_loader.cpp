@@ -0,0 +1,50 @@
+#include "engine_loader.hpp"
+
+#include <filesystem>
+#include <format>
+#include <print>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+static std::filesystem::path executable_directory() {
+#ifdef _WIN32
+    std::wstring path(MAX_PATH, L'\0');
+    path.resize(GetModuleFileNameW(nullptr, path.data(), static_cast<DWORD>(path.size())));
+    return std::filesystem::path(path).parent_path();
+#else
+    return std::filesystem::read_symlink("/proc/self/exe").parent_path();
+#endif
+}
+
+std::unique_ptr<PluginEngine> load_plugin_engine(const std::string_view backend, const EngineSettings& settings) {
+#ifdef _WIN32
+    const auto module_path = executable_directory() / std::format("plugin_engine_{}.dll", backend);
+    const HMODULE module = LoadLibraryW(module_path.c_str());
+    const auto create = module ? reinterpret_cast<CreatePluginEngineFn>(GetProcAddress(module, create_plugin_engine_symbol)) : nullptr;
+    const std::string load_error = create ? "" : std::format("error {}", GetLastError());
+#else
+    const auto module_path = executable_directory() / std::format("plugin_engine_{}.so", backend);
+    // Local binding keeps each module's engine library private, both define the same wasm C API symbols
+    void* module = dlopen(module_path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    const auto create = module ? reinterpret_cast<CreatePluginEngineFn>(dlsym(module, create_plugin_engine_symbol)) : nullptr;
+    // Says why dlopen failed, like a missing engine library, or that the entry point is missing
+    const char* dl_error = create ? nullptr : dlerror();
+    const std::string load_error = dl_error ? dl_error : "";
+#endif
+    if (!create) {
+        std::println("ERROR: Failed to load engine module \"{}\": {}", module_path.string(), load_error);
+        return nullptr;
+    }
+    std::unique_ptr<PluginEngine> engine(create(plugin_engine_abi_version, settings));
+    if (!engine) {
+        std::println("ERROR: Engine module \"{}\" failed to create an engine", module_path.string());
+    }
+    return engine;
+}
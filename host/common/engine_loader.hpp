@@ -0,0 +1,10 @@
+#pragma once
+
+#include <memory>
+#include <string_view>
+
+#include "plugin_host.hpp"
+
+// Loads the `plugin_engine_<backend>` module next to the executable and creates its engine.
+// Modules stay loaded for the lifetime of the process
+std::unique_ptr<PluginEngine> load_plugin_engine(std::string_view backend, const EngineSettings& settings);
@@ -0,0 +1,107 @@
+#include "event_loop.hpp"
+
+#include <exception>
+
+// Owns a spawned task and destroys itself once the task has finished
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() { return { std::coroutine_handle<promise_type>::from_promise(*this) }; }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+static DetachedTask run_detached(Task<void> task, size_t& active_tasks) {
+    co_await task;
+    active_tasks--;
+}
+
+void EventLoop::spawn(Task<void> task) {
+    active_tasks++;
+    ready.push_back(run_detached(std::move(task), active_tasks).handle);
+}
+
+void EventLoop::post(const std::coroutine_handle<> handle) {
+    {
+        std::lock_guard lock(posted_mutex);
+        posted.push_back(handle);
+    }
+    posted_changed.notify_one();
+}
+
+void EventLoop::resume_at(const clock::time_point time, const std::coroutine_handle<> handle) {
+    timers.push({ time, handle });
+}
+
+void EventLoop::start_call(InFlightCall& call) {
+    runnable.push_back(&call);
+}
+
+void EventLoop::wake(InFlightCall& call) {
+    call.blocked = false;
+    // A host import that finished during the poll that started it is picked up when that poll returns
+    if (!call.polling) {
+        runnable.push_back(&call);
+    }
+}
+
+void EventLoop::poll(InFlightCall& call) {
+    call.polling = true;
+    polling = &call;
+    const bool done = call.call->poll();
+    polling = nullptr;
+    call.polling = false;
+    if (done) {
+        ready.push_back(call.waiter);
+    }
+    else if (!call.blocked) {
+        // The guest yielded, or the import it waited on finished while it was being polled
+        runnable.push_back(&call);
+    }
+}
+
+void EventLoop::run() {
+    while (true) {
+        {
+            std::lock_guard lock(posted_mutex);
+            ready.insert(ready.end(), posted.begin(), posted.end());
+            posted.clear();
+        }
+        const auto now = clock::now();
+        while (!timers.empty() && timers.top().time <= now) {
+            ready.push_back(timers.top().handle);
+            timers.pop();
+        }
+
+        if (!ready.empty() || !runnable.empty()) {
+            // Resume what was ready at the start of the turn, then give every runnable call one poll
+            for (size_t count = ready.size(); count > 0; count--) {
+                const auto handle = ready.front();
+                ready.pop_front();
+                handle.resume();
+            }
+            for (size_t count = runnable.size(); count > 0; count--) {
+                InFlightCall* call = runnable.front();
+                runnable.pop_front();
+                poll(*call);
+            }
+            continue;
+        }
+        if (active_tasks == 0) {
+            return;
+        }
+
+        // Everything is waiting on a timer or on another thread
+        std::unique_lock lock(posted_mutex);
+        if (timers.empty()) {
+            posted_changed.wait(lock, [&] { return !posted.empty(); });
+        }
+        else {
+            posted_changed.wait_until(lock, timers.top().time, [&] { return !posted.empty(); });
+        }
+    }
+}
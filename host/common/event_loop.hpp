@@ -0,0 +1,157 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "host_imports.hpp"
+#include "plugin_host.hpp"
+#include "plugin_values.hpp"
+#include "task.hpp"
+
+// A plugin call the event loop polls on behalf of the coroutine awaiting it
+struct InFlightCall {
+    PendingCall* call = nullptr;
+    std::coroutine_handle<> waiter;
+    // Set while the guest waits on an async host import, which wakes the call once it finishes
+    bool blocked = false;
+    bool polling = false;
+};
+
+// Single-threaded loop that multiplexes coroutines and in-flight plugin calls. A call is only polled when it can
+// make progress: when it starts, after a host import it waits on finishes, or after the guest yields
+class EventLoop {
+public:
+    using clock = std::chrono::steady_clock;
+
+    EventLoop() = default;
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // Runs `task` on the loop until it finishes
+    void spawn(Task<void> task);
+
+    // Runs until every spawned task has finished
+    void run();
+
+    // Resumes `handle` on the loop thread. Safe to call from any thread, e.g. when I/O completes
+    void post(std::coroutine_handle<> handle);
+
+    void resume_at(clock::time_point time, std::coroutine_handle<> handle);
+
+    // Awaitable that resumes the caller once `delay` has passed
+    auto sleep_for(const clock::duration delay) {
+        struct Awaiter {
+            EventLoop& loop;
+            clock::time_point time;
+
+            bool await_ready() const { return time <= clock::now(); }
+            void await_suspend(const std::coroutine_handle<> handle) { loop.resume_at(time, handle); }
+            void await_resume() {}
+        };
+        return Awaiter { *this, clock::now() + delay };
+    }
+
+    // Polls `call` until it is done, then resumes its waiter. `call` must stay alive until then
+    void start_call(InFlightCall& call);
+
+    // The call being polled right now, async host imports started by its guest block it until they finish
+    InFlightCall* current_call() const { return polling; }
+
+    void wake(InFlightCall& call);
+
+private:
+    struct Timer {
+        clock::time_point time;
+        std::coroutine_handle<> handle;
+
+        bool operator>(const Timer& other) const { return time > other.time; }
+    };
+
+    void poll(InFlightCall& call);
+
+    size_t active_tasks = 0;
+    std::deque<std::coroutine_handle<>> ready;
+    std::deque<InFlightCall*> runnable;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<>> timers;
+    InFlightCall* polling = nullptr;
+
+    std::mutex posted_mutex;
+    std::condition_variable posted_changed;
+    std::vector<std::coroutine_handle<>> posted;
+};
+
+template<typename Signature>
+struct AsyncHostFnAdapter;
+
+// Runs a coroutine host import on the event loop while the guest that called it stays suspended
+template<typename R, typename... Args>
+struct AsyncHostFnAdapter<R(Args...)> {
+    class Call final : public PendingHostCall {
+    public:
+        bool poll(const std::span<PluginValue> results) override {
+            if (!done) {
+                return false;
+            }
+            if constexpr (!std::is_void_v<R>) {
+                results[0] = result;
+            }
+            return true;
+        }
+
+        Task<void> drive(EventLoop& loop, InFlightCall* caller, Task<R> task) {
+            if constexpr (std::is_void_v<R>) {
+                co_await task;
+            }
+            else {
+                store_value(result, co_await task);
+            }
+            done = true;
+            if (caller) {
+                loop.wake(*caller);
+            }
+        }
+
+        Task<void> driver;
+        PluginValue result {};
+        bool done = false;
+    };
+
+    template<typename F>
+    static AsyncHostFn wrap(EventLoop& loop, F fn) {
+        return [&loop, fn = std::move(fn)](const std::span<const PluginValue> args) -> std::unique_ptr<PendingHostCall> {
+            return start(loop, fn, args, std::index_sequence_for<Args...> {});
+        };
+    }
+
+private:
+    template<typename F, size_t... I>
+    static std::unique_ptr<PendingHostCall> start(EventLoop& loop, const F& fn, const std::span<const PluginValue> args, std::index_sequence<I...>) {
+        auto call = std::make_unique<Call>();
+        InFlightCall* caller = loop.current_call();
+        if (caller) {
+            caller->blocked = true;
+        }
+        call->driver = call->drive(loop, caller, fn(load_value<Args>(args[I])...));
+        // Runs up to the task's first suspension right here, on the guest's stack
+        call->driver.coroutine().resume();
+        return call;
+    }
+};
+
+// Adapts `fn(Args...) -> Task<R>` into an async host import for HostImports. Plugins waiting on it only make
+// progress while `loop` runs, so calls into them must be awaited on that loop
+template<typename Signature, typename F>
+AsyncHostFn async_host_fn(EventLoop& loop, F&& fn) {
+    return AsyncHostFnAdapter<Signature>::wrap(loop, std::forward<F>(fn));
+}
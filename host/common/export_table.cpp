@@ -0,0 +1,46 @@
+#include "export_table.hpp"
+
+#include <algorithm>
+#include <print>
+
+#include "wasm_types.hpp"
+
+std::optional<uint32_t> ExportTable::find_function(const std::string_view name, const FunctionSignature& signature) const {
+    const auto found = function_indices.find(std::string(name));
+    if (found == function_indices.end()) {
+        return std::nullopt;
+    }
+    if (functions[found->second]->signature != signature) {
+        std::println("ERROR: Plugin function {} has an unexpected signature", name);
+        return std::nullopt;
+    }
+    return found->second;
+}
+
+ExportTable read_export_table(const wasm_exporttype_vec_t& exports) {
+    ExportTable table;
+    table.functions.resize(exports.size);
+    for (size_t i = 0; i < exports.size; i++) {
+        const wasm_name_t* export_name = wasm_exporttype_name(exports.data[i]);
+        std::string name { export_name->data, export_name->size };
+        const wasm_externtype_t* type = wasm_exporttype_type(exports.data[i]);
+        const auto index = static_cast<uint32_t>(i);
+        if (wasm_externtype_kind(type) == WASM_EXTERN_MEMORY) {
+            if (name == "memory") {
+                table.memory_index = index;
+            }
+            continue;
+        }
+        if (wasm_externtype_kind(type) != WASM_EXTERN_FUNC) {
+            continue;
+        }
+        auto signature = signature_of_functype(wasm_externtype_as_functype_const(type));
+        if (!signature || std::max(signature->params.size(), signature->results.size()) > max_call_slots) {
+            // Reference and vector types have no PluginValue representation
+            continue;
+        }
+        table.function_indices.emplace(name, index);
+        table.functions[i] = ExportTable::Function { std::move(name), std::move(*signature) };
+    }
+    return table;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <wasm.h>
+
+#include "plugin_host.hpp"
+
+// Exports of a compiled module, indexed in module order. Instances list their exports in the same order,
+// so every session resolves an index positionally instead of by name
+struct ExportTable {
+    struct Function {
+        std::string name;
+        FunctionSignature signature;
+    };
+
+    // One entry per export, empty for exports that are not callable functions
+    std::vector<std::optional<Function>> functions;
+    std::unordered_map<std::string, uint32_t> function_indices;
+    std::optional<uint32_t> memory_index;
+
+    std::optional<uint32_t> find_function(std::string_view name, const FunctionSignature& signature) const;
+};
+
+ExportTable read_export_table(const wasm_exporttype_vec_t& exports);
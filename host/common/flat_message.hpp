@@ -0,0 +1,342 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "guest_memory.hpp"
+
+// Structured arguments and results that host and plugin read in place, without decoding them first. The structs
+// of a message are described in a schema, from which plugin_bindgen (host/bindgen) generates views and builders
+// for the host and plain structs for the C and Zig plugins. The layout matches plugins/c/plugin_flat.h and
+// plugins/zig/flat.zig:
+//
+//   scalars          little-endian and naturally aligned
+//   structs          fields in declaration order, laid out like a C struct
+//   string, list<T>  8-byte reference: i32 offset from the reference to the first element, u32 element count.
+//                    Strings count bytes and are followed by a NUL that the count leaves out
+//
+// Views check every reference against the bounds of the message before following it, so a message the plugin
+// built can be read as safely as one the host built
+
+static_assert(std::endian::native == std::endian::little);
+
+constexpr uint32_t flat_ref_size = 8;
+constexpr uint32_t flat_ref_alignment = 4;
+
+// Element type of a list<string>
+struct FlatString {};
+
+template<typename T>
+class FlatList;
+
+// Size and alignment of a list element, and how to read one
+template<typename T>
+struct FlatTraits;
+
+class FlatView {
+public:
+    FlatView() = default;
+    FlatView(const std::span<const uint8_t> message, const uint32_t offset) : message(message), offset(offset) {}
+
+protected:
+    template<typename T>
+    T scalar(const uint32_t field) const { return FlatTraits<T>::read(message, offset + field); }
+
+    template<typename T>
+    T structure(const uint32_t field) const { return T(message, offset + field); }
+
+    std::optional<std::string_view> string(uint32_t field) const;
+
+    template<typename T>
+    std::optional<FlatList<T>> list(const uint32_t field) const { return FlatTraits<FlatList<T>>::read(message, offset + field); }
+
+    std::span<const uint8_t> message;
+    uint32_t offset = 0;
+};
+
+// Offset and count of the elements the reference at `ref` points to, or nullopt if they are not all inside the
+// message
+inline std::optional<std::pair<uint32_t, uint32_t>> flat_resolve(const std::span<const uint8_t> message, const uint32_t ref, const uint32_t element_size) {
+    int32_t relative;
+    uint32_t count;
+    std::memcpy(&relative, message.data() + ref, sizeof(relative));
+    std::memcpy(&count, message.data() + ref + sizeof(relative), sizeof(count));
+    if (count == 0) {
+        return std::pair { ref, 0u };
+    }
+    const int64_t target = int64_t { ref } + relative;
+    if (target < 0 || static_cast<uint64_t>(target) + uint64_t { count } * element_size > message.size()) {
+        return std::nullopt;
+    }
+    return std::pair { static_cast<uint32_t>(target), count };
+}
+
+template<typename T>
+class FlatList {
+public:
+    class Iterator {
+    public:
+        Iterator(const FlatList& list, const uint32_t index) : list(&list), index(index) {}
+
+        auto operator*() const { return (*list)[index]; }
+        Iterator& operator++() {
+            index++;
+            return *this;
+        }
+        bool operator==(const Iterator& other) const { return index == other.index; }
+
+    private:
+        const FlatList* list;
+        uint32_t index;
+    };
+
+    FlatList() = default;
+    FlatList(const std::span<const uint8_t> message, const uint32_t offset, const uint32_t count) : message(message), offset(offset), count(count) {}
+
+    uint32_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    auto operator[](const uint32_t index) const { return FlatTraits<T>::read(message, offset + index * FlatTraits<T>::size); }
+
+    Iterator begin() const { return { *this, 0 }; }
+    Iterator end() const { return { *this, count }; }
+
+private:
+    std::span<const uint8_t> message;
+    uint32_t offset = 0;
+    uint32_t count = 0;
+};
+
+template<typename T>
+    requires std::is_arithmetic_v<T>
+struct FlatTraits<T> {
+    static constexpr uint32_t size = sizeof(T);
+    static constexpr uint32_t alignment = alignof(T);
+
+    static T read(const std::span<const uint8_t> message, const uint32_t offset) {
+        if constexpr (std::is_same_v<T, bool>) {
+            // Any other value than 0 or 1 in a bool would be undefined behavior
+            return message[offset] != 0;
+        }
+        else {
+            T value;
+            std::memcpy(&value, message.data() + offset, sizeof(T));
+            return value;
+        }
+    }
+};
+
+template<typename T>
+    requires std::is_base_of_v<FlatView, T>
+struct FlatTraits<T> {
+    static constexpr uint32_t size = T::size;
+    static constexpr uint32_t alignment = T::alignment;
+
+    static T read(const std::span<const uint8_t> message, const uint32_t offset) { return T(message, offset); }
+};
+
+template<>
+struct FlatTraits<FlatString> {
+    static constexpr uint32_t size = flat_ref_size;
+    static constexpr uint32_t alignment = flat_ref_alignment;
+
+    static std::optional<std::string_view> read(const std::span<const uint8_t> message, const uint32_t offset) {
+        const auto resolved = flat_resolve(message, offset, 1);
+        if (!resolved) {
+            return std::nullopt;
+        }
+        return std::string_view { reinterpret_cast<const char*>(message.data()) + resolved->first, resolved->second };
+    }
+};
+
+inline std::optional<std::string_view> FlatView::string(const uint32_t field) const {
+    return FlatTraits<FlatString>::read(message, offset + field);
+}
+
+template<typename T>
+struct FlatTraits<FlatList<T>> {
+    static constexpr uint32_t size = flat_ref_size;
+    static constexpr uint32_t alignment = flat_ref_alignment;
+
+    static std::optional<FlatList<T>> read(const std::span<const uint8_t> message, const uint32_t offset) {
+        const auto resolved = flat_resolve(message, offset, FlatTraits<T>::size);
+        if (!resolved) {
+            return std::nullopt;
+        }
+        return FlatList<T>(message, resolved->first, resolved->second);
+    }
+};
+
+// Struct of type `View` at guest `address`, in a message that occupies `region` of `memory`. Nullopt if the
+// struct is not inside the message
+template<typename View>
+std::optional<View> read_flat(const GuestMemoryView& memory, const GuestSpan region, const uint32_t address) {
+    const auto message = memory.span(region);
+    if (!message || address < region.offset || address - region.offset > region.length || View::size > region.offset + region.length - address) {
+        return std::nullopt;
+    }
+    return View(*message, address - region.offset);
+}
+
+template<typename T>
+class FlatListBuilder;
+
+// Lays out a message in guest memory, where the plugin reads it in place. Nothing may call into the plugin until
+// the message is complete, since that could move the memory
+class FlatBuilder {
+public:
+    FlatBuilder(const GuestMemoryView& memory, const GuestSpan region) : address(region.offset) {
+        if (const auto target_span = memory.span(region)) {
+            target = *target_span;
+        }
+        else {
+            failed = true;
+        }
+    }
+
+    // False once the message did not fit into its region
+    explicit operator bool() const { return !failed; }
+
+    // Allocates a zeroed struct, e.g. the message's root
+    template<typename Builder>
+    Builder create() { return Builder(*this, allocate(Builder::size, Builder::alignment)); }
+
+    // Guest address of `offset` in the message
+    uint32_t address_of(const uint32_t offset) const { return address + offset; }
+
+    // Offset past the end of the region, where writes are no-ops
+    uint32_t end() const { return static_cast<uint32_t>(target.size()); }
+
+    // Offset of `count` zeroed elements, aligned in guest memory, or end() if they do not fit
+    uint32_t allocate(const uint32_t size, const uint32_t alignment, const uint32_t count = 1) {
+        const uint64_t start = ((uint64_t { address } + position + alignment - 1) & ~uint64_t { alignment - 1 }) - address;
+        const uint64_t limit = start + uint64_t { size } * count;
+        if (failed || limit > target.size()) {
+            failed = true;
+            return end();
+        }
+        std::memset(target.data() + start, 0, limit - start);
+        position = static_cast<uint32_t>(limit);
+        return static_cast<uint32_t>(start);
+    }
+
+    template<typename T>
+    void write(const uint32_t offset, const T value) {
+        static_assert(std::is_arithmetic_v<T> && sizeof(bool) == 1);
+        if (offset <= target.size() && sizeof(T) <= target.size() - offset) {
+            std::memcpy(target.data() + offset, &value, sizeof(T));
+        }
+    }
+
+    void write_ref(const uint32_t ref, const uint32_t first, const uint32_t count) {
+        write(ref, count ? static_cast<int32_t>(int64_t { first } - ref) : 0);
+        write(ref + sizeof(int32_t), count);
+    }
+
+    void write_string(const uint32_t ref, const std::string_view value) {
+        const auto length = static_cast<uint32_t>(value.size());
+        const uint32_t first = allocate(1, 1, length + 1);
+        if (failed) {
+            return;
+        }
+        std::memcpy(target.data() + first, value.data(), length);
+        write_ref(ref, first, length);
+    }
+
+    template<typename T>
+    FlatListBuilder<T> write_list(const uint32_t ref, const uint32_t count);
+
+private:
+    std::span<uint8_t> target;
+    uint32_t address = 0;
+    uint32_t position = 0;
+    bool failed = false;
+};
+
+class FlatStructBuilder {
+public:
+    FlatStructBuilder(FlatBuilder& builder, const uint32_t offset) : builder(&builder), offset(offset) {}
+
+    // Guest address to pass to the plugin
+    uint32_t address() const { return builder->address_of(offset); }
+
+protected:
+    template<typename T>
+    void set(const uint32_t field, const T value) const { builder->write(offset + field, value); }
+
+    void set_string(const uint32_t field, const std::string_view value) const { builder->write_string(offset + field, value); }
+
+    template<typename T>
+    T structure(const uint32_t field) const { return T(*builder, offset + field); }
+
+    template<typename T>
+    FlatListBuilder<T> list(const uint32_t field, const uint32_t count) const { return builder->write_list<T>(offset + field, count); }
+
+    FlatBuilder* builder;
+    uint32_t offset;
+};
+
+template<typename T>
+struct FlatLayout {
+    static constexpr uint32_t size = T::size;
+    static constexpr uint32_t alignment = T::alignment;
+};
+
+template<typename T>
+    requires std::is_arithmetic_v<T> || std::is_same_v<T, FlatString>
+struct FlatLayout<T> {
+    static constexpr uint32_t size = FlatTraits<T>::size;
+    static constexpr uint32_t alignment = FlatTraits<T>::alignment;
+};
+
+// Elements of a list being built. Indices past the end of the list are ignored
+template<typename T>
+class FlatListBuilder {
+public:
+    FlatListBuilder(FlatBuilder& builder, const uint32_t offset, const uint32_t count) : builder(&builder), offset(offset), count(count) {}
+
+    uint32_t size() const { return count; }
+
+    T operator[](const uint32_t index) const
+        requires std::is_base_of_v<FlatStructBuilder, T>
+    {
+        return T(*builder, index < count ? offset + index * T::size : builder->end());
+    }
+
+    void set(const uint32_t index, const T value) const
+        requires std::is_arithmetic_v<T>
+    {
+        if (index < count) {
+            builder->write(offset + index * static_cast<uint32_t>(sizeof(T)), value);
+        }
+    }
+
+    void set(const uint32_t index, const std::string_view value) const
+        requires std::is_same_v<T, FlatString>
+    {
+        if (index < count) {
+            builder->write_string(offset + index * flat_ref_size, value);
+        }
+    }
+
+private:
+    FlatBuilder* builder;
+    uint32_t offset;
+    uint32_t count;
+};
+
+template<typename T>
+FlatListBuilder<T> FlatBuilder::write_list(const uint32_t ref, const uint32_t count) {
+    const uint32_t first = allocate(FlatLayout<T>::size, FlatLayout<T>::alignment, count);
+    if (failed) {
+        return { *this, first, 0 };
+    }
+    write_ref(ref, first, count);
+    return { *this, first, count };
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <optional>
+
+#include "guest_memory.hpp"
+
+// Bump arena in guest linear memory for the results of one call. The host passes its address to an export, the
+// plugin allocates its results from it without calling its allocator, and once the host has read them it frees
+// them all with a single store instead of a call per object. The layout is shared with plugins/c/plugin_arena.h
+// and plugins/zig/arena.zig:
+//
+//   +0   u32 capacity   size of the data area
+//   +4   u32 used       bytes handed out since the last reset, only advanced by the plugin
+//   +16  data           allocations, at offsets relative to the data area
+constexpr uint32_t arena_header_size = 16;
+constexpr uint32_t arena_used_offset = 4;
+// Largest alignment the plugin can request, since the data area starts on it
+constexpr uint32_t arena_alignment = 16;
+
+class GuestArena {
+public:
+    // Allocates and initializes an arena with `capacity` data bytes inside the plugin through its `plugin_alloc`
+    // export
+    template<typename Exports>
+    static std::optional<GuestArena> create(const Exports& exports, const uint32_t capacity) {
+        if (capacity > (1u << 30)) {
+            return std::nullopt;
+        }
+        // The Zig plugin's allocator hands out byte-aligned buffers
+        const auto allocation = guest_alloc(exports, arena_header_size + capacity + arena_alignment - 1);
+        if (!allocation) {
+            return std::nullopt;
+        }
+        const uint32_t address = (allocation->offset + arena_alignment - 1) & ~(arena_alignment - 1);
+        const auto header = exports.memory_view().span({ address, arena_header_size });
+        if (!header) {
+            guest_free(exports, *allocation);
+            return std::nullopt;
+        }
+        std::memset(header->data(), 0, header->size());
+        std::memcpy(header->data(), &capacity, sizeof(capacity));
+        return GuestArena(*allocation, address, capacity);
+    }
+
+    // Address to pass to the plugin
+    uint32_t address() const { return arena_address; }
+
+    // Hand this to guest_free() once the plugin no longer gets the arena
+    GuestSpan allocation() const { return allocated; }
+
+    // Bytes the plugin allocated since the last reset, or nullopt if `memory` does not hold the arena or the plugin
+    // left it inconsistent
+    std::optional<uint32_t> used(const GuestMemoryView& memory) const {
+        const auto header = memory.span({ arena_address, arena_header_size });
+        if (!header) {
+            return std::nullopt;
+        }
+        uint32_t used;
+        std::memcpy(&used, header->data() + arena_used_offset, sizeof(used));
+        if (used > capacity) {
+            return std::nullopt;
+        }
+        return used;
+    }
+
+    // Region holding everything the plugin allocated since the last reset, e.g. to read a result with read_flat()
+    std::optional<GuestSpan> contents(const GuestMemoryView& memory) const {
+        const auto bytes = used(memory);
+        if (!bytes) {
+            return std::nullopt;
+        }
+        return GuestSpan { arena_address + arena_header_size, *bytes };
+    }
+
+    // Frees everything the plugin allocated. Results must be read or copied out first
+    bool reset(const GuestMemoryView& memory) const {
+        const auto header = memory.span({ arena_address, arena_header_size });
+        if (!header) {
+            return false;
+        }
+        std::memset(header->data() + arena_used_offset, 0, sizeof(uint32_t));
+        return true;
+    }
+
+private:
+    GuestArena(const GuestSpan allocated, const uint32_t address, const uint32_t capacity) : allocated(allocated), arena_address(address), capacity(capacity) {}
+
+    GuestSpan allocated;
+    uint32_t arena_address = 0;
+    uint32_t capacity = 0;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <type_traits>
+
+#include "guest_memory.hpp"
+
+// wasm is little-endian, so host structs can only be copied into guest memory as-is on little-endian hosts
+static_assert(std::endian::native == std::endian::little);
+
+// Guest allocation reused across batches, so that steady-state batches cost a single call into the plugin
+template<typename Exports>
+class GuestScratch {
+public:
+    explicit GuestScratch(const Exports& exports) : exports(exports) {}
+    GuestScratch(const GuestScratch&) = delete;
+    GuestScratch& operator=(const GuestScratch&) = delete;
+    ~GuestScratch() { release(); }
+
+    // Returns a region of at least `size` bytes, reallocating only when the current one is too small
+    std::optional<GuestSpan> reserve(const uint32_t size) {
+        if (region.length >= size && region.offset != 0) {
+            return region;
+        }
+        release();
+        if (const auto allocated = guest_alloc(exports, size)) {
+            region = *allocated;
+            return region;
+        }
+        return std::nullopt;
+    }
+
+private:
+    void release() {
+        if (region.offset != 0) {
+            guest_free(exports, region);
+            region = {};
+        }
+    }
+
+    const Exports& exports;
+    GuestSpan region {};
+};
+
+// Packs `inputs` into guest memory, runs `batch_fn(inputs_address, count, outputs_address)` once over all of them
+// and copies the results back into `outputs`. Input and output element types must match the guest's struct layout
+template<typename Exports, typename BatchFn, typename In, typename Out>
+bool call_batch(GuestScratch<Exports>& scratch, const Exports& exports, const BatchFn& batch_fn, const std::span<const In> inputs, const std::span<Out> outputs) {
+    static_assert(std::is_trivially_copyable_v<In> && std::is_trivially_copyable_v<Out>);
+    if (inputs.size() != outputs.size()) {
+        return false;
+    }
+    // Sized in 64 bits, a batch that does not fit the guest's 32-bit address space is rejected instead of wrapping
+    const uint64_t packed_outputs_offset = (static_cast<uint64_t>(inputs.size_bytes()) + alignof(Out) - 1) / alignof(Out) * alignof(Out);
+    if (packed_outputs_offset + outputs.size_bytes() > UINT32_MAX) {
+        return false;
+    }
+    const uint32_t inputs_size = static_cast<uint32_t>(inputs.size_bytes());
+    const uint32_t outputs_offset = static_cast<uint32_t>(packed_outputs_offset);
+    const auto region = scratch.reserve(outputs_offset + static_cast<uint32_t>(outputs.size_bytes()));
+    if (!region) {
+        return false;
+    }
+
+    const auto packed_inputs = exports.memory_view().span({ region->offset, inputs_size });
+    if (!packed_inputs) {
+        return false;
+    }
+    std::memcpy(packed_inputs->data(), inputs.data(), inputs_size);
+
+    if (!batch_fn(static_cast<int32_t>(region->offset), static_cast<int32_t>(inputs.size()), static_cast<int32_t>(region->offset + outputs_offset))) {
+        return false;
+    }
+
+    // The batch may have grown the memory, so look the results up through a fresh view
+    const auto packed_outputs = exports.memory_view().span({ region->offset + outputs_offset, static_cast<uint32_t>(outputs.size_bytes()) });
+    if (!packed_outputs) {
+        return false;
+    }
+    std::memcpy(outputs.data(), packed_outputs->data(), outputs.size_bytes());
+    return true;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+// A region of guest linear memory. Addressed by offset, so it stays valid when memory.grow moves the memory
+struct GuestSpan {
+    uint32_t offset = 0;
+    uint32_t length = 0;
+};
+
+// UTF-8 text in guest memory, not necessarily NUL-terminated
+struct GuestString : GuestSpan {};
+
+// Bounds-checked, zero-copy access to a linear memory. A view captures the memory's current base and size,
+// and any call into the plugin may grow and move the memory, so take a fresh view after each call
+class GuestMemoryView {
+public:
+    explicit GuestMemoryView(const std::span<uint8_t> memory) : memory(memory) {}
+
+    size_t size() const { return memory.size(); }
+
+    std::optional<std::span<uint8_t>> span(const GuestSpan region) const {
+        if (!contains(region.offset, region.length)) {
+            return std::nullopt;
+        }
+        return memory.subspan(region.offset, region.length);
+    }
+
+    std::optional<std::string_view> string(const GuestString text) const {
+        const auto bytes = span(text);
+        if (!bytes) {
+            return std::nullopt;
+        }
+        return std::string_view { reinterpret_cast<const char*>(bytes->data()), bytes->size() };
+    }
+
+    // Measures a NUL-terminated string without reading past the end of the memory
+    std::optional<GuestString> c_string(const uint32_t address) const {
+        if (address >= memory.size()) {
+            return std::nullopt;
+        }
+        const auto* terminator = static_cast<const uint8_t*>(std::memchr(memory.data() + address, 0, memory.size() - address));
+        if (!terminator) {
+            return std::nullopt;
+        }
+        return GuestString { { address, static_cast<uint32_t>(terminator - (memory.data() + address)) } };
+    }
+
+    template<typename T>
+    std::optional<T> load(const uint32_t offset) const {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (!contains(offset, sizeof(T))) {
+            return std::nullopt;
+        }
+        T value;
+        std::memcpy(&value, memory.data() + offset, sizeof(T));
+        return value;
+    }
+
+    template<typename T>
+    bool store(const uint32_t offset, const T& value) const {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (!contains(offset, sizeof(T))) {
+            return false;
+        }
+        std::memcpy(memory.data() + offset, &value, sizeof(T));
+        return true;
+    }
+
+private:
+    bool contains(const uint64_t offset, const uint64_t length) const {
+        return offset + length <= memory.size();
+    }
+
+    std::span<uint8_t> memory;
+};
+
+// Allocates `size` bytes inside the plugin through its `plugin_alloc` export
+template<typename Exports>
+std::optional<GuestSpan> guest_alloc(const Exports& exports, const uint32_t size) {
+    if (!exports.plugin_alloc) {
+        return std::nullopt;
+    }
+    const auto address = exports.plugin_alloc(static_cast<int32_t>(size));
+    if (!address || *address == 0) {
+        return std::nullopt;
+    }
+    return GuestSpan { static_cast<uint32_t>(*address), size };
+}
+
+template<typename Exports>
+void guest_free(const Exports& exports, const GuestSpan region) {
+    if (exports.plugin_free) {
+        exports.plugin_free(static_cast<int32_t>(region.offset), static_cast<int32_t>(region.length));
+    }
+}
+
+// Copies `bytes` straight into a fresh guest allocation, the only copy on the way into the plugin
+template<typename Exports>
+std::optional<GuestSpan> guest_write(const Exports& exports, const std::span<const uint8_t> bytes) {
+    const auto region = guest_alloc(exports, static_cast<uint32_t>(bytes.size()));
+    if (!region) {
+        return std::nullopt;
+    }
+    const auto target = exports.memory_view().span(*region);
+    if (!target) {
+        guest_free(exports, *region);
+        return std::nullopt;
+    }
+    std::memcpy(target->data(), bytes.data(), bytes.size());
+    return region;
+}
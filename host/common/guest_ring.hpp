@@ -0,0 +1,180 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <type_traits>
+
+#include "guest_memory.hpp"
+
+// Single-producer, single-consumer ring of variable-length records in guest linear memory. Host and plugin
+// exchange any number of records per call, each costing a copy and one index store. The layout is shared with
+// plugins/c/plugin_ring.h and plugins/zig/ring.zig:
+//
+//   +0    u32 capacity   size of the data area, a power of two
+//   +64   u32 head       bytes ever written, only stored by the producer
+//   +128  u32 tail       bytes ever read, only stored by the consumer
+//   +192  data           records: u32 length, payload, padding to 4 bytes
+//
+// A record that would run past the end of the data area is preceded by a skip marker, a length of
+// ring_skip_marker, and starts over at offset 0. The indices run freely and wrap at 2^32.
+//
+// Indices are published with release stores and read with acquire loads on both sides, so the two ends may run
+// concurrently if the plugin is built with atomics and shares its memory. Otherwise the host fills a ring, calls
+// the plugin once to drain it, and reads the plugin's answers from a second ring after the call.
+constexpr uint32_t ring_header_size = 192;
+constexpr uint32_t ring_head_offset = 64;
+constexpr uint32_t ring_tail_offset = 128;
+constexpr uint32_t ring_skip_marker = 0xffff'ffff;
+// Keeps the indices on cache lines of their own
+constexpr uint32_t ring_alignment = 64;
+
+static_assert(std::endian::native == std::endian::little);
+
+class GuestRing {
+public:
+    // Allocates and initializes a ring with `capacity` data bytes inside the plugin through its `plugin_alloc`
+    // export. `capacity` must be a power of two of at least 8 bytes
+    template<typename Exports>
+    static std::optional<GuestRing> create(const Exports& exports, const uint32_t capacity) {
+        if (!std::has_single_bit(capacity) || capacity < 8 || capacity > (1u << 30)) {
+            return std::nullopt;
+        }
+        // Guest allocators only guarantee 8 or 16 bytes of alignment
+        const auto allocation = guest_alloc(exports, ring_header_size + capacity + ring_alignment - 1);
+        if (!allocation) {
+            return std::nullopt;
+        }
+        const uint32_t address = (allocation->offset + ring_alignment - 1) & ~(ring_alignment - 1);
+        GuestRing ring(*allocation, address, capacity);
+        const auto header = exports.memory_view().span({ address, ring_header_size });
+        if (!header) {
+            guest_free(exports, *allocation);
+            return std::nullopt;
+        }
+        std::memset(header->data(), 0, header->size());
+        std::memcpy(header->data(), &capacity, sizeof(capacity));
+        return ring;
+    }
+
+    // Address the plugin gets to find the ring
+    uint32_t address() const { return ring_address; }
+
+    // Hand this to guest_free() once neither side uses the ring anymore
+    GuestSpan allocation() const { return allocated; }
+
+    // Appends one record. False if the ring is too full for it, or `memory` does not hold the ring. Records of up
+    // to half the capacity always fit once the consumer has caught up
+    bool push(const GuestMemoryView& memory, const std::span<const uint8_t> record) {
+        auto* ring = resolve(memory);
+        if (!ring) {
+            return false;
+        }
+        if (record.size() > capacity) {
+            return false;
+        }
+        const uint32_t head = index(ring, ring_head_offset).load(std::memory_order_relaxed);
+        if (!is_aligned(head)) {
+            return false;
+        }
+        const uint32_t needed = record_size(record.size());
+        uint32_t position = head & (capacity - 1);
+        // Room at the end of the data area that a record too large for it leaves unused
+        const uint32_t skipped = position + needed > capacity ? capacity - position : 0;
+        if (skipped + needed > capacity) {
+            return false;
+        }
+        // The consumer's index is only read again once the cached one says the ring is full
+        if (head - cached_tail + skipped + needed > capacity) {
+            cached_tail = index(ring, ring_tail_offset).load(std::memory_order_acquire);
+            if (!is_aligned(cached_tail) || head - cached_tail > capacity || head - cached_tail + skipped + needed > capacity) {
+                return false;
+            }
+        }
+        uint8_t* data = ring + ring_header_size;
+        if (skipped) {
+            std::memcpy(data + position, &ring_skip_marker, sizeof(uint32_t));
+            position = 0;
+        }
+        const auto length = static_cast<uint32_t>(record.size());
+        std::memcpy(data + position, &length, sizeof(length));
+        std::memcpy(data + position + sizeof(length), record.data(), record.size());
+        index(ring, ring_head_offset).store(head + skipped + needed, std::memory_order_release);
+        return true;
+    }
+
+    template<typename T>
+    bool push(const GuestMemoryView& memory, const T& record) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        return push(memory, std::span(reinterpret_cast<const uint8_t*>(&record), sizeof(T)));
+    }
+
+    // Calls `visit(std::span<const uint8_t>)` for every record the producer has published so far, and frees them
+    // after the last one. Returns the number of records, or nullopt if the plugin left the ring inconsistent
+    template<typename Visit>
+    std::optional<size_t> drain(const GuestMemoryView& memory, Visit&& visit) {
+        auto* ring = resolve(memory);
+        if (!ring) {
+            return std::nullopt;
+        }
+        const uint8_t* data = ring + ring_header_size;
+        const uint32_t head = index(ring, ring_head_offset).load(std::memory_order_acquire);
+        uint32_t tail = index(ring, ring_tail_offset).load(std::memory_order_relaxed);
+        // The plugin produced every byte between the indices, so each record is checked before it is read
+        if (!is_aligned(head) || !is_aligned(tail) || head - tail > capacity) {
+            return std::nullopt;
+        }
+        size_t count = 0;
+        while (tail != head) {
+            const uint32_t position = tail & (capacity - 1);
+            uint32_t length;
+            std::memcpy(&length, data + position, sizeof(length));
+            if (length == ring_skip_marker) {
+                if (capacity - position > head - tail) {
+                    return std::nullopt;
+                }
+                tail += capacity - position;
+                continue;
+            }
+            // An aligned position leaves at least the length's 4 bytes before the end of the data area
+            if (length > capacity - position - sizeof(length) || record_size(length) > head - tail) {
+                return std::nullopt;
+            }
+            visit(std::span(data + position + sizeof(length), length));
+            tail += record_size(length);
+            count++;
+        }
+        index(ring, ring_tail_offset).store(tail, std::memory_order_release);
+        return count;
+    }
+
+private:
+    GuestRing(const GuestSpan allocated, const uint32_t address, const uint32_t capacity) : allocated(allocated), ring_address(address), capacity(capacity) {}
+
+    // Indices only advance by whole records and skips, which keeps them a multiple of 4. Both are stored in guest
+    // memory, so the plugin can leave anything in them, and an unaligned position would put a record's length
+    // across the end of the data area
+    static constexpr bool is_aligned(const uint32_t index) { return index % sizeof(uint32_t) == 0; }
+
+    static constexpr uint32_t record_size(const size_t length) {
+        return static_cast<uint32_t>(sizeof(uint32_t) + ((length + 3) & ~size_t { 3 }));
+    }
+
+    uint8_t* resolve(const GuestMemoryView& memory) const {
+        const auto ring = memory.span({ ring_address, ring_header_size + capacity });
+        return ring ? ring->data() : nullptr;
+    }
+
+    static std::atomic_ref<uint32_t> index(uint8_t* ring, const uint32_t offset) {
+        return std::atomic_ref(*reinterpret_cast<uint32_t*>(ring + offset));
+    }
+
+    GuestSpan allocated;
+    uint32_t ring_address = 0;
+    uint32_t capacity = 0;
+    // Producer side: the consumer's last known index, so pushes only read its cache line when the ring looks full
+    uint32_t cached_tail = 0;
+};
@@ -0,0 +1,277 @@
+#include "host_files.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <print>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+HostFiles::HostFiles(const std::filesystem::path& directory) {
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    root = std::filesystem::weakly_canonical(std::filesystem::absolute(directory), error);
+    if (error) {
+        std::println("ERROR: Failed to resolve file import directory \"{}\": {}", directory.string(), error.message());
+    }
+#ifndef _WIN32
+    root_fd = ::open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd < 0) {
+        std::println("ERROR: Failed to open file import directory \"{}\"", root.string());
+    }
+#endif
+}
+
+HostFiles::~HostFiles() {
+#ifndef _WIN32
+    if (root_fd >= 0) {
+        close(root_fd);
+    }
+#endif
+}
+
+std::optional<std::filesystem::path> HostFiles::resolve(const GuestMemoryView& memory, const GuestString path) const {
+    const auto text = memory.string(path);
+    if (!text || text->empty() || text->find('\0') != std::string_view::npos) {
+        return std::nullopt;
+    }
+    const auto relative = std::filesystem::path(*text).lexically_normal();
+    // Normalized, ".." can only be left at the start
+    if (relative.has_root_name() || relative.has_root_directory() || *relative.begin() == "..") {
+        return std::nullopt;
+    }
+    return relative;
+}
+
+#ifdef _WIN32
+// Windows has no openat, so symlinks are resolved and checked before the open instead, which leaves a window for one
+// swapped in between
+static std::optional<std::filesystem::path> resolve_beneath(const std::filesystem::path& root, const std::filesystem::path& relative) {
+    std::error_code error;
+    auto resolved = std::filesystem::weakly_canonical(root / relative, error);
+    if (error || std::mismatch(root.begin(), root.end(), resolved.begin(), resolved.end()).first != root.end()) {
+        return std::nullopt;
+    }
+    return resolved;
+}
+#else
+// Opens the directory holding `relative` one component at a time without following symlinks, so none swapped in
+// at any point can lead out of the root. Sets `name` to the last component, which the caller opens the same way
+static int open_parent(const int root_fd, const std::filesystem::path& relative, std::string& name) {
+    int directory = fcntl(root_fd, F_DUPFD_CLOEXEC, 0);
+    auto component = relative.begin();
+    for (auto next = std::next(component); directory >= 0 && next != relative.end(); component = next++) {
+        const int child = openat(directory, component->c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        const int error = errno;
+        close(directory);
+        errno = error;
+        directory = child;
+    }
+    name = component->string();
+    return directory;
+}
+
+// Host file error for a failed open, ELOOP and ENOTDIR are symlinks met with O_NOFOLLOW
+static int32_t open_error() {
+    if (errno == ENOENT) {
+        return host_file_not_found;
+    }
+    return errno == ELOOP || errno == ENOTDIR ? host_file_invalid_argument : host_file_io_error;
+}
+#endif
+
+int64_t HostFiles::read_into(const GuestMemoryView& memory, const GuestString path, const uint64_t offset, const std::span<uint8_t> target, uint64_t& size) const {
+    const auto relative = resolve(memory, path);
+    if (!relative) {
+        return host_file_invalid_argument;
+    }
+#ifdef _WIN32
+    const auto resolved = resolve_beneath(root, *relative);
+    if (!resolved) {
+        return host_file_invalid_argument;
+    }
+    const HANDLE file = CreateFileW(resolved->c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        const DWORD error = GetLastError();
+        return error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND ? host_file_not_found : host_file_io_error;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        CloseHandle(file);
+        return host_file_io_error;
+    }
+    size = static_cast<uint64_t>(file_size.QuadPart);
+    size_t copied = 0;
+    while (copied < target.size()) {
+        const uint64_t position = offset + copied;
+        OVERLAPPED overlapped {};
+        overlapped.Offset = static_cast<DWORD>(position);
+        overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+        DWORD read = 0;
+        const DWORD length = static_cast<DWORD>(std::min<size_t>(target.size() - copied, 1u << 30));
+        if (!ReadFile(file, target.data() + copied, length, &read, &overlapped)) {
+            if (GetLastError() == ERROR_HANDLE_EOF) {
+                break;
+            }
+            CloseHandle(file);
+            return host_file_io_error;
+        }
+        if (read == 0) {
+            break;
+        }
+        copied += read;
+    }
+    CloseHandle(file);
+#else
+    std::string name;
+    const int directory = open_parent(root_fd, *relative, name);
+    if (directory < 0) {
+        return open_error();
+    }
+    // Non-blocking so a FIFO in the file's place cannot stall the call, regular files ignore it
+    const int fd = openat(directory, name.c_str(), O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC);
+    const int error = errno;
+    close(directory);
+    if (fd < 0) {
+        errno = error;
+        return open_error();
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+        close(fd);
+        return host_file_io_error;
+    }
+    size = static_cast<uint64_t>(file_stat.st_size);
+    size_t copied = 0;
+    while (copied < target.size()) {
+        const ssize_t read = pread(fd, target.data() + copied, target.size() - copied, static_cast<off_t>(offset + copied));
+        if (read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (read < 0) {
+            close(fd);
+            return host_file_io_error;
+        }
+        if (read == 0) {
+            break;
+        }
+        copied += static_cast<size_t>(read);
+    }
+    close(fd);
+#endif
+    return static_cast<int64_t>(copied);
+}
+
+int64_t HostFiles::file_size(const GuestMemoryView& memory, const GuestString path) const {
+    uint64_t size = 0;
+    const int64_t read = read_into(memory, path, 0, {}, size);
+    return read < 0 ? read : static_cast<int64_t>(size);
+}
+
+int64_t HostFiles::read_file(const GuestMemoryView& memory, const GuestString path, const GuestSpan buffer) const {
+    const auto target = memory.span(buffer);
+    if (!target) {
+        return host_file_invalid_argument;
+    }
+    uint64_t size = 0;
+    const int64_t read = read_into(memory, path, 0, *target, size);
+    if (read < 0) {
+        return read;
+    }
+    // Ending early means the file was truncated after it was opened, the bytes read then are its whole size
+    return static_cast<uint64_t>(read) < target->size() ? read : std::max(static_cast<int64_t>(size), read);
+}
+
+int64_t HostFiles::read_file_at(const GuestMemoryView& memory, const GuestString path, const int64_t offset, const GuestSpan buffer) const {
+    const auto target = memory.span(buffer);
+    if (!target || offset < 0) {
+        return host_file_invalid_argument;
+    }
+    uint64_t size = 0;
+    return read_into(memory, path, static_cast<uint64_t>(offset), *target, size);
+}
+
+int32_t HostFiles::write_file(const GuestMemoryView& memory, const GuestString path, const GuestSpan data) const {
+    const auto source = memory.span(data);
+    const auto relative = resolve(memory, path);
+    if (!source || !relative) {
+        return host_file_invalid_argument;
+    }
+    // Unique per write, instances on other threads or hosts may write the same file at once
+    static std::atomic<uint64_t> next_temp = 0;
+    const auto temp_suffix = std::format(".{}.{}.tmp", std::chrono::steady_clock::now().time_since_epoch().count(), next_temp.fetch_add(1, std::memory_order_relaxed));
+#ifdef _WIN32
+    const auto resolved = resolve_beneath(root, *relative);
+    if (!resolved) {
+        return host_file_invalid_argument;
+    }
+    auto temp_path = *resolved;
+    temp_path += temp_suffix;
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file || !file.write(reinterpret_cast<const char*>(source->data()), static_cast<std::streamsize>(source->size()))) {
+            file.close();
+            std::error_code error;
+            std::filesystem::remove(temp_path, error);
+            return host_file_io_error;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temp_path, *resolved, error);
+    if (error) {
+        std::filesystem::remove(temp_path, error);
+        return host_file_io_error;
+    }
+#else
+    std::string name;
+    const int directory = open_parent(root_fd, *relative, name);
+    if (directory < 0) {
+        return open_error();
+    }
+    // Refused like every other symlink, though renaming over one would only replace the link itself
+    struct stat target_stat;
+    if (fstatat(directory, name.c_str(), &target_stat, AT_SYMLINK_NOFOLLOW) == 0 && S_ISLNK(target_stat.st_mode)) {
+        close(directory);
+        return host_file_invalid_argument;
+    }
+    const auto temp_name = name + temp_suffix;
+    const int fd = openat(directory, temp_name.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0666);
+    if (fd < 0) {
+        close(directory);
+        return host_file_io_error;
+    }
+    size_t written = 0;
+    while (written < source->size()) {
+        const ssize_t count = write(fd, source->data() + written, source->size() - written);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            break;
+        }
+        written += static_cast<size_t>(count);
+    }
+    const bool closed = close(fd) == 0;
+    if (written < source->size() || !closed || renameat(directory, temp_name.c_str(), directory, name.c_str()) != 0) {
+        unlinkat(directory, temp_name.c_str(), 0);
+        close(directory);
+        return host_file_io_error;
+    }
+    close(directory);
+#endif
+    return 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+
+#include "guest_memory.hpp"
+
+// Whole-file imports plugins can take from the "env" module instead of going through WASI, so a file moves in
+// or out of guest memory in one host call instead of an open, a read or write per buffer and a close. Paths
+// are relative and confined to one directory, usually the one WASI maps as ".", and are opened one component
+// at a time below it without following symlinks. The plugin side is declared in plugins/c/plugin_files.h and plugins/zig/files.zig
+//
+//   i64 file_size(path, path_len)                              size in bytes
+//   i64 read_file(path, path_len, buffer, capacity)            size in bytes, of which up to `capacity` are copied
+//   i64 read_file_at(path, path_len, offset, buffer, length)   bytes copied, 0 past the end of the file
+//   i32 write_file(path, path_len, data, length)               0
+//
+// Every import returns one of the negative errors below on failure
+
+constexpr int32_t host_file_invalid_argument = -1;
+constexpr int32_t host_file_not_found = -2;
+constexpr int32_t host_file_io_error = -3;
+
+// Every read opens the file and reads it straight into guest memory, so a guest truncating or rewriting the file
+// through WASI at the same time only shortens the read. Writes replace a file in one rename, so readers never see a
+// partial file
+class HostFiles {
+public:
+    // Creates `directory` if it does not exist yet
+    explicit HostFiles(const std::filesystem::path& directory);
+    HostFiles(const HostFiles&) = delete;
+    HostFiles& operator=(const HostFiles&) = delete;
+    ~HostFiles();
+
+    const std::filesystem::path& directory() const { return root; }
+
+    int64_t file_size(const GuestMemoryView& memory, GuestString path) const;
+    int64_t read_file(const GuestMemoryView& memory, GuestString path, GuestSpan buffer) const;
+    int64_t read_file_at(const GuestMemoryView& memory, GuestString path, int64_t offset, GuestSpan buffer) const;
+    int32_t write_file(const GuestMemoryView& memory, GuestString path, GuestSpan data) const;
+
+private:
+    // Normalized relative path of the guest's `path`, or nullopt if it is malformed or leads out of the directory
+    // before any symlink is looked at
+    std::optional<std::filesystem::path> resolve(const GuestMemoryView& memory, GuestString path) const;
+    // Opens the guest's `path` and reads it from `offset` into `target` until it is full or the file ends, and sets
+    // `size` to the size of the file. Returns the bytes read or a host file error
+    int64_t read_into(const GuestMemoryView& memory, GuestString path, uint64_t offset, std::span<uint8_t> target, uint64_t& size) const;
+
+    std::filesystem::path root;
+    // Every open starts from this descriptor, so the directory being renamed or replaced does not move the sandbox
+    int root_fd = -1;
+};
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "guest_memory.hpp"
+#include "plugin_values.hpp"
+
+class HostFiles;
+class OutputCapture;
+
+// A host import that finishes later, e.g. after I/O. The guest stays suspended while the engine polls it
+class PendingHostCall {
+public:
+    virtual ~PendingHostCall() = default;
+
+    // True once the import is done and `results` holds its results
+    virtual bool poll(std::span<PluginValue> results) = 0;
+};
+
+using AsyncHostFn = std::function<std::unique_ptr<PendingHostCall>(std::span<const PluginValue> args)>;
+
+// A host import that answers a whole array of requests in one call, so plugins that need host data per record
+// cross into the host once per batch instead of once per record. Imported from "env" as
+//
+//   i32 name(requests, count, results)
+//
+// with `count` requests and results packed back to back in guest memory, laid out like the C++ types they were
+// registered with. Returns `count`, or -1 if either array is not inside the guest's memory, is misaligned or
+// overlaps the other
+struct BatchHostFn {
+    std::string name;
+    uint32_t request_size = 0;
+    uint32_t request_alignment = 1;
+    uint32_t result_size = 0;
+    uint32_t result_alignment = 1;
+    // Called with both arrays checked
+    std::function<void(const uint8_t* requests, uint8_t* results, uint32_t count)> fn;
+
+    int32_t call(const GuestMemoryView& memory, const int32_t requests_address, const int32_t count, const int32_t results_address) const {
+        if (count < 0) {
+            return -1;
+        }
+        const auto requests_offset = static_cast<uint32_t>(requests_address);
+        const auto results_offset = static_cast<uint32_t>(results_address);
+        const uint64_t requests_length = uint64_t { request_size } * static_cast<uint32_t>(count);
+        const uint64_t results_length = uint64_t { result_size } * static_cast<uint32_t>(count);
+        if (requests_length > UINT32_MAX || results_length > UINT32_MAX || requests_offset % request_alignment || results_offset % result_alignment) {
+            return -1;
+        }
+        const auto requests = memory.span({ requests_offset, static_cast<uint32_t>(requests_length) });
+        const auto results = memory.span({ results_offset, static_cast<uint32_t>(results_length) });
+        if (!requests || !results) {
+            return -1;
+        }
+        if (requests_offset < results_offset + results_length && results_offset < requests_offset + requests_length) {
+            return -1;
+        }
+        if (count > 0) {
+            fn(requests->data(), results->data(), static_cast<uint32_t>(count));
+        }
+        return count;
+    }
+};
+
+// Registers `fn(std::span<const Request>, std::span<Result>)` as batch import `name`. Both types are read and
+// written in place in guest memory, so they must be trivially copyable and match the plugin's struct layout
+template<typename Request, typename Result, typename F>
+BatchHostFn batch_host_fn(std::string name, F fn) {
+    static_assert(std::is_trivially_copyable_v<Request> && std::is_trivially_copyable_v<Result>);
+    return {
+        .name = std::move(name),
+        .request_size = sizeof(Request),
+        .request_alignment = alignof(Request),
+        .result_size = sizeof(Result),
+        .result_alignment = alignof(Result),
+        .fn = [fn = std::move(fn)](const uint8_t* requests, uint8_t* results, const uint32_t count) {
+            // Guest memory is page-aligned in the host, so guest alignment carries over
+            fn(std::span(reinterpret_cast<const Request*>(requests), count), std::span(reinterpret_cast<Result*>(results), count));
+        },
+    };
+}
+
+// Host-side implementations of the functions plugins import from the "env" module
+struct HostImports {
+    int32_t (*host_fn)() = nullptr;
+    // Takes precedence over host_fn on async engines, others cannot suspend the guest and reject it
+    AsyncHostFn host_fn_async;
+    // Provides the whole-file imports (host_files.hpp), confined to the HostFiles' directory. Shared by every
+    // instance, it holds no state between calls besides the directory itself
+    std::shared_ptr<HostFiles> files;
+    // Each defined as "env".<name>
+    std::vector<BatchHostFn> batch_fns;
+};
+
+// Module of the WASI preview 1 imports, which every engine provides in full
+constexpr std::string_view wasi_import_module = "wasi_snapshot_preview1";
+
+// Whether an instance created with `imports` can satisfy a plugin's import of `module`.`name` with `signature`
+inline bool provides_import(const HostImports& imports, const std::string_view module, const std::string_view name, const FunctionSignature& signature) {
+    if (module == wasi_import_module) {
+        return true;
+    }
+    if (module == "env" && name == "host_fn") {
+        return (imports.host_fn || imports.host_fn_async) && signature == signature_of<int32_t>();
+    }
+    if (module == "env") {
+        for (const auto& batch_fn : imports.batch_fns) {
+            if (batch_fn.name == name) {
+                return signature == signature_of<int32_t, int32_t, int32_t, int32_t>();
+            }
+        }
+    }
+    if (module == "env" && imports.files) {
+        if (name == "file_size") {
+            return signature == signature_of<int64_t, int32_t, int32_t>();
+        }
+        if (name == "read_file") {
+            return signature == signature_of<int64_t, int32_t, int32_t, int32_t, int32_t>();
+        }
+        if (name == "read_file_at") {
+            return signature == signature_of<int64_t, int32_t, int32_t, int64_t, int32_t, int32_t>();
+        }
+        if (name == "write_file") {
+            return signature == signature_of<int32_t, int32_t, int32_t, int32_t, int32_t>();
+        }
+    }
+    return false;
+}
+
+// WASI environment given to every plugin instance
+struct WasiOptions {
+    // Mapped as the guest's "." directory
+    std::filesystem::path data_dir = "data";
+    // Forward guest stdout/stderr to the host's, otherwise the output is dropped
+    bool inherit_stdio = true;
+    // Buffers guest stdout/stderr per instance and drains it in the background, takes precedence over
+    // `inherit_stdio`
+    std::shared_ptr<OutputCapture> capture;
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Keeps a number of ready-to-run plugin instances so requests never wait on instantiation.
+// A returned instance is reset to its initial state if it supports that, otherwise it is discarded and replaced
+// by a fresh one, so no state leaks between requests
+template<typename Instance>
+class InstancePool {
+public:
+    using Factory = std::function<std::unique_ptr<Instance>()>;
+
+    // Exclusive use of one pooled instance, handed back to the pool on destruction. Must not outlive the pool
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(InstancePool* pool, std::unique_ptr<Instance> instance) : pool(pool), instance(std::move(instance)) {}
+        Lease(Lease&& other) noexcept : pool(std::exchange(other.pool, nullptr)), instance(std::move(other.instance)) {}
+        Lease& operator=(Lease&& other) noexcept {
+            if (this != &other) {
+                release();
+                pool = std::exchange(other.pool, nullptr);
+                instance = std::move(other.instance);
+            }
+            return *this;
+        }
+        ~Lease() { release(); }
+
+        explicit operator bool() const { return instance != nullptr; }
+        Instance* operator->() const { return instance.get(); }
+        Instance& operator*() const { return *instance; }
+
+        // Gives the instance up without returning it, e.g. after a trap left it in an unknown state
+        void discard() { instance.reset(); }
+
+    private:
+        void release() {
+            if (pool && instance) {
+                pool->release(std::move(instance));
+            }
+            pool = nullptr;
+        }
+
+        InstancePool* pool = nullptr;
+        std::unique_ptr<Instance> instance;
+    };
+
+    InstancePool(Factory factory, const size_t capacity) : factory(std::move(factory)), capacity(capacity) {
+        ready.reserve(capacity);
+        for (size_t i = 0; i < capacity; i++) {
+            if (auto instance = this->factory()) {
+                ready.push_back(std::move(instance));
+            }
+        }
+    }
+
+    // Takes a ready instance, instantiating on the spot if the pool has run dry.
+    // The lease is empty if instantiation failed
+    Lease acquire() {
+        {
+            std::lock_guard lock(mutex);
+            if (!ready.empty()) {
+                auto instance = std::move(ready.back());
+                ready.pop_back();
+                return { this, std::move(instance) };
+            }
+        }
+        return { this, factory() };
+    }
+
+    size_t available() {
+        std::lock_guard lock(mutex);
+        return ready.size();
+    }
+
+private:
+    void release(std::unique_ptr<Instance> used) {
+        if constexpr (requires { used->reset(); }) {
+            if (used->reset()) {
+                std::lock_guard lock(mutex);
+                if (ready.size() < capacity) {
+                    ready.push_back(std::move(used));
+                }
+                return;
+            }
+        }
+        // Tearing down the old instance resets its memory, the replacement is built outside the lock
+        used.reset();
+        auto fresh = factory();
+        if (!fresh) {
+            return;
+        }
+        std::lock_guard lock(mutex);
+        if (ready.size() < capacity) {
+            ready.push_back(std::move(fresh));
+        }
+    }
+
+    Factory factory;
+    const size_t capacity;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Instance>> ready;
+};
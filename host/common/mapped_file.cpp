@@ -0,0 +1,104 @@
+#include "mapped_file.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <print>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::optional<MappedFile> MappedFile::open(const std::filesystem::path& path) {
+    MappedFile mapped;
+#ifdef _WIN32
+    const HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return std::nullopt;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        CloseHandle(file);
+        return std::nullopt;
+    }
+    mapped.size = static_cast<size_t>(file_size.QuadPart);
+    if (mapped.size > 0) {
+        const HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) {
+            mapped.data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            CloseHandle(mapping);
+        }
+    }
+    CloseHandle(file);
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        return std::nullopt;
+    }
+    mapped.size = static_cast<size_t>(file_stat.st_size);
+    if (mapped.size > 0) {
+        void* address = mmap(nullptr, mapped.size, PROT_READ, MAP_SHARED, fd, 0);
+        if (address != MAP_FAILED) {
+            mapped.data = static_cast<const uint8_t*>(address);
+        }
+    }
+    close(fd);
+#endif
+    if (mapped.size > 0 && !mapped.data) {
+        std::println("ERROR: Failed to memory map \"{}\"", path.string());
+        mapped.size = 0;
+        return std::nullopt;
+    }
+    return mapped;
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data(std::exchange(other.data, nullptr)), size(std::exchange(other.size, 0)) {
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        unmap();
+        data = std::exchange(other.data, nullptr);
+        size = std::exchange(other.size, 0);
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() {
+    unmap();
+}
+
+void MappedFile::unmap() {
+    if (!data) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+#else
+    munmap(const_cast<uint8_t*>(data), size);
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+std::optional<std::vector<uint8_t>> read_file_bytes(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint8_t> bytes { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+    if (!file || bytes.empty()) {
+        return std::nullopt;
+    }
+    return bytes;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Read-only memory mapping of a whole file. Pages come straight from the OS page cache, so processes
+// mapping the same file share its physical memory. Only for files replaced by a rename, like module cache entries:
+// truncating a mapped file in place makes reads past its new end fault
+class MappedFile {
+public:
+    static std::optional<MappedFile> open(const std::filesystem::path& path);
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    std::span<const uint8_t> bytes() const { return { data, size }; }
+
+private:
+    MappedFile() = default;
+    void unmap();
+
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+// Reads a whole file into memory, for files that may be rewritten in place while they are in use, like a plugin
+// being rebuilt. A copy only goes stale where a mapping would fault. Fails on empty files
+std::optional<std::vector<uint8_t>> read_file_bytes(const std::filesystem::path& path);
@@ -0,0 +1,119 @@
+#include "module_cache.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <print>
+#include <string_view>
+
+static constexpr std::array<uint32_t, 64> sha256_round_constants = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static void sha256_block(std::array<uint32_t, 8>& state, const uint8_t* block) {
+    std::array<uint32_t, 64> words;
+    for (size_t i = 0; i < 16; ++i) {
+        words[i] = uint32_t(block[i * 4]) << 24 | uint32_t(block[i * 4 + 1]) << 16 | uint32_t(block[i * 4 + 2]) << 8 | block[i * 4 + 3];
+    }
+    for (size_t i = 16; i < 64; ++i) {
+        const uint32_t s0 = std::rotr(words[i - 15], 7) ^ std::rotr(words[i - 15], 18) ^ (words[i - 15] >> 3);
+        const uint32_t s1 = std::rotr(words[i - 2], 17) ^ std::rotr(words[i - 2], 19) ^ (words[i - 2] >> 10);
+        words[i] = words[i - 16] + s0 + words[i - 7] + s1;
+    }
+    auto [a, b, c, d, e, f, g, h] = state;
+    for (size_t i = 0; i < 64; ++i) {
+        const uint32_t t1 = h + (std::rotr(e, 6) ^ std::rotr(e, 11) ^ std::rotr(e, 25)) + ((e & f) ^ (~e & g)) + sha256_round_constants[i] + words[i];
+        const uint32_t t2 = (std::rotr(a, 2) ^ std::rotr(a, 13) ^ std::rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+std::array<uint8_t, 32> sha256(const std::span<const uint8_t> bytes) {
+    std::array<uint32_t, 8> state = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+    const size_t whole_blocks = bytes.size() / 64;
+    for (size_t i = 0; i < whole_blocks; ++i) {
+        sha256_block(state, bytes.data() + i * 64);
+    }
+    // The rest, a 1 bit, zeros and the length in bits fill one or two final blocks
+    std::array<uint8_t, 128> tail {};
+    const size_t rest = bytes.size() - whole_blocks * 64;
+    std::copy_n(bytes.data() + whole_blocks * 64, rest, tail.data());
+    tail[rest] = 0x80;
+    const size_t tail_size = rest < 56 ? 64 : 128;
+    const uint64_t bit_length = static_cast<uint64_t>(bytes.size()) * 8;
+    for (size_t i = 0; i < 8; ++i) {
+        tail[tail_size - 1 - i] = static_cast<uint8_t>(bit_length >> (i * 8));
+    }
+    for (size_t offset = 0; offset < tail_size; offset += 64) {
+        sha256_block(state, tail.data() + offset);
+    }
+    std::array<uint8_t, 32> digest;
+    for (size_t i = 0; i < 32; ++i) {
+        digest[i] = static_cast<uint8_t>(state[i / 4] >> (24 - i % 4 * 8));
+    }
+    return digest;
+}
+
+static std::string hex(const std::span<const uint8_t> bytes) {
+    std::string text;
+    text.reserve(bytes.size() * 2);
+    for (const uint8_t byte : bytes) {
+        text += std::format("{:02x}", byte);
+    }
+    return text;
+}
+
+std::filesystem::path module_cache_entry_path(const ModuleCache& cache, const std::span<const uint8_t> wasm_binary) {
+    const std::string_view fingerprint = cache.engine_fingerprint;
+    const auto engine_hash = sha256({ reinterpret_cast<const uint8_t*>(fingerprint.data()), fingerprint.size() });
+    return cache.directory / std::format("{}-{}.cwasm", hex(sha256(wasm_binary)), hex(engine_hash));
+}
+
+bool write_module_cache_entry(const std::filesystem::path& path, const std::span<const uint8_t> artifact) {
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+    if (error) {
+        std::println("ERROR: Failed to create module cache directory \"{}\": {}", path.parent_path().string(), error.message());
+        return false;
+    }
+    auto temp_path = path;
+    temp_path += std::format(".{}.tmp", std::chrono::steady_clock::now().time_since_epoch().count());
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file || !file.write(reinterpret_cast<const char*>(artifact.data()), static_cast<std::streamsize>(artifact.size()))) {
+            std::println("ERROR: Failed to write module cache entry \"{}\"", temp_path.string());
+            return false;
+        }
+    }
+    std::filesystem::rename(temp_path, path, error);
+    if (error) {
+        std::println("ERROR: Failed to publish module cache entry \"{}\": {}", path.string(), error.message());
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+    return true;
+}
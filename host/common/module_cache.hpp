@@ -0,0 +1,24 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+
+// On-disk cache of serialized native modules, keyed by wasm content and engine fingerprint.
+// Artifacts are loaded as trusted native code, so the cache directory must not be writable by plugins.
+struct ModuleCache {
+    std::filesystem::path directory;
+    // Engine name, version and every config option that affects generated code
+    std::string engine_fingerprint;
+};
+
+// SHA-256 (FIPS 180-4). Entries are keyed on it rather than a fast hash, since a colliding plugin would be handed
+// another plugin's native code
+std::array<uint8_t, 32> sha256(std::span<const uint8_t> bytes);
+
+std::filesystem::path module_cache_entry_path(const ModuleCache& cache, std::span<const uint8_t> wasm_binary);
+
+// Writes to a temporary file first so concurrent hosts never observe a partially written artifact
+bool write_module_cache_entry(const std::filesystem::path& path, std::span<const uint8_t> artifact);
@@ -0,0 +1,94 @@
+#include "output_capture.hpp"
+
+#include <cstdio>
+#include <format>
+#include <iterator>
+#include <print>
+
+OutputCapture::OutputCapture(OutputSink sink, OutputCaptureOptions options) : sink(std::move(sink)), capture_options(options) {
+    drainer = std::jthread([this](const std::stop_token stop) {
+        while (!stop.stop_requested()) {
+            {
+                std::unique_lock lock(wake_mutex);
+                wake_signal.wait_for(lock, stop, capture_options.flush_interval, [this] { return wake_requested; });
+                wake_requested = false;
+            }
+            drain();
+        }
+    });
+}
+
+OutputCapture::~OutputCapture() {
+    drainer.request_stop();
+    drainer.join();
+    drain();
+}
+
+void OutputCapture::drain() {
+    std::lock_guard drain_lock(drain_mutex);
+    std::vector<std::shared_ptr<InstanceOutput>> current;
+    {
+        std::lock_guard lock(instances_mutex);
+        current = instances;
+    }
+
+    std::vector<CapturedOutput> batch;
+    std::vector<const InstanceOutput*> finished;
+    uint64_t dropped = 0;
+    for (const auto& output : current) {
+        std::lock_guard lock(output->mutex);
+        for (size_t stream = 0; stream < output->buffers.size(); stream++) {
+            auto& buffer = output->buffers[stream];
+            // Partial lines wait for the rest of the line, unless it will never come or fills half the buffer
+            const size_t line_end = buffer.pending.rfind('\n');
+            size_t taken = line_end == std::string::npos ? 0 : line_end + 1;
+            if (output->closed || (taken == 0 && buffer.pending.size() >= capture_options.buffer_bytes / 2)) {
+                taken = buffer.pending.size();
+            }
+            if (taken == 0 && buffer.dropped == 0) {
+                continue;
+            }
+            CapturedOutput captured { output->instance, static_cast<OutputStream>(stream), buffer.pending.substr(0, taken), buffer.dropped };
+            if (!captured.text.empty() && captured.text.back() != '\n') {
+                captured.text += '\n';
+            }
+            buffer.pending.erase(0, taken);
+            dropped += buffer.dropped;
+            buffer.dropped = 0;
+            batch.push_back(std::move(captured));
+        }
+        if (output->closed) {
+            finished.push_back(output.get());
+        }
+    }
+
+    if (!finished.empty()) {
+        std::lock_guard lock(instances_mutex);
+        std::erase_if(instances, [&](const auto& output) { return std::ranges::find(finished, output.get()) != finished.end(); });
+    }
+    total_dropped.fetch_add(dropped, std::memory_order_relaxed);
+    if (!batch.empty() && sink) {
+        sink(batch);
+    }
+}
+
+OutputSink print_output_sink(std::string name) {
+    return [name = std::move(name)](const std::span<const CapturedOutput> batch) {
+        std::string text;
+        for (const auto& output : batch) {
+            const std::string_view stream = output.stream == OutputStream::Stdout ? "stdout" : "stderr";
+            std::string_view lines = output.text;
+            while (!lines.empty()) {
+                const size_t line_end = lines.find('\n');
+                std::format_to(std::back_inserter(text), "[{}#{} {}] {}\n", name, output.instance, stream, lines.substr(0, line_end));
+                lines.remove_prefix(line_end + 1);
+            }
+            if (output.dropped_bytes) {
+                std::format_to(std::back_inserter(text), "[{}#{} {}] ({} bytes dropped)\n", name, output.instance, stream, output.dropped_bytes);
+            }
+        }
+        // One write per batch, so lines of concurrent instances do not interleave
+        std::print("{}", text);
+        std::fflush(stdout);
+    };
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Guest stdout and stderr written into per-instance buffers instead of the host's file descriptors. Writing only
+// appends to a buffer under the instance's own lock, so guests printing from many threads never wait on each
+// other or on the terminal. A background thread drains all buffers in batches and hands them to a sink, e.g. the
+// host's logger
+
+enum class OutputStream : uint8_t {
+    Stdout,
+    Stderr,
+};
+
+// What happens to output written while an instance's buffer is full
+enum class OutputDropPolicy : uint8_t {
+    // Keep what is buffered and drop the new output
+    DropNewest,
+    // Make room by dropping the oldest buffered lines
+    DropOldest,
+};
+
+struct OutputCaptureOptions {
+    // Bytes buffered per stream of every instance until the next drain
+    size_t buffer_bytes = 64 * 1024;
+    OutputDropPolicy drop_policy = OutputDropPolicy::DropNewest;
+    // Longest time output waits for a drain. A buffer filling up past half its size is drained right away
+    std::chrono::milliseconds flush_interval { 100 };
+};
+
+// Output of one stream of one instance since the previous drain
+struct CapturedOutput {
+    uint64_t instance = 0;
+    OutputStream stream = OutputStream::Stdout;
+    // Whole lines, each ending in '\n'. A line is only split if it alone fills half the buffer
+    std::string text;
+    // Bytes dropped because the buffer was full
+    uint64_t dropped_bytes = 0;
+};
+
+// Receives the output of every drain in one call, on the drain thread
+using OutputSink = std::function<void(std::span<const CapturedOutput>)>;
+
+class OutputCapture;
+
+// Buffers one instance's stdout and stderr. Engines write to it from whichever thread runs the instance
+class InstanceOutput {
+public:
+    InstanceOutput(OutputCapture& capture, const uint64_t instance) : capture(capture), instance(instance) {}
+    InstanceOutput(const InstanceOutput&) = delete;
+    InstanceOutput& operator=(const InstanceOutput&) = delete;
+
+    uint64_t id() const { return instance; }
+
+    void write(OutputStream stream, std::string_view bytes);
+
+    // The instance is gone. What it wrote is drained once more, partial last lines included, and the buffer released
+    void close() {
+        std::lock_guard lock(mutex);
+        closed = true;
+    }
+
+private:
+    friend class OutputCapture;
+
+    struct Buffer {
+        std::string pending;
+        uint64_t dropped = 0;
+    };
+
+    OutputCapture& capture;
+    const uint64_t instance;
+    std::mutex mutex;
+    std::array<Buffer, 2> buffers;
+    bool closed = false;
+};
+
+// Output of every instance a host creates with this capture. Shared by the host's sessions, which open an
+// InstanceOutput each, and outlived by none of them
+class OutputCapture {
+public:
+    explicit OutputCapture(OutputSink sink, OutputCaptureOptions options = {});
+    OutputCapture(const OutputCapture&) = delete;
+    OutputCapture& operator=(const OutputCapture&) = delete;
+    // Stops the drain thread and drains whatever is still buffered
+    ~OutputCapture();
+
+    const OutputCaptureOptions& options() const { return capture_options; }
+
+    // Buffer of a new instance, numbered from 1 in the order instances were opened
+    std::shared_ptr<InstanceOutput> open_instance() {
+        auto output = std::make_shared<InstanceOutput>(*this, next_instance.fetch_add(1, std::memory_order_relaxed) + 1);
+        std::lock_guard lock(instances_mutex);
+        instances.push_back(output);
+        return output;
+    }
+
+    // Hands everything buffered so far to the sink, without waiting for the drain thread
+    void drain();
+
+    // Bytes dropped over all instances, up to the last drain
+    uint64_t dropped_bytes() const { return total_dropped.load(std::memory_order_relaxed); }
+
+private:
+    friend class InstanceOutput;
+
+    void wake() {
+        {
+            std::lock_guard lock(wake_mutex);
+            wake_requested = true;
+        }
+        wake_signal.notify_one();
+    }
+
+    OutputSink sink;
+    const OutputCaptureOptions capture_options;
+    std::atomic<uint64_t> next_instance = 0;
+    std::atomic<uint64_t> total_dropped = 0;
+    std::mutex instances_mutex;
+    std::vector<std::shared_ptr<InstanceOutput>> instances;
+    // Keeps the sink from being called by the drain thread and drain() at once
+    std::mutex drain_mutex;
+    std::mutex wake_mutex;
+    std::condition_variable_any wake_signal;
+    bool wake_requested = false;
+    std::jthread drainer;
+};
+
+inline void InstanceOutput::write(const OutputStream stream, std::string_view bytes) {
+    const auto& options = capture.options();
+    const size_t limit = options.buffer_bytes;
+    bool half_full = false;
+    {
+        std::lock_guard lock(mutex);
+        auto& buffer = buffers[static_cast<size_t>(stream)];
+        if (buffer.pending.size() + bytes.size() > limit) {
+            if (options.drop_policy == OutputDropPolicy::DropNewest) {
+                // Dropped whole, guests tend to write a line at a time
+                buffer.dropped += bytes.size();
+                return;
+            }
+            if (bytes.size() > limit) {
+                buffer.dropped += bytes.size() - limit;
+                bytes.remove_prefix(bytes.size() - limit);
+            }
+            // Cut at a line end, so the oldest line kept is not missing its start
+            const size_t excess = buffer.pending.size() + bytes.size() - limit;
+            if (excess > 0) {
+                const size_t line_end = buffer.pending.find('\n', excess - 1);
+                const size_t cut = line_end == std::string::npos ? buffer.pending.size() : line_end + 1;
+                buffer.dropped += cut;
+                buffer.pending.erase(0, cut);
+            }
+        }
+        const size_t before = buffer.pending.size();
+        if (buffer.pending.capacity() == 0) {
+            // Grows to the limit at most, and keeps its memory between drains
+            buffer.pending.reserve(std::min(limit, size_t { 4096 }));
+        }
+        buffer.pending.append(bytes);
+        half_full = before < limit / 2 && buffer.pending.size() >= limit / 2;
+    }
+    if (half_full) {
+        capture.wake();
+    }
+}
+
+// Sink that prints every line as "[<name>#<instance> stdout] line", one batch at a time
+OutputSink print_output_sink(std::string name);
@@ -0,0 +1,93 @@
+#include "plugin_api.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <print>
+
+#include "wasm_rewriter.hpp"
+
+constexpr size_t reset_page_size = 4096;
+
+// Calls `visit(fn, name)` for each export every plugin must have, stopping at the first that returns false
+template<typename Visit>
+static bool visit_required_exports(PluginExports& exports, Visit&& visit) {
+    return visit(exports.sum, "sum") &&
+        visit(exports.test_print, "test_print") &&
+        visit(exports.test_file_io, "test_file_io") &&
+        visit(exports.test_host_fn, "test_host_fn");
+}
+
+bool PluginInstance::reset() {
+    if (!snapshot || !exports.restore_globals || is_poisoned() || is_outdated()) {
+        return false;
+    }
+    const auto memory_view = session->memory_view();
+    if (memory_view.size() != snapshot->memory.size()) {
+        return false;
+    }
+    const auto memory = memory_view.span({ 0, static_cast<uint32_t>(memory_view.size()) });
+    if (!memory) {
+        return false;
+    }
+    // Requests usually touch a handful of pages, comparing is much cheaper than rewriting the whole memory
+    for (size_t page = 0; page < memory->size(); page += reset_page_size) {
+        const size_t length = std::min(reset_page_size, memory->size() - page);
+        if (std::memcmp(memory->data() + page, snapshot->memory.data() + page, length) != 0) {
+            std::memcpy(memory->data() + page, snapshot->memory.data() + page, length);
+        }
+    }
+    return exports.restore_globals();
+}
+
+std::unique_ptr<PluginInstance> instantiate_plugin(PluginHost& host, std::shared_ptr<const PluginSnapshot> snapshot) {
+    auto plugin = std::make_unique<PluginInstance>();
+    plugin->host = &host;
+    plugin->snapshot = std::move(snapshot);
+    plugin->session = host.instantiate();
+    if (!plugin->session) {
+        return nullptr;
+    }
+
+    auto& session = *plugin->session;
+    auto& exports = plugin->exports;
+    const bool bound = visit_required_exports(exports, [&](auto& fn, const std::string_view name) {
+        if (!fn.bind(host, session, name)) {
+            std::println("ERROR: Failed to find plugin export {}", name);
+            return false;
+        }
+        return true;
+    });
+    if (!bound) {
+        return nullptr;
+    }
+    // A mismatched signature is reported by the host and leaves the optional export unbound
+    exports.plugin_alloc.bind(host, session, "plugin_alloc");
+    exports.plugin_free.bind(host, session, "plugin_free");
+    exports.sum_batch.bind(host, session, "sum_batch");
+    exports.sum_host_fn.bind(host, session, "sum_host_fn");
+    exports.sum_host_lookups.bind(host, session, "sum_host_lookups");
+    exports.sum_ring.bind(host, session, "sum_ring");
+    exports.get_arena_string.bind(host, session, "get_arena_string");
+    exports.sum_points.bind(host, session, "sum_points");
+    exports.test_bulk_file_io.bind(host, session, "test_bulk_file_io");
+    exports.sum_file_bytes.bind(host, session, "sum_file_bytes");
+    exports.get_heap_allocated_string.bind(host, session, "get_heap_allocated_string");
+    exports.free_heap_allocated_string.bind(host, session, "free_heap_allocated_string");
+    if (plugin->snapshot && !exports.restore_globals.bind(host, session, restore_globals_export)) {
+        std::println("ERROR: Snapshot plugin is missing {}", restore_globals_export);
+        return nullptr;
+    }
+    exports.session = &session;
+    return plugin;
+}
+
+bool has_required_exports(const PluginHost& host) {
+    PluginExports exports;
+    return visit_required_exports(exports, [&](const auto& fn, const std::string_view name) {
+        if (!host.find_function(name, fn.signature())) {
+            std::println("ERROR: Plugin is missing export {}", name);
+            return false;
+        }
+        return true;
+    });
+}
@@ -0,0 +1,258 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include <coroutine>
+#include <print>
+
+#include "event_loop.hpp"
+#include "guest_memory.hpp"
+#include "plugin_host.hpp"
+#include "plugin_metrics.hpp"
+#include "plugin_values.hpp"
+#include "result_cache.hpp"
+#include "snapshot.hpp"
+
+// Number of slots a call with these parameters and result needs, shared between arguments and results
+template<typename R, typename... Args>
+constexpr size_t call_slot_count() {
+    constexpr size_t result_count = std::is_void_v<R> ? 0 : 1;
+    return sizeof...(Args) > result_count ? sizeof...(Args) : result_count;
+}
+
+// Times one export call and records it on finish(), along with whether it trapped or grew the memory. Calls
+// without metrics only pay for a null check, and none of it exists when metrics are compiled out
+template<bool Enabled = metrics_enabled>
+class ExportCallTimer {
+public:
+    void start(CallMetrics* const metrics, PluginSession& session) {
+        this->metrics = metrics;
+        if (metrics) {
+            memory_before = session.memory_view().size();
+            started = std::chrono::steady_clock::now();
+        }
+    }
+
+    void finish(PluginSession& session, const bool succeeded) const {
+        if (metrics) {
+            metrics->record(std::chrono::steady_clock::now() - started, !succeeded, memory_before, session.memory_view().size());
+        }
+    }
+
+private:
+    CallMetrics* metrics = nullptr;
+    std::chrono::steady_clock::time_point started;
+    size_t memory_before = 0;
+};
+
+template<>
+class ExportCallTimer<false> {
+public:
+    void start(NoCallMetrics, PluginSession&) {}
+    void finish(PluginSession&, bool) const {}
+};
+
+// Awaitable plugin call, polled by the event loop until the guest returns
+template<typename R, size_t SlotCount>
+class AsyncPluginCall {
+public:
+    using Result = std::conditional_t<std::is_void_v<R>, bool, std::optional<R>>;
+
+    template<typename... Args>
+    AsyncPluginCall(EventLoop& loop, PluginSession* session, const uint32_t index, const CallMetricsHandle metrics, const Args... args)
+        : loop(loop), session(session), index(index), metrics(metrics) {
+        size_t slot = 0;
+        (store_value(slots[slot++], args), ...);
+    }
+    AsyncPluginCall(const AsyncPluginCall&) = delete;
+    AsyncPluginCall& operator=(const AsyncPluginCall&) = delete;
+
+    bool await_ready() {
+        // Started here rather than on construction, the awaiter's slots no longer move once it is being awaited
+        timer.start(metrics, *session);
+        pending = session->call_async(index, { slots, SlotCount });
+        if (!pending) {
+            std::println("ERROR: Async plugin calls need an engine created with async_calls");
+            return true;
+        }
+        return false;
+    }
+
+    void await_suspend(const std::coroutine_handle<> waiter) {
+        in_flight.call = pending.get();
+        in_flight.waiter = waiter;
+        loop.start_call(in_flight);
+    }
+
+    Result await_resume() {
+        if (pending) {
+            timer.finish(*session, pending->succeeded());
+        }
+        if (!pending || !pending->succeeded()) {
+            return Result {};
+        }
+        if constexpr (std::is_void_v<R>) {
+            return true;
+        }
+        else {
+            return load_value<R>(slots[0]);
+        }
+    }
+
+private:
+    PluginValue slots[SlotCount + 1] {};
+    EventLoop& loop;
+    PluginSession* session;
+    uint32_t index;
+    [[no_unique_address]] CallMetricsHandle metrics;
+    [[no_unique_address]] ExportCallTimer<> timer;
+    std::unique_ptr<PendingCall> pending;
+    InFlightCall in_flight;
+};
+
+template<typename Signature>
+class PluginFn;
+
+// Typed handle to a plugin export in one session. The signature is checked once at bind time, calls only pack
+// the arguments into slots
+template<typename R, typename... Args>
+class PluginFn<R(Args...)> {
+public:
+    using Result = std::conditional_t<std::is_void_v<R>, bool, std::optional<R>>;
+
+    PluginFn() = default;
+
+    static const FunctionSignature& signature() { return signature_of<R, Args...>(); }
+
+    bool bind(const PluginHost& host, PluginSession& session, const std::string_view name) {
+        static_assert(call_slot_count<R, Args...>() <= max_call_slots);
+        const auto found = host.find_function(name, signature_of<R, Args...>());
+        if (!found) {
+            return false;
+        }
+        this->session = &session;
+        index = *found;
+        if constexpr (metrics_enabled) {
+            metrics = host.metrics() ? &host.metrics()->export_metrics(name) : nullptr;
+        }
+        results = nullptr;
+        if (ResultCache* cache = host.result_cache()) {
+            if (const auto pure = cache->find_export(name, signature_of<R, Args...>())) {
+                results = cache;
+                pure_id = *pure;
+            }
+        }
+        return true;
+    }
+
+    explicit operator bool() const { return session != nullptr; }
+
+    // Calls of pure exports whose result is cached return it without entering wasm, and are not recorded in the
+    // export's metrics
+    Result operator()(const Args... args) const {
+        std::optional<ResultKey> key;
+        if constexpr (!std::is_void_v<R>) {
+            if (results) {
+                key = results->key(pure_id, [this] { return session->memory_view(); }, args...);
+                if (const auto cached = key ? results->find(*key) : std::nullopt) {
+                    return load_value<R>(*cached);
+                }
+            }
+        }
+        PluginValue slots[call_slot_count<R, Args...>() + 1];
+        size_t slot = 0;
+        (store_value(slots[slot++], args), ...);
+        ExportCallTimer<> timer;
+        timer.start(metrics, *session);
+        const bool succeeded = session->call(index, { slots, call_slot_count<R, Args...>() });
+        timer.finish(*session, succeeded);
+        if (!succeeded) {
+            return Result {};
+        }
+        if constexpr (std::is_void_v<R>) {
+            return true;
+        }
+        else {
+            if (key) {
+                results->insert(std::move(*key), slots[0]);
+            }
+            return load_value<R>(slots[0]);
+        }
+    }
+
+    // Same call for `co_await` on `loop`, suspending the awaiting coroutine instead of the thread
+    AsyncPluginCall<R, call_slot_count<R, Args...>()> async(EventLoop& loop, const Args... args) const {
+        return { loop, session, index, metrics, args... };
+    }
+
+private:
+    PluginSession* session = nullptr;
+    uint32_t index = 0;
+    [[no_unique_address]] CallMetricsHandle metrics {};
+    // Set if the export is pure and the host caches its results
+    ResultCache* results = nullptr;
+    uint32_t pure_id = 0;
+};
+
+// Exports of the example plugins, resolved once per session
+struct PluginExports {
+    PluginFn<int32_t(int32_t, int32_t)> sum;
+    PluginFn<void()> test_print;
+    PluginFn<void()> test_file_io;
+    PluginFn<void()> test_host_fn;
+    // Optional exports, absent from plugins built before they were introduced
+    // Takes the address of a GuestArena and returns a string allocated from it
+    PluginFn<int32_t(int32_t)> get_arena_string;
+    PluginFn<int32_t(int32_t)> plugin_alloc;
+    PluginFn<void(int32_t, int32_t)> plugin_free;
+    PluginFn<void(int32_t, int32_t, int32_t)> sum_batch;
+    PluginFn<int32_t(int32_t)> sum_host_fn;
+    // Only exported by plugin_host_io.wasm, needs the host_lookup_batch import
+    PluginFn<int32_t(int32_t)> sum_host_lookups;
+    // Takes the addresses of a request and a response GuestRing
+    PluginFn<int32_t(int32_t, int32_t)> sum_ring;
+    // Takes the address of a PointsRequest message and a GuestArena, returns a PointsSummary from the arena
+    PluginFn<int32_t(int32_t, int32_t)> sum_points;
+    // Only exported by plugin_host_io.wasm, need the host's file imports (HostImports::files)
+    PluginFn<void()> test_bulk_file_io;
+    // Takes the address of a NUL-terminated file name and whether to read it through the file imports or WASI
+    PluginFn<int64_t(int32_t, int32_t)> sum_file_bytes;
+    // Malloc'ed string and its free, replaced by get_arena_string and only found in older plugin builds
+    PluginFn<int32_t()> get_heap_allocated_string;
+    PluginFn<void(int32_t)> free_heap_allocated_string;
+    // Only exported by pre-initialized plugins
+    PluginFn<void()> restore_globals;
+
+    PluginSession* session = nullptr;
+
+    GuestMemoryView memory_view() const { return session->memory_view(); }
+};
+
+// One instantiated plugin, on whichever engine its host runs on
+struct PluginInstance {
+    const PluginHost* host = nullptr;
+    std::unique_ptr<PluginSession> session;
+    PluginExports exports;
+    // Set for instances of a pre-initialized plugin
+    std::shared_ptr<const PluginSnapshot> snapshot;
+
+    bool is_poisoned() const { return session->is_poisoned(); }
+
+    // Created before its host upgraded to a higher tier, replacing it gets the faster code
+    bool is_outdated() const { return session->compile_tier() < host->current_tier(); }
+
+    // Puts the instance back into its snapshot state by copying back the pages that changed. False if it has no
+    // snapshot or should not be reset in place, e.g. because its memory grew or it is outdated, and has to be
+    // replaced instead
+    bool reset();
+};
+
+std::unique_ptr<PluginInstance> instantiate_plugin(PluginHost& host, std::shared_ptr<const PluginSnapshot> snapshot = nullptr);
+
+// Whether the host's plugin has every export instantiate_plugin() requires, checked without instantiating it
+bool has_required_exports(const PluginHost& host);
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Runs plugin calls on a fixed set of worker threads. The engine and compiled module are shared, while every
+// worker owns its own store and instance, so calls never contend on a store. Each worker has its own task
+// deque: it pops its newest task and, when idle, steals the oldest task of another worker.
+template<typename Instance>
+class PluginExecutor {
+public:
+    using Factory = std::function<std::unique_ptr<Instance>()>;
+
+    // `factory` runs once on every worker thread. Workers whose instance fails to build take no tasks, and a worker
+    // retires once its instance traps and cannot be rebuilt
+    PluginExecutor(Factory factory, const size_t thread_count) : factory(std::move(factory)) {
+        workers.reserve(thread_count);
+        for (size_t i = 0; i < thread_count; i++) {
+            workers.push_back(std::make_unique<Worker>());
+        }
+        for (size_t i = 0; i < thread_count; i++) {
+            workers[i]->thread = std::thread([this, i] { run(i); });
+        }
+        std::unique_lock lock(wake_mutex);
+        started.wait(lock, [&] { return starting_workers == thread_count; });
+    }
+
+    PluginExecutor(const PluginExecutor&) = delete;
+    PluginExecutor& operator=(const PluginExecutor&) = delete;
+
+    // Finishes every submitted task before joining the workers
+    ~PluginExecutor() {
+        {
+            std::lock_guard lock(wake_mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            worker->thread.join();
+        }
+    }
+
+    size_t live_workers() const { return live_worker_count.load(); }
+
+    // Queues `task(Instance&)` and returns a future for its result. The future reports a broken promise if no
+    // worker is live to run it, because none managed to build an instance or all of them retired
+    template<typename F>
+    auto submit(F&& task) -> std::future<std::invoke_result_t<F&, Instance&>> {
+        using R = std::invoke_result_t<F&, Instance&>;
+        std::packaged_task<R(Instance&)> packaged(std::forward<F>(task));
+        auto future = packaged.get_future();
+        if (live_worker_count.load() == 0) {
+            return future;
+        }
+
+        const size_t first = next_worker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+        size_t index = first;
+        while (!workers[index]->live) {
+            index = (index + 1) % workers.size();
+            if (index == first) {
+                return future;
+            }
+        }
+        {
+            // Counted before it is queued, so a worker popping it right away never takes pending below zero
+            std::lock_guard lock(wake_mutex);
+            pending++;
+        }
+        {
+            std::lock_guard lock(workers[index]->mutex);
+            workers[index]->tasks.emplace_back(std::move(packaged));
+        }
+        // The last worker may have retired after it was picked and missed this task while dropping the queues
+        if (live_worker_count.load() == 0) {
+            drop_queued_tasks();
+        }
+        wake.notify_one();
+        return future;
+    }
+
+private:
+    using Task = std::move_only_function<void(Instance&)>;
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::thread thread;
+        std::atomic<bool> live = false;
+    };
+
+    bool pop_own(Worker& worker, Task& task) {
+        std::lock_guard lock(worker.mutex);
+        if (worker.tasks.empty()) {
+            return false;
+        }
+        task = std::move(worker.tasks.back());
+        worker.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(const size_t thief, Task& task) {
+        for (size_t offset = 1; offset < workers.size(); offset++) {
+            Worker& victim = *workers[(thief + offset) % workers.size()];
+            std::lock_guard lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Destroying the tasks makes their futures report a broken promise
+    void drop_queued_tasks() {
+        for (auto& worker : workers) {
+            std::deque<Task> dropped;
+            {
+                std::lock_guard lock(worker->mutex);
+                dropped.swap(worker->tasks);
+            }
+            pending.fetch_sub(dropped.size(), std::memory_order_relaxed);
+        }
+    }
+
+    // Other workers steal the tasks still queued on a retired worker, the last one to retire drops them instead
+    void retire(Worker& worker) {
+        worker.live = false;
+        if (live_worker_count.fetch_sub(1) == 1) {
+            drop_queued_tasks();
+        }
+        // The wakeup for the retired worker's tasks may have gone to the worker itself
+        wake.notify_all();
+    }
+
+    void run(const size_t index) {
+        Worker& worker = *workers[index];
+        auto instance = factory();
+        if (instance) {
+            worker.live = true;
+            live_worker_count++;
+        }
+        {
+            std::lock_guard lock(wake_mutex);
+            starting_workers++;
+        }
+        started.notify_all();
+        if (!instance) {
+            return;
+        }
+
+        Task task;
+        while (true) {
+            if (pop_own(worker, task) || steal(index, task)) {
+                // Only increments need the lock, they are what a sleeping worker waits on
+                pending.fetch_sub(1, std::memory_order_relaxed);
+                task(*instance);
+                task = nullptr;
+                if constexpr (requires { instance->is_poisoned(); }) {
+                    // A trapped instance is rebuilt before the next task. One that cannot be rebuilt must not run
+                    // more calls on its half-updated state, so its worker retires
+                    if (instance->is_poisoned()) {
+                        auto fresh = factory();
+                        if (!fresh) {
+                            retire(worker);
+                            return;
+                        }
+                        instance = std::move(fresh);
+                    }
+                }
+                if constexpr (requires { instance->is_outdated(); }) {
+                    // Workers outlive tier upgrades, so they pick up newer code between tasks
+                    if (instance->is_outdated()) {
+                        if (auto fresh = factory()) {
+                            instance = std::move(fresh);
+                        }
+                    }
+                }
+                continue;
+            }
+            std::unique_lock lock(wake_mutex);
+            wake.wait(lock, [&] { return stopping || pending > 0; });
+            if (stopping && pending == 0) {
+                return;
+            }
+        }
+    }
+
+    Factory factory;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<size_t> next_worker = 0;
+    std::atomic<size_t> live_worker_count = 0;
+
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    std::condition_variable started;
+    size_t starting_workers = 0;
+    std::atomic<size_t> pending = 0;
+    bool stopping = false;
+};
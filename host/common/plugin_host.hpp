@@ -0,0 +1,180 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "guest_memory.hpp"
+#include "host_imports.hpp"
+#include "plugin_values.hpp"
+#include "result_cache.hpp"
+
+// Backend-agnostic plugin interfaces. Each wasm engine implements them in its own shared module, loaded at runtime
+// with load_plugin_engine(), since the engines export the same wasm C API symbols and cannot share a process image.
+
+class PluginMetrics;
+
+// How an engine announces the native code it compiles to profilers outside the process, so they can symbolize it
+enum class JitProfiler : uint8_t {
+    None,
+    // /tmp/perf-<pid>.map, read by `perf report`
+    PerfMap,
+    // jit-<pid>.dump in the working directory, merged by `perf inject --jit` and kept across runs
+    JitDump,
+};
+
+// Engine-wide settings every backend understands
+struct EngineSettings {
+    // Reserve memory for this many concurrent instances up front, 0 allocates on demand
+    uint32_t max_instances = 0;
+    // Compile plugins with interruption checks at function entries and loop headers so calls can be given a
+    // time budget: epoch checks on wasmtime, metering on wasmer. Without them a call runs until it returns
+    bool interruptible = false;
+    // How often the epoch advances, budgets are rounded up to whole ticks
+    std::chrono::milliseconds epoch_tick { 1 };
+    // Run guest code on stacks of its own so calls and host imports can suspend, see PluginSession::call_async.
+    // Only wasmtime supports it
+    bool async_calls = false;
+    // Compile plugins with a fast baseline compiler first (Winch on wasmtime, Singlepass on wasmer), then recompile
+    // them with the optimizing compiler in the background and create new instances from that once it is done
+    bool tiered = false;
+    // Only wasmtime supports it
+    JitProfiler jit_profiler = JitProfiler::None;
+};
+
+// Quality of the code a host's instances run
+enum class CompileTier : uint8_t { Baseline, Optimized };
+
+constexpr std::string_view compile_tier_name(const CompileTier tier) {
+    return tier == CompileTier::Baseline ? "baseline" : "optimized";
+}
+
+// How one tier of a host's code was produced
+struct TierStats {
+    CompileTier tier = CompileTier::Optimized;
+    // Compile or cache load time, including linking
+    std::chrono::nanoseconds compile_time { 0 };
+    bool from_cache = false;
+};
+
+struct PluginHostOptions {
+    std::filesystem::path plugin_path;
+    // Module to load instead of reading plugin_path, which then only names the plugin. Only read during load()
+    std::span<const uint8_t> plugin_bytes;
+    // Directory of precompiled modules, empty to always compile
+    std::filesystem::path cache_dir = "cache";
+    WasiOptions wasi;
+    HostImports host_imports;
+    // Time budget of every call, including instantiation. Zero is unlimited, and budgets need an interruptible engine
+    std::chrono::milliseconds call_timeout { 0 };
+    // On tiered engines, recompile with the optimizing compiler once loaded. Short-lived hosts can stay on baseline
+    bool upgrade_tier = true;
+    // Where calls of the plugin's exports and host imports are recorded, null to not record them
+    std::shared_ptr<PluginMetrics> metrics;
+    // Sample the guest call stack of every instance on each epoch tick and write the samples to this file, in the
+    // Firefox Profiler format, once the host and its instances are gone. Code of the baseline tier is written to
+    // "<stem>-baseline<extension>" next to it. Empty to not profile. Only interruptible wasmtime engines support it
+    std::filesystem::path guest_profile;
+    // Which exports have their results cached, besides those the plugin declares pure itself, and how many results
+    ResultCacheOptions result_cache;
+};
+
+// A call started with PluginSession::call_async, advanced by polling it
+class PendingCall {
+public:
+    virtual ~PendingCall() = default;
+
+    // Runs the guest until it returns, suspends in an async host import or yields. True once the call is done
+    virtual bool poll() = 0;
+
+    // Whether the finished call returned normally, its results are then in the slots it was started with
+    virtual bool succeeded() const = 0;
+};
+
+// One isolated instance of a plugin, with its own store and memory
+class PluginSession {
+public:
+    virtual ~PluginSession() = default;
+
+    // Calls the function export at `index`. `slots` holds the arguments on entry and the results on return,
+    // so it must be as large as the larger of the two
+    virtual bool call(uint32_t index, std::span<PluginValue> slots) = 0;
+
+    // Starts a call that runs as far as it can on each poll. `slots` must stay valid until it is done.
+    // Empty if the engine was not created with async_calls
+    virtual std::unique_ptr<PendingCall> call_async(uint32_t, std::span<PluginValue>) { return nullptr; }
+
+    virtual GuestMemoryView memory_view() = 0;
+
+    // Set once a call traps or runs out of budget. The guest may have been stopped halfway through updating its
+    // own state, so the session should be replaced rather than called again
+    bool is_poisoned() const { return poisoned; }
+
+    // Tier of the code this session was instantiated from. Sessions keep running it after their host upgrades
+    CompileTier compile_tier() const { return tier; }
+
+protected:
+    bool poisoned = false;
+    CompileTier tier = CompileTier::Optimized;
+};
+
+// A compiled plugin, ready to be instantiated any number of times
+class PluginHost {
+public:
+    virtual ~PluginHost() = default;
+
+    // Index of function export `name` if it has exactly `signature`. Indices are the same for every session
+    virtual std::optional<uint32_t> find_function(std::string_view name, const FunctionSignature& signature) const = 0;
+
+    virtual std::unique_ptr<PluginSession> instantiate() = 0;
+
+    // Tier new sessions are instantiated from
+    virtual CompileTier current_tier() const = 0;
+
+    // Every tier built so far, in the order they were published
+    virtual std::vector<TierStats> tier_stats() const = 0;
+
+    // Blocks until a background compile to a higher tier, if any, has finished or failed
+    virtual void wait_for_final_tier() = 0;
+
+    // Metrics calls into and out of the host's sessions are recorded in, null if they are not recorded
+    PluginMetrics* metrics() const { return call_metrics.get(); }
+
+    // Results of the plugin's pure exports, shared by its sessions. Null if it has none or caching is turned off
+    ResultCache* result_cache() const { return pure_results.get(); }
+
+protected:
+    std::shared_ptr<PluginMetrics> call_metrics;
+    // Created when the module is loaded, a reload gets an empty one along with the new host
+    std::unique_ptr<ResultCache> pure_results;
+};
+
+// A wasm engine. Hosts it loads must not outlive it
+class PluginEngine {
+public:
+    virtual ~PluginEngine() = default;
+
+    virtual std::string_view name() const = 0;
+    virtual std::string_view version() const = 0;
+
+    virtual std::unique_ptr<PluginHost> load(const PluginHostOptions& options) = 0;
+};
+
+// Bumped whenever the interfaces above change, backend modules built against another version are rejected
+constexpr uint32_t plugin_engine_abi_version = 9;
+
+#ifdef _WIN32
+#define PLUGIN_ENGINE_EXPORT extern "C" __declspec(dllexport)
+#else
+#define PLUGIN_ENGINE_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+// Entry point every backend module exports
+using CreatePluginEngineFn = PluginEngine* (*)(uint32_t abi_version, const EngineSettings& settings);
+constexpr auto create_plugin_engine_symbol = "create_plugin_engine";
@@ -0,0 +1,166 @@
+#include "plugin_metrics.hpp"
+
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <print>
+#include <system_error>
+
+// Histogram bounds of the Prometheus export, every power of two from about 1us to 17s. They fall on bucket
+// boundaries of the recorded histograms, so the export loses resolution but never misplaces a call
+constexpr uint32_t prometheus_first_bound_bits = 10;
+constexpr uint32_t prometheus_last_bound_bits = 34;
+
+struct PluginStats {
+    std::string name;
+    std::vector<std::pair<std::string, CallStats>> exports;
+    std::vector<std::pair<std::string, CallStats>> imports;
+};
+
+static std::vector<PluginStats> collect_stats(const std::map<std::string, std::shared_ptr<PluginMetrics>, std::less<>>& plugins) {
+    std::vector<PluginStats> stats;
+    for (const auto& [name, metrics] : plugins) {
+        stats.push_back({ name, metrics->export_stats(), metrics->import_stats() });
+    }
+    return stats;
+}
+
+// Escapes `value` for a Prometheus label value or a JSON string, which need the same three characters escaped
+static std::string escape(const std::string_view value) {
+    std::string escaped;
+    for (const char c : value) {
+        if (c == '\\' || c == '"') {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (c == '\n') {
+            escaped += "\\n";
+        }
+        else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+static void append_counter(std::string& out, const std::vector<PluginStats>& plugins, const bool imports, const std::string_view metric, const std::string_view help, uint64_t CallStats::* field) {
+    std::format_to(std::back_inserter(out), "# HELP {} {}\n# TYPE {} counter\n", metric, help, metric);
+    for (const auto& plugin : plugins) {
+        for (const auto& [name, stats] : imports ? plugin.imports : plugin.exports) {
+            std::format_to(std::back_inserter(out), "{}{{plugin=\"{}\",{}=\"{}\"}} {}\n", metric, escape(plugin.name), imports ? "import" : "export", escape(name), stats.*field);
+        }
+    }
+}
+
+static void append_latency_histogram(std::string& out, const std::vector<PluginStats>& plugins, const bool imports, const std::string_view metric, const std::string_view help) {
+    std::format_to(std::back_inserter(out), "# HELP {} {}\n# TYPE {} histogram\n", metric, help, metric);
+    for (const auto& plugin : plugins) {
+        for (const auto& [name, stats] : imports ? plugin.imports : plugin.exports) {
+            const auto labels = std::format("plugin=\"{}\",{}=\"{}\"", escape(plugin.name), imports ? "import" : "export", escape(name));
+            uint64_t cumulative = 0;
+            size_t bucket = 0;
+            for (uint32_t bits = prometheus_first_bound_bits; bits <= prometheus_last_bound_bits; bits++) {
+                const uint64_t bound = uint64_t { 1 } << bits;
+                for (; bucket < latency_bucket_count && latency_bucket_end(bucket) <= bound; bucket++) {
+                    cumulative += stats.latency[bucket];
+                }
+                std::format_to(std::back_inserter(out), "{}_bucket{{{},le=\"{:g}\"}} {}\n", metric, labels, static_cast<double>(bound) / 1e9, cumulative);
+            }
+            std::format_to(std::back_inserter(out), "{}_bucket{{{},le=\"+Inf\"}} {}\n", metric, labels, stats.calls);
+            std::format_to(std::back_inserter(out), "{}_sum{{{}}} {:g}\n", metric, labels, static_cast<double>(stats.total_ns) / 1e9);
+            std::format_to(std::back_inserter(out), "{}_count{{{}}} {}\n", metric, labels, stats.calls);
+        }
+    }
+}
+
+static void append_json_calls(std::string& out, const std::vector<std::pair<std::string, CallStats>>& calls) {
+    out += '{';
+    for (size_t i = 0; i < calls.size(); i++) {
+        const auto& [name, stats] = calls[i];
+        std::format_to(std::back_inserter(out),
+            R"({}"{}":{{"calls":{},"traps":{},"memory_growths":{},"memory_high_water_bytes":{},"latency_ns":{{"mean":{:.1f},"p50":{},"p90":{},"p99":{},"p999":{}}}}})",
+            i == 0 ? "" : ",", escape(name), stats.calls, stats.traps, stats.memory_growths, stats.memory_high_water, stats.mean_ns(),
+            stats.latency_quantile_ns(0.5), stats.latency_quantile_ns(0.9), stats.latency_quantile_ns(0.99), stats.latency_quantile_ns(0.999));
+    }
+    out += '}';
+}
+
+std::shared_ptr<PluginMetrics> MetricsRegistry::plugin(const std::string_view name) {
+    std::lock_guard lock(mutex);
+    auto found = plugins.find(name);
+    if (found == plugins.end()) {
+        found = plugins.emplace(std::string(name), std::make_shared<PluginMetrics>(std::string(name))).first;
+    }
+    return found->second;
+}
+
+std::string MetricsRegistry::prometheus_text() const {
+    std::vector<PluginStats> stats;
+    {
+        std::lock_guard lock(mutex);
+        stats = collect_stats(plugins);
+    }
+    std::string out;
+    append_counter(out, stats, false, "plugin_export_calls_total", "Calls of a plugin export", &CallStats::calls);
+    append_counter(out, stats, false, "plugin_export_traps_total", "Calls of a plugin export that trapped or ran out of budget", &CallStats::traps);
+    append_counter(out, stats, false, "plugin_export_memory_growths_total", "Calls of a plugin export that grew the instance's memory", &CallStats::memory_growths);
+    append_latency_histogram(out, stats, false, "plugin_export_latency_seconds", "Latency of plugin export calls");
+    append_counter(out, stats, true, "plugin_import_calls_total", "Calls of a host import", &CallStats::calls);
+    append_latency_histogram(out, stats, true, "plugin_import_latency_seconds", "Latency of host import calls");
+
+    out += "# HELP plugin_memory_high_water_bytes Largest linear memory of any instance of a plugin after a call\n";
+    out += "# TYPE plugin_memory_high_water_bytes gauge\n";
+    for (const auto& plugin : stats) {
+        uint64_t high_water = 0;
+        for (const auto& [name, call_stats] : plugin.exports) {
+            high_water = std::max(high_water, call_stats.memory_high_water);
+        }
+        std::format_to(std::back_inserter(out), "plugin_memory_high_water_bytes{{plugin=\"{}\"}} {}\n", escape(plugin.name), high_water);
+    }
+    return out;
+}
+
+std::string MetricsRegistry::json() const {
+    std::vector<PluginStats> stats;
+    {
+        std::lock_guard lock(mutex);
+        stats = collect_stats(plugins);
+    }
+    std::string out = "{\"plugins\":[";
+    for (size_t i = 0; i < stats.size(); i++) {
+        const auto& plugin = stats[i];
+        uint64_t high_water = 0;
+        for (const auto& [name, call_stats] : plugin.exports) {
+            high_water = std::max(high_water, call_stats.memory_high_water);
+        }
+        std::format_to(std::back_inserter(out), R"({}{{"name":"{}","memory_high_water_bytes":{},"exports":)", i == 0 ? "" : ",", escape(plugin.name), high_water);
+        append_json_calls(out, plugin.exports);
+        out += ",\"imports\":";
+        append_json_calls(out, plugin.imports);
+        out += '}';
+    }
+    out += "]}\n";
+    return out;
+}
+
+bool MetricsRegistry::write(const std::filesystem::path& path) const {
+    const auto text = path.extension() == ".json" ? json() : prometheus_text();
+    auto temp_path = path;
+    temp_path += std::format(".{}.tmp", std::chrono::steady_clock::now().time_since_epoch().count());
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file || !file.write(text.data(), static_cast<std::streamsize>(text.size()))) {
+            std::println("ERROR: Failed to write metrics file \"{}\"", temp_path.string());
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temp_path, path, error);
+    if (error) {
+        std::println("ERROR: Failed to publish metrics file \"{}\": {}", path.string(), error.message());
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+    return true;
+}
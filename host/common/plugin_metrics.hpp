@@ -0,0 +1,308 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "host_imports.hpp"
+#include "plugin_values.hpp"
+
+// Per-export and per-import call metrics, compiled in with the PLUGIN_HOST_METRICS option. Without it every
+// recording site compiles away and the handles that would point at metrics take no space
+#ifdef PLUGIN_HOST_METRICS
+constexpr bool metrics_enabled = true;
+#else
+constexpr bool metrics_enabled = false;
+#endif
+
+// Log-linear latency buckets in the style of HdrHistogram: each power of two is split into 8 linear sub-buckets,
+// so a recorded latency is off by at most 12.5%. Latencies from 2^40ns, about 18 minutes, share the last bucket
+constexpr uint32_t latency_sub_bucket_bits = 3;
+constexpr uint32_t latency_max_bits = 40;
+constexpr size_t latency_sub_buckets = size_t { 1 } << latency_sub_bucket_bits;
+constexpr size_t latency_bucket_count = (latency_max_bits - latency_sub_bucket_bits + 1) * latency_sub_buckets;
+
+constexpr size_t latency_bucket(uint64_t ns) {
+    ns = std::min(ns, (uint64_t { 1 } << latency_max_bits) - 1);
+    if (ns < latency_sub_buckets) {
+        return ns;
+    }
+    const uint32_t msb = static_cast<uint32_t>(std::bit_width(ns)) - 1;
+    const uint64_t sub_bucket = (ns >> (msb - latency_sub_bucket_bits)) & (latency_sub_buckets - 1);
+    return (msb - latency_sub_bucket_bits + 1) * latency_sub_buckets + sub_bucket;
+}
+
+// Smallest latency past `bucket`
+constexpr uint64_t latency_bucket_end(const size_t bucket) {
+    if (bucket < latency_sub_buckets) {
+        return bucket + 1;
+    }
+    const size_t shift = bucket / latency_sub_buckets - 1;
+    return (latency_sub_buckets + bucket % latency_sub_buckets + 1) << shift;
+}
+
+// Totals of one export or import, merged from every thread's shard
+struct CallStats {
+    uint64_t calls = 0;
+    // Calls that trapped or ran out of budget
+    uint64_t traps = 0;
+    // Calls after which the instance's memory was larger than before
+    uint64_t memory_growths = 0;
+    // Largest memory of an instance after a call, in bytes
+    uint64_t memory_high_water = 0;
+    uint64_t total_ns = 0;
+    std::array<uint64_t, latency_bucket_count> latency {};
+
+    double mean_ns() const { return calls ? static_cast<double>(total_ns) / static_cast<double>(calls) : 0.0; }
+
+    // Latency that `quantile` of the calls stayed below, rounded up to the end of its bucket
+    uint64_t latency_quantile_ns(const double quantile) const {
+        if (calls == 0) {
+            return 0;
+        }
+        const auto target = std::max(uint64_t { 1 }, static_cast<uint64_t>(std::ceil(quantile * static_cast<double>(calls))));
+        uint64_t seen = 0;
+        for (size_t bucket = 0; bucket < latency.size(); bucket++) {
+            seen += latency[bucket];
+            if (seen >= target) {
+                return latency_bucket_end(bucket);
+            }
+        }
+        return 0;
+    }
+};
+
+// Index of the calling thread among all threads that recorded metrics
+inline size_t metrics_thread_index() {
+    static std::atomic<size_t> next_index = 0;
+    thread_local const size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+// Counters of one export or import. Each thread records into a shard of its own, allocated on its first call, so
+// recording takes no lock and threads do not share cache lines. Only more threads than shards share one
+class CallMetrics {
+public:
+    CallMetrics() = default;
+    CallMetrics(const CallMetrics&) = delete;
+    CallMetrics& operator=(const CallMetrics&) = delete;
+    ~CallMetrics() {
+        for (auto& shard : shards) {
+            delete shard.load(std::memory_order_relaxed);
+        }
+    }
+
+    void record(const std::chrono::nanoseconds elapsed, const bool trapped = false, const size_t memory_before = 0, const size_t memory_after = 0) {
+        const auto ns = static_cast<uint64_t>(std::max(elapsed.count(), std::chrono::nanoseconds::rep { 0 }));
+        Shard& shard = local_shard();
+        shard.calls.fetch_add(1, std::memory_order_relaxed);
+        shard.total_ns.fetch_add(ns, std::memory_order_relaxed);
+        shard.latency[latency_bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+        if (trapped) {
+            shard.traps.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (memory_after > memory_before) {
+            shard.memory_growths.fetch_add(1, std::memory_order_relaxed);
+        }
+        // Only written when a new mark is reached, which memory growth makes rare
+        uint64_t high_water = memory_high_water.load(std::memory_order_relaxed);
+        while (memory_after > high_water && !memory_high_water.compare_exchange_weak(high_water, memory_after, std::memory_order_relaxed)) {}
+    }
+
+    CallStats stats() const {
+        CallStats stats;
+        stats.memory_high_water = memory_high_water.load(std::memory_order_relaxed);
+        for (const auto& slot : shards) {
+            const Shard* shard = slot.load(std::memory_order_acquire);
+            if (!shard) {
+                continue;
+            }
+            stats.calls += shard->calls.load(std::memory_order_relaxed);
+            stats.traps += shard->traps.load(std::memory_order_relaxed);
+            stats.memory_growths += shard->memory_growths.load(std::memory_order_relaxed);
+            stats.total_ns += shard->total_ns.load(std::memory_order_relaxed);
+            for (size_t bucket = 0; bucket < latency_bucket_count; bucket++) {
+                stats.latency[bucket] += shard->latency[bucket].load(std::memory_order_relaxed);
+            }
+        }
+        return stats;
+    }
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> calls = 0;
+        std::atomic<uint64_t> traps = 0;
+        std::atomic<uint64_t> memory_growths = 0;
+        std::atomic<uint64_t> total_ns = 0;
+        std::array<std::atomic<uint64_t>, latency_bucket_count> latency {};
+    };
+
+    static constexpr size_t shard_count = 64;
+
+    Shard& local_shard() {
+        auto& slot = shards[metrics_thread_index() % shard_count];
+        Shard* shard = slot.load(std::memory_order_acquire);
+        if (!shard) {
+            auto* created = new Shard;
+            if (slot.compare_exchange_strong(shard, created, std::memory_order_acq_rel)) {
+                shard = created;
+            }
+            else {
+                delete created;
+            }
+        }
+        return *shard;
+    }
+
+    std::array<std::atomic<Shard*>, shard_count> shards {};
+    std::atomic<uint64_t> memory_high_water = 0;
+};
+
+// Metrics of one plugin, shared by its hosts and all their instances. Entries are created when a call site is
+// bound and live as long as the plugin's metrics, so calls only follow a pointer
+class PluginMetrics {
+public:
+    explicit PluginMetrics(std::string plugin) : plugin(std::move(plugin)) {}
+    PluginMetrics(const PluginMetrics&) = delete;
+    PluginMetrics& operator=(const PluginMetrics&) = delete;
+
+    const std::string& name() const { return plugin; }
+
+    CallMetrics& export_metrics(const std::string_view name) { return entry(exports, name); }
+
+    // Named "<module>.<name>", e.g. "env.host_fn"
+    CallMetrics& import_metrics(const std::string_view name) { return entry(imports, name); }
+
+    std::vector<std::pair<std::string, CallStats>> export_stats() const { return stats(exports); }
+    std::vector<std::pair<std::string, CallStats>> import_stats() const { return stats(imports); }
+
+private:
+    using Entries = std::map<std::string, std::unique_ptr<CallMetrics>, std::less<>>;
+
+    CallMetrics& entry(Entries& entries, const std::string_view name) {
+        std::lock_guard lock(mutex);
+        auto found = entries.find(name);
+        if (found == entries.end()) {
+            found = entries.emplace(std::string(name), std::make_unique<CallMetrics>()).first;
+        }
+        return *found->second;
+    }
+
+    std::vector<std::pair<std::string, CallStats>> stats(const Entries& entries) const {
+        std::lock_guard lock(mutex);
+        std::vector<std::pair<std::string, CallStats>> stats;
+        for (const auto& [name, metrics] : entries) {
+            stats.emplace_back(name, metrics->stats());
+        }
+        return stats;
+    }
+
+    std::string plugin;
+    mutable std::mutex mutex;
+    Entries exports;
+    Entries imports;
+};
+
+// Stand-in for a metrics pointer when metrics are compiled out
+struct NoCallMetrics {};
+using CallMetricsHandle = std::conditional_t<metrics_enabled, CallMetrics*, NoCallMetrics>;
+
+// Metrics of import `name` in `metrics`, which may be null
+template<typename Handle = CallMetricsHandle>
+Handle import_metrics_handle(PluginMetrics* metrics, const std::string_view name) {
+    if constexpr (metrics_enabled) {
+        return metrics ? &metrics->import_metrics(name) : nullptr;
+    }
+    else {
+        return {};
+    }
+}
+
+// Calls a host import's implementation, timing it if it has metrics
+template<typename Handle, typename F, typename... Args>
+decltype(auto) record_import_call(const Handle metrics, F&& fn, Args&&... args) {
+    if constexpr (metrics_enabled) {
+        if (metrics) {
+            const auto start = std::chrono::steady_clock::now();
+            struct Recorder {
+                CallMetrics* metrics;
+                std::chrono::steady_clock::time_point start;
+                ~Recorder() { metrics->record(std::chrono::steady_clock::now() - start); }
+            } recorder { metrics, start };
+            return std::invoke(std::forward<F>(fn), std::forward<Args>(args)...);
+        }
+    }
+    return std::invoke(std::forward<F>(fn), std::forward<Args>(args)...);
+}
+
+// Wraps an async host import so each call is recorded once it completes, not when it suspends the guest
+template<typename Handle>
+AsyncHostFn record_async_import(const Handle metrics, AsyncHostFn fn) {
+    if constexpr (metrics_enabled) {
+        if (metrics && fn) {
+            class RecordedHostCall final : public PendingHostCall {
+            public:
+                RecordedHostCall(CallMetrics* metrics, std::unique_ptr<PendingHostCall> call)
+                    : metrics(metrics), call(std::move(call)), start(std::chrono::steady_clock::now()) {}
+
+                bool poll(const std::span<PluginValue> results) override {
+                    if (!call->poll(results)) {
+                        return false;
+                    }
+                    metrics->record(std::chrono::steady_clock::now() - start);
+                    return true;
+                }
+
+            private:
+                CallMetrics* metrics;
+                std::unique_ptr<PendingHostCall> call;
+                std::chrono::steady_clock::time_point start;
+            };
+            return [metrics, fn = std::move(fn)](const std::span<const PluginValue> args) -> std::unique_ptr<PendingHostCall> {
+                auto call = fn(args);
+                if (!call) {
+                    return nullptr;
+                }
+                return std::make_unique<RecordedHostCall>(metrics, std::move(call));
+            };
+        }
+    }
+    return fn;
+}
+
+// Metrics of every plugin a host runs, exported on demand
+class MetricsRegistry {
+public:
+    // Metrics of plugin `name`, created on first use. Hosts loaded under the same name share them
+    std::shared_ptr<PluginMetrics> plugin(std::string_view name);
+
+    // Prometheus text exposition format, with latencies as histograms in seconds
+    std::string prometheus_text() const;
+
+    // One object per plugin, with latency percentiles instead of buckets
+    std::string json() const;
+
+    // Writes json() to paths ending in ".json" and prometheus_text() to any other, e.g. for node_exporter's
+    // textfile collector. The file is replaced in one rename, so readers never see a partial snapshot
+    bool write(const std::filesystem::path& path) const;
+
+private:
+    mutable std::mutex mutex;
+    std::map<std::string, std::shared_ptr<PluginMetrics>, std::less<>> plugins;
+};
@@ -0,0 +1,115 @@
+#include "plugin_registry.hpp"
+
+#include <algorithm>
+#include <print>
+#include <system_error>
+#include <thread>
+
+#include "mapped_file.hpp"
+#include "wasm_rewriter.hpp"
+
+size_t PluginRegistry::load_directory(const std::filesystem::path& directory, const size_t threads) {
+    std::vector<std::filesystem::path> paths;
+    std::error_code error;
+    for (auto it = std::filesystem::recursive_directory_iterator(directory, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+        if (it->is_regular_file() && it->path().extension() == ".wasm") {
+            paths.push_back(it->path());
+        }
+    }
+    if (error) {
+        std::println("ERROR: Failed to scan plugin directory \"{}\": {}", directory.string(), error.message());
+        return 0;
+    }
+    if (paths.empty()) {
+        return 0;
+    }
+    // Sorted so that plugin order does not depend on the file system
+    std::ranges::sort(paths);
+
+    // Plugins compile independently, so with enough cores startup takes about as long as the slowest compile
+    std::vector<std::unique_ptr<Entry>> loaded(paths.size());
+    std::atomic<size_t> next = 0;
+    {
+        std::vector<std::jthread> workers;
+        for (size_t i = 0; i < std::clamp<size_t>(threads, 1, paths.size()); i++) {
+            workers.emplace_back([&] {
+                for (size_t index = next++; index < paths.size(); index = next++) {
+                    auto name = std::filesystem::relative(paths[index], directory).replace_extension().generic_string();
+                    loaded[index] = load_plugin(paths[index], std::move(name));
+                }
+            });
+        }
+    }
+
+    size_t added = 0;
+    for (auto& entry : loaded) {
+        if (!entry) {
+            continue;
+        }
+        auto name = entry->name;
+        if (!plugins.try_emplace(std::move(name), std::move(entry)).second) {
+            std::println("ERROR: Skipping plugin {}, a plugin of the same name is already loaded", name);
+            continue;
+        }
+        added++;
+    }
+    return added;
+}
+
+std::unique_ptr<PluginRegistry::Entry> PluginRegistry::load_plugin(const std::filesystem::path& path, std::string name) const {
+    const auto wasm_file = read_file_bytes(path);
+    if (!wasm_file) {
+        std::println("ERROR: Failed to read plugin file \"{}\"", path.string());
+        return nullptr;
+    }
+    // Checked before compiling, a plugin that could never be instantiated is not worth the compile time
+    const auto imports = read_function_imports(*wasm_file);
+    if (!imports) {
+        std::println("ERROR: Skipping plugin {}, its imports cannot be read", name);
+        return nullptr;
+    }
+    for (const auto& import : *imports) {
+        if (!provides_import(options.host_imports, import.module, import.name, import.signature)) {
+            std::println("ERROR: Skipping plugin {}, the host does not provide its import {}.{}", name, import.module, import.name);
+            return nullptr;
+        }
+    }
+
+    PluginHostOptions plugin_options = options;
+    plugin_options.plugin_path = path;
+    plugin_options.plugin_bytes = *wasm_file;
+    auto entry = std::make_unique<Entry>();
+    entry->name = std::move(name);
+    entry->host = engine.load(plugin_options);
+    if (!entry->host || !has_required_exports(*entry->host)) {
+        std::println("ERROR: Skipping plugin {}", entry->name);
+        return nullptr;
+    }
+    return entry;
+}
+
+std::vector<std::string> PluginRegistry::names() const {
+    std::vector<std::string> names;
+    names.reserve(plugins.size());
+    for (const auto& [name, entry] : plugins) {
+        names.push_back(name);
+    }
+    return names;
+}
+
+PluginInstance* PluginRegistry::get(const std::string_view name) {
+    const auto found = plugins.find(name);
+    if (found == plugins.end()) {
+        return nullptr;
+    }
+    Entry& entry = *found->second;
+    std::lock_guard lock(entry.mutex);
+    if (!entry.instance && !entry.failed) {
+        entry.instance = instantiate_plugin(*entry.host);
+        entry.failed = !entry.instance;
+        if (entry.instance) {
+            instantiated.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    return entry.instance.get();
+}
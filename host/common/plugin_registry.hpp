@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "plugin_api.hpp"
+#include "plugin_host.hpp"
+
+// Plugins compiled from every .wasm file below a directory. Each is only instantiated once it is first used, so
+// plugins that are never called cost their compiled code but no instance memory
+class PluginRegistry {
+public:
+    // `options` applies to every plugin, its plugin_path and plugin_bytes are ignored. The engine must outlive
+    // the registry
+    PluginRegistry(PluginEngine& engine, PluginHostOptions options) : engine(engine), options(std::move(options)) {}
+    PluginRegistry(const PluginRegistry&) = delete;
+    PluginRegistry& operator=(const PluginRegistry&) = delete;
+
+    // Validates and compiles the plugins on up to `threads` threads. Plugins whose imports the host does not
+    // provide, that lack required exports or fail to compile are reported and skipped. Returns how many were
+    // added. Must not run concurrently with get()
+    size_t load_directory(const std::filesystem::path& directory, size_t threads);
+
+    // Plugins are named by their path relative to the directory, without the extension
+    std::vector<std::string> names() const;
+
+    // The plugin's instance, created on first use. Null if there is no such plugin or it failed to instantiate.
+    // The instance is shared, so calls from several threads must be serialized by the caller
+    PluginInstance* get(std::string_view name);
+
+    size_t size() const { return plugins.size(); }
+    size_t instantiated_count() const { return instantiated.load(std::memory_order_relaxed); }
+
+private:
+    struct Entry {
+        std::string name;
+        std::unique_ptr<PluginHost> host;
+        std::mutex mutex;
+        std::unique_ptr<PluginInstance> instance;
+        // Set after a failed instantiation, which is not retried
+        bool failed = false;
+    };
+
+    std::unique_ptr<Entry> load_plugin(const std::filesystem::path& path, std::string name) const;
+
+    PluginEngine& engine;
+    PluginHostOptions options;
+    std::map<std::string, std::unique_ptr<Entry>, std::less<>> plugins;
+    std::atomic<size_t> instantiated { 0 };
+};
@@ -0,0 +1,121 @@
+#include "plugin_reloader.hpp"
+
+#include <print>
+#include <system_error>
+
+#include "mapped_file.hpp"
+
+ReloadablePlugin::ReloadablePlugin(PluginEngine& engine, PluginHostOptions options, const size_t pool_capacity)
+    : engine(engine), options(std::move(options)), pool_capacity(pool_capacity) {}
+
+ReloadablePlugin::~ReloadablePlugin() {
+    if (watcher.joinable()) {
+        watcher.request_stop();
+        watcher.join();
+    }
+    current.store(nullptr);
+    reclaim_retired();
+}
+
+std::shared_ptr<PluginVersion> ReloadablePlugin::load_version() {
+    std::error_code error;
+    const auto modified = std::filesystem::last_write_time(options.plugin_path, error);
+    // Read into memory rather than mapped, the file may be rewritten while it is being compiled
+    const auto wasm = read_file_bytes(options.plugin_path);
+    if (error || !wasm) {
+        std::println("ERROR: Failed to read plugin file \"{}\"", options.plugin_path.string());
+        failed_modified = modified;
+        return nullptr;
+    }
+
+    PluginHostOptions version_options = options;
+    version_options.plugin_bytes = *wasm;
+    auto host = engine.load(version_options);
+    if (!host) {
+        failed_modified = modified;
+        return nullptr;
+    }
+    // The deleter hands old versions to the watcher, so the caller dropping the last lease never pays for the teardown
+    std::shared_ptr<PluginVersion> version(new PluginVersion, [this](PluginVersion* retiring) { retire(retiring); });
+    version->generation = next_generation++;
+    version->modified = modified;
+    version->host = std::move(host);
+    version->pool = std::make_unique<InstancePool<PluginInstance>>([host = version->host.get()] { return instantiate_plugin(*host); }, pool_capacity);
+    return version;
+}
+
+bool ReloadablePlugin::reload() {
+    std::lock_guard lock(reload_mutex);
+    reclaim_retired();
+    auto version = load_version();
+    if (!version) {
+        std::println("ERROR: Failed to load plugin \"{}\", keeping the current version", options.plugin_path.string());
+        return false;
+    }
+    const auto generation = version->generation;
+    current.store(std::move(version), std::memory_order_release);
+    std::println("Plugin \"{}\" is now at version {}", options.plugin_path.string(), generation);
+    return true;
+}
+
+void ReloadablePlugin::watch(const std::chrono::milliseconds interval) {
+    watcher = std::jthread([this, interval](const std::stop_token& stop) {
+        std::mutex wait_mutex;
+        while (!stop.stop_requested()) {
+            {
+                // Only a stop request ends the wait early
+                std::unique_lock lock(wait_mutex);
+                sleep.wait_for(lock, stop, interval, [] { return false; });
+            }
+            reclaim_retired();
+            if (stop.stop_requested()) {
+                break;
+            }
+            std::error_code error;
+            const auto modified = std::filesystem::last_write_time(options.plugin_path, error);
+            const auto version = current.load(std::memory_order_acquire);
+            if (error || (version && modified == version->modified)) {
+                continue;
+            }
+            {
+                // Written by load_version(), which may also run on a thread calling reload()
+                std::lock_guard lock(reload_mutex);
+                if (modified == failed_modified) {
+                    continue;
+                }
+            }
+            reload();
+        }
+    });
+}
+
+PluginLease ReloadablePlugin::acquire() {
+    auto version = current.load(std::memory_order_acquire);
+    if (!version) {
+        return {};
+    }
+    auto instance = version->pool->acquire();
+    return { std::move(version), std::move(instance) };
+}
+
+uint64_t ReloadablePlugin::generation() const {
+    const auto version = current.load(std::memory_order_acquire);
+    return version ? version->generation : 0;
+}
+
+void ReloadablePlugin::retire(PluginVersion* version) {
+    std::lock_guard lock(retired_mutex);
+    retired.push_back(version);
+}
+
+void ReloadablePlugin::reclaim_retired() {
+    std::vector<PluginVersion*> reclaimed;
+    {
+        std::lock_guard lock(retired_mutex);
+        reclaimed.swap(retired);
+    }
+    for (PluginVersion* version : reclaimed) {
+        std::println("Reclaiming version {} of plugin \"{}\"", version->generation, options.plugin_path.string());
+        delete version;
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "instance_pool.hpp"
+#include "plugin_api.hpp"
+#include "plugin_host.hpp"
+
+// One loaded version of a reloadable plugin, kept alive by the plugin while it is current and by every lease on it
+struct PluginVersion {
+    uint64_t generation = 0;
+    std::filesystem::file_time_type modified;
+    std::unique_ptr<PluginHost> host;
+    // Declared after the host, its instances go first
+    std::unique_ptr<InstancePool<PluginInstance>> pool;
+};
+
+// Exclusive use of an instance of the version that was current when it was acquired. A reload in the meantime
+// does not affect it, the call finishes on the old version
+class PluginLease {
+public:
+    PluginLease() = default;
+    PluginLease(std::shared_ptr<PluginVersion> version, InstancePool<PluginInstance>::Lease instance) : version(std::move(version)), instance(std::move(instance)) {}
+
+    explicit operator bool() const { return static_cast<bool>(instance); }
+    PluginInstance* operator->() const { return instance.operator->(); }
+    PluginInstance& operator*() const { return *instance; }
+
+    uint64_t generation() const { return version ? version->generation : 0; }
+
+    void discard() { instance.discard(); }
+
+private:
+    // Declared first so the instance is handed back to its pool before the version can go away
+    std::shared_ptr<PluginVersion> version;
+    InstancePool<PluginInstance>::Lease instance;
+};
+
+// A plugin that is replaced by a new version whenever its file changes, RCU style. acquire() only reads an atomic
+// pointer, and a reload compiles the new version off the call path and swaps it in. Old versions are torn down once
+// their last lease is gone, on the watcher thread rather than the caller's
+class ReloadablePlugin {
+public:
+    // The engine must outlive the plugin, and leases must not outlive either
+    ReloadablePlugin(PluginEngine& engine, PluginHostOptions options, size_t pool_capacity);
+    ReloadablePlugin(const ReloadablePlugin&) = delete;
+    ReloadablePlugin& operator=(const ReloadablePlugin&) = delete;
+    ~ReloadablePlugin();
+
+    // Loads the current file as a new version. On failure the previous version, if any, stays current
+    bool reload();
+
+    // Checks the file for changes every `interval` and reloads it on a background thread when it changed
+    void watch(std::chrono::milliseconds interval);
+
+    // Empty if no version is loaded or instantiation failed
+    PluginLease acquire();
+
+    uint64_t generation() const;
+
+private:
+    std::shared_ptr<PluginVersion> load_version();
+    void retire(PluginVersion* version);
+    void reclaim_retired();
+
+    PluginEngine& engine;
+    PluginHostOptions options;
+    size_t pool_capacity = 0;
+    std::atomic<std::shared_ptr<PluginVersion>> current;
+    // Serializes reloads, never taken by acquire()
+    std::mutex reload_mutex;
+    uint64_t next_generation = 1;
+    // Write time of the last file that failed to load, so a broken plugin is not recompiled on every check.
+    // Guarded by reload_mutex
+    std::filesystem::file_time_type failed_modified;
+
+    std::mutex retired_mutex;
+    std::vector<PluginVersion*> retired;
+    std::condition_variable_any sleep;
+    std::jthread watcher;
+};
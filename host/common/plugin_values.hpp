@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+enum class ValKind : uint8_t { I32, I64, F32, F64 };
+
+// A wasm scalar. Calls pass arguments and results in the same slots, like wasmtime's unchecked calls
+union PluginValue {
+    int32_t i32;
+    int64_t i64;
+    float f32;
+    double f64;
+};
+
+// Most slots a single call may use, exports with more parameters or results are not callable
+constexpr size_t max_call_slots = 16;
+
+struct FunctionSignature {
+    std::vector<ValKind> params;
+    std::vector<ValKind> results;
+
+    bool operator==(const FunctionSignature&) const = default;
+};
+
+// Maps a C++ scalar type to the wasm value kind it crosses the plugin boundary as
+template<typename T>
+struct PluginValKind;
+
+template<> struct PluginValKind<int32_t> { static constexpr ValKind value = ValKind::I32; };
+template<> struct PluginValKind<int64_t> { static constexpr ValKind value = ValKind::I64; };
+template<> struct PluginValKind<float> { static constexpr ValKind value = ValKind::F32; };
+template<> struct PluginValKind<double> { static constexpr ValKind value = ValKind::F64; };
+
+template<typename T>
+void store_value(PluginValue& slot, const T value) {
+    if constexpr (std::is_same_v<T, int32_t>) slot.i32 = value;
+    else if constexpr (std::is_same_v<T, int64_t>) slot.i64 = value;
+    else if constexpr (std::is_same_v<T, float>) slot.f32 = value;
+    else if constexpr (std::is_same_v<T, double>) slot.f64 = value;
+}
+
+template<typename T>
+T load_value(const PluginValue& slot) {
+    if constexpr (std::is_same_v<T, int32_t>) return slot.i32;
+    else if constexpr (std::is_same_v<T, int64_t>) return slot.i64;
+    else if constexpr (std::is_same_v<T, float>) return slot.f32;
+    else if constexpr (std::is_same_v<T, double>) return slot.f64;
+}
+
+template<typename R, typename... Args>
+const FunctionSignature& signature_of() {
+    static const FunctionSignature signature = [] {
+        FunctionSignature built { { PluginValKind<Args>::value... }, {} };
+        if constexpr (!std::is_void_v<R>) {
+            built.results.push_back(PluginValKind<R>::value);
+        }
+        return built;
+    }();
+    return signature;
+}
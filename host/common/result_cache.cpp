@@ -0,0 +1,150 @@
+#include "result_cache.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <print>
+
+#include "wasm_rewriter.hpp"
+
+ResultCache::ResultCache(std::vector<PureExport> exports, const ResultCacheOptions& options)
+    : exports(std::move(exports)), max_buffer_bytes(options.max_buffer_bytes) {
+    shard_count = std::clamp<size_t>(options.shards, 1, std::max<size_t>(options.capacity, 1));
+    shard_capacity = std::max<size_t>((options.capacity + shard_count - 1) / shard_count, 1);
+    shards = std::make_unique<Shard[]>(shard_count);
+}
+
+std::optional<uint32_t> ResultCache::find_export(const std::string_view name, const FunctionSignature& signature) const {
+    const auto found = std::ranges::find(exports, name, &PureExport::name);
+    if (found == exports.end() || signature.results.empty()) {
+        return std::nullopt;
+    }
+    const auto is_i32_param = [&](const uint32_t index) { return index < signature.params.size() && signature.params[index] == ValKind::I32; };
+    for (const BufferArg buffer : found->buffers) {
+        if (!is_i32_param(buffer.address) || !is_i32_param(buffer.length)) {
+            std::println(R"(ERROR: Pure export "{}" declares buffer arguments {}:{} that are not i32 parameters)", name, buffer.address, buffer.length);
+            return std::nullopt;
+        }
+    }
+    return static_cast<uint32_t>(found - exports.begin());
+}
+
+std::optional<PluginValue> ResultCache::find(const ResultKey& key) {
+    Shard& shard = shard_of(key);
+    std::lock_guard lock(shard.mutex);
+    const auto found = shard.slots.find(key);
+    if (found == shard.slots.end()) {
+        shard.misses++;
+        return std::nullopt;
+    }
+    shard.hits++;
+    Entry& entry = shard.entries[found->second];
+    entry.referenced = true;
+    return entry.result;
+}
+
+void ResultCache::insert(ResultKey key, const PluginValue result) {
+    Shard& shard = shard_of(key);
+    std::lock_guard lock(shard.mutex);
+    // Another thread may have made the same call in the meantime
+    if (shard.slots.contains(key)) {
+        return;
+    }
+    if (shard.entries.size() < shard_capacity) {
+        const auto slot = shard.slots.emplace(std::move(key), static_cast<uint32_t>(shard.entries.size())).first;
+        shard.entries.push_back({ &slot->first, result });
+        return;
+    }
+    while (shard.entries[shard.hand].referenced) {
+        shard.entries[shard.hand].referenced = false;
+        shard.hand = (shard.hand + 1) % shard.entries.size();
+    }
+    Entry& victim = shard.entries[shard.hand];
+    // Erased through an iterator, the victim's key lives in the node being erased
+    shard.slots.erase(shard.slots.find(*victim.key));
+    const auto slot = shard.slots.emplace(std::move(key), static_cast<uint32_t>(shard.hand)).first;
+    victim = { &slot->first, result };
+    shard.hand = (shard.hand + 1) % shard.entries.size();
+    shard.evictions++;
+}
+
+ResultCacheStats ResultCache::stats() const {
+    ResultCacheStats stats;
+    for (size_t i = 0; i < shard_count; i++) {
+        const Shard& shard = shards[i];
+        std::lock_guard lock(shard.mutex);
+        stats.hits += shard.hits;
+        stats.misses += shard.misses;
+        stats.evictions += shard.evictions;
+        stats.entries += shard.entries.size();
+    }
+    return stats;
+}
+
+static std::optional<uint32_t> parse_index(const std::string_view text) {
+    uint32_t index = 0;
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), index);
+    if (error != std::errc {} || end != text.data() + text.size() || index >= max_call_slots) {
+        return std::nullopt;
+    }
+    return index;
+}
+
+std::vector<PureExport> parse_pure_exports(std::string_view text) {
+    // NULs included, C plugins declare the section as a string literal
+    constexpr std::string_view whitespace { " \t\r\0", 4 };
+    std::vector<PureExport> exports;
+    while (!text.empty()) {
+        const size_t line_end = std::min(text.find('\n'), text.size());
+        std::string_view line = text.substr(0, line_end);
+        text.remove_prefix(std::min(line_end + 1, text.size()));
+
+        PureExport declared;
+        bool valid = true;
+        while (valid) {
+            const size_t start = line.find_first_not_of(whitespace);
+            if (start == std::string_view::npos) {
+                break;
+            }
+            line.remove_prefix(start);
+            const std::string_view word = line.substr(0, line.find_first_of(whitespace));
+            line.remove_prefix(word.size());
+            if (declared.name.empty()) {
+                declared.name = word;
+                continue;
+            }
+            const size_t colon = word.find(':');
+            const auto address = colon == std::string_view::npos ? std::nullopt : parse_index(word.substr(0, colon));
+            const auto length = colon == std::string_view::npos ? std::nullopt : parse_index(word.substr(colon + 1));
+            valid = address && length;
+            if (valid) {
+                declared.buffers.push_back({ *address, *length });
+            }
+        }
+        if (!valid) {
+            std::println(R"(ERROR: Malformed pure export declaration of "{}", expected "<export> [<address arg>:<length arg>]...")", declared.name);
+        }
+        else if (!declared.name.empty() && std::ranges::find(exports, declared.name, &PureExport::name) == exports.end()) {
+            exports.push_back(std::move(declared));
+        }
+    }
+    return exports;
+}
+
+std::unique_ptr<ResultCache> create_result_cache(const std::span<const uint8_t> wasm, const ResultCacheOptions& options) {
+    if (options.capacity == 0) {
+        return nullptr;
+    }
+    const auto section = read_custom_section(wasm, pure_exports_section);
+    auto exports = section ? parse_pure_exports({ reinterpret_cast<const char*>(section->data()), section->size() }) : std::vector<PureExport> {};
+    for (const auto& declaration : options.pure_exports) {
+        for (auto& declared : parse_pure_exports(declaration)) {
+            if (std::ranges::find(exports, declared.name, &PureExport::name) == exports.end()) {
+                exports.push_back(std::move(declared));
+            }
+        }
+    }
+    if (exports.empty()) {
+        return nullptr;
+    }
+    return std::make_unique<ResultCache>(std::move(exports), options);
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "guest_memory.hpp"
+#include "plugin_values.hpp"
+
+// Results of pure plugin exports, whose result only depends on their arguments, so a repeated call is answered
+// without entering wasm. Plugins declare their pure exports in a "plugin.pure" custom section, and hosts can add
+// more in ResultCacheOptions, both one declaration per line:
+//
+//   sum               every argument is a scalar, compared bit for bit
+//   checksum 0:1      arguments 0 and 1 are the address and length of a buffer, whose contents are part of the key
+//
+// The cache belongs to one PluginHost and is shared by all its sessions, so a reloaded plugin starts out empty
+
+constexpr std::string_view pure_exports_section = "plugin.pure";
+
+struct ResultCacheOptions {
+    // Declarations in the section's format, on top of those of the plugin
+    std::vector<std::string> pure_exports;
+    // Results kept over all shards, 0 turns the cache off
+    size_t capacity = 4096;
+    // Independently locked parts of the cache, so calls on different threads rarely wait on each other
+    size_t shards = 16;
+    // Calls whose buffer arguments add up to more are not cached, every key keeps a copy of its buffers
+    size_t max_buffer_bytes = 64 << 10;
+};
+
+struct ResultCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t entries = 0;
+
+    double hit_rate() const {
+        const uint64_t calls = hits + misses;
+        return calls ? static_cast<double>(hits) / static_cast<double>(calls) : 0.0;
+    }
+};
+
+// A buffer argument of a pure export, as the indices of its address and length arguments
+struct BufferArg {
+    uint32_t address = 0;
+    uint32_t length = 0;
+};
+
+struct PureExport {
+    std::string name;
+    std::vector<BufferArg> buffers;
+};
+
+// The arguments of one call of a pure export. Buffers are compared byte for byte, a hash collision alone never
+// returns the result of another call
+struct ResultKey {
+    uint64_t hash = 0;
+    uint32_t export_id = 0;
+    uint32_t arg_count = 0;
+    std::array<uint64_t, max_call_slots> args {};
+    // Contents of every buffer argument in declaration order, their lengths are among the arguments
+    std::vector<uint8_t> buffers;
+
+    bool operator==(const ResultKey&) const = default;
+};
+
+// Bits of an argument, the same for every call with the same value
+template<typename T>
+uint64_t key_bits(const T value) {
+    if constexpr (std::is_same_v<T, int32_t> || std::is_same_v<T, float>) {
+        return std::bit_cast<uint32_t>(value);
+    }
+    else {
+        return std::bit_cast<uint64_t>(value);
+    }
+}
+
+constexpr uint64_t hash_mix(const uint64_t hash, const uint64_t value) {
+    const uint64_t mixed = (hash ^ value) * 0x9e3779b97f4a7c15;
+    return mixed ^ (mixed >> 32);
+}
+
+// Eight bytes per step, buffers can be large
+inline uint64_t hash_buffer_words(const std::span<const uint8_t> bytes, uint64_t hash) {
+    size_t offset = 0;
+    for (; offset + sizeof(uint64_t) <= bytes.size(); offset += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, bytes.data() + offset, sizeof(word));
+        hash = hash_mix(hash, word);
+    }
+    uint64_t tail = 0;
+    if (offset < bytes.size()) {
+        std::memcpy(&tail, bytes.data() + offset, bytes.size() - offset);
+    }
+    return hash_mix(hash_mix(hash, tail), bytes.size());
+}
+
+class ResultCache {
+public:
+    ResultCache(std::vector<PureExport> exports, const ResultCacheOptions& options);
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    // Id of export `name` if it is declared pure and its buffer arguments are i32 parameters of `signature`
+    std::optional<uint32_t> find_export(std::string_view name, const FunctionSignature& signature) const;
+
+    // Key of a call of the pure export `export_id`. `memory` returns the caller's GuestMemoryView and is only called
+    // for exports with buffer arguments. Empty if a buffer is out of bounds or the buffers are larger than
+    // max_buffer_bytes, the call then is not cached
+    template<typename MemoryFn, typename... Args>
+    std::optional<ResultKey> key(const uint32_t export_id, MemoryFn&& memory, const Args... args) const {
+        static_assert(sizeof...(Args) <= max_call_slots);
+        ResultKey key { .export_id = export_id, .arg_count = sizeof...(Args) };
+        size_t arg = 0;
+        ((key.args[arg++] = key_bits(args)), ...);
+        uint64_t buffer_hash = 0;
+        if (const auto& buffers = exports[export_id].buffers; !buffers.empty()) {
+            const GuestMemoryView view = memory();
+            for (const BufferArg buffer : buffers) {
+                const auto bytes = view.span({ static_cast<uint32_t>(key.args[buffer.address]), static_cast<uint32_t>(key.args[buffer.length]) });
+                if (!bytes || bytes->size() > max_buffer_bytes - key.buffers.size()) {
+                    return std::nullopt;
+                }
+                key.buffers.insert(key.buffers.end(), bytes->begin(), bytes->end());
+                buffer_hash = hash_buffer_words(*bytes, buffer_hash);
+            }
+        }
+        key.hash = hash_mix(hash_mix(key.export_id, buffer_hash), key.arg_count);
+        for (size_t i = 0; i < key.arg_count; i++) {
+            key.hash = hash_mix(key.hash, key.args[i]);
+        }
+        return key;
+    }
+
+    // Cached result of the call, counted as a hit or a miss
+    std::optional<PluginValue> find(const ResultKey& key);
+
+    // Result of a call that returned normally
+    void insert(ResultKey key, PluginValue result);
+
+    ResultCacheStats stats() const;
+
+    const std::vector<PureExport>& pure_exports() const { return exports; }
+
+private:
+    struct KeyHash {
+        size_t operator()(const ResultKey& key) const { return static_cast<size_t>(key.hash); }
+    };
+
+    // Points at its key in `slots`, so the buffers of a key are only kept once
+    struct Entry {
+        const ResultKey* key = nullptr;
+        PluginValue result {};
+        bool referenced = false;
+    };
+
+    // A full shard replaces entries in CLOCK order, sparing those used since the hand last passed them
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<ResultKey, uint32_t, KeyHash> slots;
+        std::vector<Entry> entries;
+        size_t hand = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+    };
+
+    Shard& shard_of(const ResultKey& key) const { return shards[(key.hash >> 40) % shard_count]; }
+
+    std::vector<PureExport> exports;
+    size_t shard_count = 1;
+    size_t shard_capacity = 1;
+    size_t max_buffer_bytes = 0;
+    std::unique_ptr<Shard[]> shards;
+};
+
+// Declarations of `text` in the section's format. Malformed lines are reported and skipped
+std::vector<PureExport> parse_pure_exports(std::string_view text);
+
+// Cache for the exports `wasm` declares pure and those of `options`. Null if there are none or the capacity is 0
+std::unique_ptr<ResultCache> create_result_cache(std::span<const uint8_t> wasm, const ResultCacheOptions& options);
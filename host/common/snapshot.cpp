@@ -0,0 +1,67 @@
+#include "snapshot.hpp"
+
+#include <print>
+
+#include "mapped_file.hpp"
+#include "wasm_rewriter.hpp"
+
+std::optional<PluginSnapshot> preinitialize_plugin(PluginEngine& engine, const PluginHostOptions& options, const std::string_view init_export) {
+    const auto wasm_file = read_file_bytes(options.plugin_path);
+    if (!wasm_file) {
+        std::println("ERROR: Failed to read plugin file \"{}\"", options.plugin_path.string());
+        return std::nullopt;
+    }
+    const auto globals = read_snapshot_globals(*wasm_file);
+    if (!globals) {
+        return std::nullopt;
+    }
+    const auto instrumented = add_global_getters(*wasm_file, *globals);
+    if (!instrumented) {
+        return std::nullopt;
+    }
+
+    // The instrumented module is thrown away after this, keep it out of the module cache
+    PluginHostOptions init_options = options;
+    init_options.plugin_bytes = *instrumented;
+    init_options.cache_dir.clear();
+    init_options.call_timeout = {};
+    init_options.upgrade_tier = false;
+    const auto host = engine.load(init_options);
+    if (!host) {
+        return std::nullopt;
+    }
+    const auto init = host->find_function(init_export, signature_of<void>());
+    if (!init) {
+        std::println("Plugin has no {} export, loading it without a snapshot", init_export);
+        return std::nullopt;
+    }
+    const auto session = host->instantiate();
+    if (!session || !session->call(*init, {})) {
+        std::println("ERROR: Failed to run {} for the snapshot", init_export);
+        return std::nullopt;
+    }
+
+    std::vector<PluginValue> values(globals->size());
+    for (size_t i = 0; i < globals->size(); i++) {
+        const SnapshotGlobal& global = (*globals)[i];
+        const auto getter = host->find_function(snapshot_global_getter(global.index), FunctionSignature { {}, { global.kind } });
+        if (!getter || !session->call(*getter, { &values[i], 1 })) {
+            std::println("ERROR: Failed to read global {} for the snapshot", global.index);
+            return std::nullopt;
+        }
+    }
+
+    const auto memory_view = session->memory_view();
+    const auto memory = memory_view.span({ 0, static_cast<uint32_t>(memory_view.size()) });
+    if (!memory) {
+        return std::nullopt;
+    }
+    // The initialization exports already ran, instances of the baked module must not run them again
+    const std::string_view dropped_exports[] = { init_export, "_initialize" };
+    auto module = bake_snapshot(*wasm_file, *globals, values, *memory, dropped_exports);
+    if (!module) {
+        return std::nullopt;
+    }
+    std::println("Snapshotted plugin \"{}\" after {}, {} KiB of memory", options.plugin_path.string(), init_export, memory->size() / 1024);
+    return PluginSnapshot { std::move(*module), { memory->begin(), memory->end() } };
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "plugin_host.hpp"
+
+// A plugin captured right after its initialization export ran. Instances of `module` start out initialized,
+// and can be reset back to `memory` instead of being torn down and instantiated again
+struct PluginSnapshot {
+    // The plugin with the initialized linear memory and globals baked in
+    std::vector<uint8_t> module;
+    std::vector<uint8_t> memory;
+};
+
+// Instantiates the plugin at options.plugin_path once, runs `init_export` and snapshots the result.
+// Only guest state is captured, so initialization must not depend on host state such as open WASI files
+std::optional<PluginSnapshot> preinitialize_plugin(PluginEngine& engine, const PluginHostOptions& options, std::string_view init_export);
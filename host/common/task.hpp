@@ -0,0 +1,103 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+template<typename T>
+class Task;
+
+template<typename T>
+struct TaskPromise;
+
+template<typename T>
+struct TaskPromiseBase {
+    // Resumed when the task finishes, empty for tasks the event loop runs on their own
+    std::coroutine_handle<> continuation;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    auto final_suspend() noexcept {
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(const std::coroutine_handle<TaskPromise<T>> handle) noexcept {
+                const auto continuation = handle.promise().continuation;
+                return continuation ? continuation : std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+        return FinalAwaiter {};
+    }
+
+    // The host does not use exceptions, a throwing coroutine is a bug
+    void unhandled_exception() { std::terminate(); }
+};
+
+template<typename T>
+struct TaskPromise : TaskPromiseBase<T> {
+    std::optional<T> value;
+
+    Task<T> get_return_object();
+    void return_value(T result) { value = std::move(result); }
+};
+
+template<>
+struct TaskPromise<void> : TaskPromiseBase<void> {
+    Task<void> get_return_object();
+    void return_void() {}
+};
+
+// Lazily started coroutine. It runs when first awaited, or when handed to EventLoop::spawn
+template<typename T = void>
+class [[nodiscard]] Task {
+public:
+    using promise_type = TaskPromise<T>;
+
+    Task() = default;
+    explicit Task(const std::coroutine_handle<promise_type> handle) : handle(handle) {}
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle) {
+                handle.destroy();
+            }
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+    ~Task() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    bool done() const { return !handle || handle.done(); }
+    std::coroutine_handle<> coroutine() const { return handle; }
+
+    bool await_ready() const { return done(); }
+
+    std::coroutine_handle<> await_suspend(const std::coroutine_handle<> awaiting) {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    T await_resume() {
+        if constexpr (!std::is_void_v<T>) {
+            return std::move(*handle.promise().value);
+        }
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+};
+
+template<typename T>
+Task<T> TaskPromise<T>::get_return_object() {
+    return Task<T>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "plugin_host.hpp"
+
+// The compiled plugin a host instantiates from, swapped for a higher tier once a background compile publishes it.
+// Sessions hold on to the code they were created from, so a swap only affects sessions created after it
+template<typename Compiled>
+class TieredCode {
+public:
+    TieredCode() = default;
+    TieredCode(const TieredCode&) = delete;
+    TieredCode& operator=(const TieredCode&) = delete;
+
+    // Only taken once per instantiation, so a plain lock costs nothing measurable next to creating a store
+    std::shared_ptr<const Compiled> current() const {
+        std::lock_guard lock(mutex);
+        return code;
+    }
+
+    CompileTier tier() const {
+        std::lock_guard lock(mutex);
+        return history.empty() ? CompileTier::Optimized : history.back().tier;
+    }
+
+    void publish(std::shared_ptr<const Compiled> compiled, const TierStats& stats) {
+        std::shared_ptr<const Compiled> previous;
+        std::lock_guard lock(mutex);
+        history.push_back(stats);
+        // The previous tier is released outside the lock, the last reference may tear down a whole module
+        previous = std::exchange(code, std::move(compiled));
+    }
+
+    std::vector<TierStats> stats() const {
+        std::lock_guard lock(mutex);
+        return history;
+    }
+
+    // Runs `compile` on a background thread, which publishes its result itself. Can only be used once.
+    // Compiles cannot be cancelled, so destroying the code waits for it
+    template<typename Compile>
+    void compile_in_background(Compile&& compile) {
+        std::promise<void> done;
+        finished = done.get_future().share();
+        worker = std::jthread([compile = std::forward<Compile>(compile), done = std::move(done)]() mutable {
+            compile();
+            done.set_value();
+        });
+    }
+
+    void wait() const {
+        if (finished.valid()) {
+            finished.wait();
+        }
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::shared_ptr<const Compiled> code;
+    std::vector<TierStats> history;
+    std::shared_future<void> finished;
+    // Declared last so it is joined before anything the compile might still touch is destroyed
+    std::jthread worker;
+};
@@ -0,0 +1,718 @@
+#include "wasm_rewriter.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <format>
+#include <print>
+
+static_assert(std::endian::native == std::endian::little, "wasm encodes floats little endian");
+
+constexpr uint8_t custom_section = 0;
+constexpr uint8_t type_section = 1;
+constexpr uint8_t import_section = 2;
+constexpr uint8_t function_section = 3;
+constexpr uint8_t memory_section = 5;
+constexpr uint8_t global_section = 6;
+constexpr uint8_t export_section = 7;
+constexpr uint8_t start_section = 8;
+constexpr uint8_t code_section = 10;
+constexpr uint8_t data_section = 11;
+constexpr uint8_t data_count_section = 12;
+
+constexpr uint8_t extern_func = 0;
+constexpr uint8_t extern_table = 1;
+constexpr uint8_t extern_memory = 2;
+constexpr uint8_t extern_global = 3;
+constexpr uint8_t extern_tag = 4;
+
+constexpr uint8_t op_end = 0x0b;
+constexpr uint8_t op_global_get = 0x23;
+constexpr uint8_t op_global_set = 0x24;
+constexpr uint8_t op_i32_const = 0x41;
+constexpr uint8_t op_i64_const = 0x42;
+constexpr uint8_t op_f32_const = 0x43;
+constexpr uint8_t op_f64_const = 0x44;
+
+constexpr size_t snapshot_page_size = 4096;
+constexpr size_t wasm_page_size = 65536;
+
+// Sequential decoder. Reads past the end or malformed encodings set `failed` and return zeros
+class ByteReader {
+public:
+    explicit ByteReader(const std::span<const uint8_t> bytes) : bytes(bytes) {}
+
+    bool failed = false;
+
+    bool at_end() const { return position >= bytes.size(); }
+    size_t offset() const { return position; }
+    std::span<const uint8_t> rest() const { return bytes.subspan(std::min(position, bytes.size())); }
+    std::span<const uint8_t> since(const size_t start) const { return bytes.subspan(start, position - start); }
+
+    uint8_t byte() {
+        if (at_end()) {
+            failed = true;
+            return 0;
+        }
+        return bytes[position++];
+    }
+
+    std::span<const uint8_t> take(const size_t count) {
+        if (count > bytes.size() - std::min(position, bytes.size())) {
+            failed = true;
+            position = bytes.size();
+            return {};
+        }
+        const auto taken = bytes.subspan(position, count);
+        position += count;
+        return taken;
+    }
+
+    uint64_t uleb() {
+        uint64_t value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            const uint8_t next = byte();
+            value |= static_cast<uint64_t>(next & 0x7f) << shift;
+            if (!(next & 0x80)) {
+                return value;
+            }
+        }
+        failed = true;
+        return 0;
+    }
+
+    void skip_leb() {
+        while (!failed && (byte() & 0x80)) {
+        }
+    }
+
+    void skip_name() { take(uleb()); }
+
+    void skip_limits() {
+        const uint8_t flags = byte();
+        uleb();
+        if (flags & 0x01) {
+            uleb();
+        }
+    }
+
+    // Constant expressions, including the extended-const arithmetic and v128 constants
+    void skip_const_expr() {
+        while (!failed) {
+            switch (byte()) {
+                case op_end:
+                    return;
+                case op_i32_const:
+                case op_i64_const:
+                case 0xd0: // ref.null
+                    skip_leb();
+                    break;
+                case op_f32_const:
+                    take(4);
+                    break;
+                case op_f64_const:
+                    take(8);
+                    break;
+                case op_global_get:
+                case 0xd2: // ref.func
+                    uleb();
+                    break;
+                case 0x6a: case 0x6b: case 0x6c: // i32.add, i32.sub, i32.mul
+                case 0x7c: case 0x7d: case 0x7e: // i64.add, i64.sub, i64.mul
+                    break;
+                case 0xfd: // v128.const
+                    if (uleb() != 12) {
+                        failed = true;
+                    }
+                    take(16);
+                    break;
+                default:
+                    failed = true;
+                    break;
+            }
+        }
+    }
+
+private:
+    std::span<const uint8_t> bytes;
+    size_t position = 0;
+};
+
+static void write_uleb(std::vector<uint8_t>& out, uint64_t value) {
+    do {
+        uint8_t next = value & 0x7f;
+        value >>= 7;
+        out.push_back(value ? next | 0x80 : next);
+    } while (value);
+}
+
+static void write_sleb(std::vector<uint8_t>& out, int64_t value) {
+    while (true) {
+        const uint8_t next = value & 0x7f;
+        value >>= 7;
+        if ((value == 0 && !(next & 0x40)) || (value == -1 && (next & 0x40))) {
+            out.push_back(next);
+            return;
+        }
+        out.push_back(next | 0x80);
+    }
+}
+
+static void write_bytes(std::vector<uint8_t>& out, const std::span<const uint8_t> bytes) {
+    out.insert(out.end(), bytes.begin(), bytes.end());
+}
+
+static void write_name(std::vector<uint8_t>& out, const std::string_view name) {
+    write_uleb(out, name.size());
+    write_bytes(out, { reinterpret_cast<const uint8_t*>(name.data()), name.size() });
+}
+
+static uint8_t valtype_code(const ValKind kind) {
+    switch (kind) {
+        case ValKind::I32: return 0x7f;
+        case ValKind::I64: return 0x7e;
+        case ValKind::F32: return 0x7d;
+        case ValKind::F64: return 0x7c;
+    }
+    return 0x7f;
+}
+
+static std::optional<ValKind> valkind_of(const uint8_t code) {
+    switch (code) {
+        case 0x7f: return ValKind::I32;
+        case 0x7e: return ValKind::I64;
+        case 0x7d: return ValKind::F32;
+        case 0x7c: return ValKind::F64;
+        default: return std::nullopt;
+    }
+}
+
+static void write_const(std::vector<uint8_t>& out, const ValKind kind, const PluginValue& value) {
+    switch (kind) {
+        case ValKind::I32:
+            out.push_back(op_i32_const);
+            write_sleb(out, value.i32);
+            break;
+        case ValKind::I64:
+            out.push_back(op_i64_const);
+            write_sleb(out, value.i64);
+            break;
+        case ValKind::F32:
+            out.push_back(op_f32_const);
+            write_bytes(out, std::span(reinterpret_cast<const uint8_t*>(&value.f32), 4));
+            break;
+        case ValKind::F64:
+            out.push_back(op_f64_const);
+            write_bytes(out, std::span(reinterpret_cast<const uint8_t*>(&value.f64), 8));
+            break;
+    }
+}
+
+struct Section {
+    uint8_t id = 0;
+    std::span<const uint8_t> payload;
+};
+
+struct ParsedGlobal {
+    uint8_t valtype = 0;
+    bool is_mutable = false;
+    std::span<const uint8_t> init;
+};
+
+// What the rewrites need to know about a module, with every section kept for copying
+struct ParsedModule {
+    std::vector<Section> sections;
+    uint32_t imported_functions = 0;
+    uint32_t imported_globals = 0;
+    uint32_t imported_memories = 0;
+    uint32_t types = 0;
+    uint32_t defined_functions = 0;
+    std::vector<ParsedGlobal> globals;
+    uint32_t defined_memories = 0;
+    bool memory64 = false;
+    bool passive_data = false;
+
+    const Section* find(const uint8_t id) const {
+        const auto found = std::ranges::find(sections, id, &Section::id);
+        return found == sections.end() ? nullptr : &*found;
+    }
+};
+
+constexpr uint8_t wasm_header[] = { 0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00 };
+
+static std::optional<ParsedModule> parse_module(const std::span<const uint8_t> wasm) {
+    if (wasm.size() < sizeof(wasm_header) || std::memcmp(wasm.data(), wasm_header, sizeof(wasm_header)) != 0) {
+        std::println("ERROR: Not a wasm module");
+        return std::nullopt;
+    }
+    ParsedModule module;
+    ByteReader module_reader(wasm.subspan(sizeof(wasm_header)));
+    while (!module_reader.at_end() && !module_reader.failed) {
+        Section section;
+        section.id = module_reader.byte();
+        section.payload = module_reader.take(module_reader.uleb());
+        module.sections.push_back(section);
+
+        ByteReader reader(section.payload);
+        switch (section.id) {
+            case type_section:
+                module.types = static_cast<uint32_t>(reader.uleb());
+                break;
+            case import_section:
+                for (uint64_t count = reader.uleb(); count > 0 && !reader.failed; count--) {
+                    reader.skip_name();
+                    reader.skip_name();
+                    switch (reader.byte()) {
+                        case extern_func:
+                            reader.uleb();
+                            module.imported_functions++;
+                            break;
+                        case extern_table:
+                            reader.byte();
+                            reader.skip_limits();
+                            break;
+                        case extern_memory:
+                            reader.skip_limits();
+                            module.imported_memories++;
+                            break;
+                        case extern_global:
+                            reader.byte();
+                            reader.byte();
+                            module.imported_globals++;
+                            break;
+                        case extern_tag:
+                            reader.byte();
+                            reader.uleb();
+                            break;
+                        default:
+                            reader.failed = true;
+                            break;
+                    }
+                }
+                break;
+            case function_section:
+                module.defined_functions = static_cast<uint32_t>(reader.uleb());
+                break;
+            case memory_section:
+                module.defined_memories = static_cast<uint32_t>(reader.uleb());
+                for (uint32_t i = 0; i < module.defined_memories && !reader.failed; i++) {
+                    const uint8_t flags = reader.byte();
+                    module.memory64 |= (flags & 0x04) != 0;
+                    reader.uleb();
+                    if (flags & 0x01) {
+                        reader.uleb();
+                    }
+                }
+                break;
+            case global_section:
+                for (uint64_t count = reader.uleb(); count > 0 && !reader.failed; count--) {
+                    ParsedGlobal global;
+                    global.valtype = reader.byte();
+                    global.is_mutable = reader.byte() != 0;
+                    const size_t init_start = reader.offset();
+                    reader.skip_const_expr();
+                    global.init = reader.since(init_start);
+                    module.globals.push_back(global);
+                }
+                break;
+            case data_section:
+                for (uint64_t count = reader.uleb(); count > 0 && !reader.failed; count--) {
+                    const uint64_t flags = reader.uleb();
+                    if (flags == 1) {
+                        module.passive_data = true;
+                    }
+                    else {
+                        if (flags == 2) {
+                            reader.uleb();
+                        }
+                        reader.skip_const_expr();
+                    }
+                    reader.take(reader.uleb());
+                }
+                break;
+            default:
+                break;
+        }
+        if (reader.failed) {
+            std::println("ERROR: Malformed wasm section {}", section.id);
+            return std::nullopt;
+        }
+    }
+    if (module_reader.failed) {
+        std::println("ERROR: Truncated wasm module");
+        return std::nullopt;
+    }
+    return module;
+}
+
+// A section's entry vector with `count` more entries appended, keeping the existing ones byte for byte
+static std::vector<uint8_t> append_entries(const std::span<const uint8_t> payload, const uint64_t count, const std::span<const uint8_t> entries) {
+    ByteReader reader(payload);
+    const uint64_t existing = reader.uleb();
+    std::vector<uint8_t> out;
+    write_uleb(out, existing + count);
+    write_bytes(out, reader.rest());
+    write_bytes(out, entries);
+    return out;
+}
+
+// New functions appended to a module, each with its own type
+struct AddedFunctions {
+    std::vector<uint8_t> types;
+    std::vector<uint8_t> functions;
+    std::vector<uint8_t> bodies;
+    std::vector<uint8_t> exports;
+    uint32_t count = 0;
+    uint32_t export_count = 0;
+
+    void add(const ParsedModule& module, const std::string_view name, const std::span<const ValKind> results, const std::span<const uint8_t> code) {
+        types.push_back(0x60);
+        write_uleb(types, 0);
+        write_uleb(types, results.size());
+        for (const ValKind kind : results) {
+            types.push_back(valtype_code(kind));
+        }
+        write_uleb(functions, module.types + count);
+        std::vector<uint8_t> body { 0x00 }; // no locals
+        write_bytes(body, code);
+        body.push_back(op_end);
+        write_uleb(bodies, body.size());
+        write_bytes(bodies, body);
+        write_name(exports, name);
+        exports.push_back(extern_func);
+        write_uleb(exports, module.imported_functions + module.defined_functions + count);
+        count++;
+        export_count++;
+    }
+};
+
+// Writes `module` with sections replaced by `rewrite`, which returns the new payload or nothing to drop it
+template<typename Rewrite>
+static std::vector<uint8_t> write_module(const ParsedModule& module, Rewrite&& rewrite) {
+    std::vector<uint8_t> out(std::begin(wasm_header), std::end(wasm_header));
+    for (const Section& section : module.sections) {
+        const std::optional<std::vector<uint8_t>> payload = rewrite(section);
+        if (!payload) {
+            continue;
+        }
+        out.push_back(section.id);
+        write_uleb(out, payload->size());
+        write_bytes(out, *payload);
+    }
+    return out;
+}
+
+static std::vector<uint8_t> copy_payload(const Section& section) {
+    return { section.payload.begin(), section.payload.end() };
+}
+
+static bool has_function_sections(const ParsedModule& module) {
+    if (!module.find(type_section) || !module.find(function_section) || !module.find(code_section) || !module.find(export_section)) {
+        std::println("ERROR: Snapshots need modules with type, function, code and export sections");
+        return false;
+    }
+    return true;
+}
+
+static std::string read_name(ByteReader& reader) {
+    const auto bytes = reader.take(reader.uleb());
+    return { reinterpret_cast<const char*>(bytes.data()), bytes.size() };
+}
+
+// Reads one function type, empty if it uses value types beyond i32/i64/f32/f64. Those still take an index, only
+// importing a function of such a type fails
+static std::optional<FunctionSignature> read_function_type(ByteReader& reader) {
+    if (reader.byte() != 0x60) {
+        reader.failed = true;
+        return std::nullopt;
+    }
+    FunctionSignature signature;
+    bool supported = true;
+    for (auto* kinds : { &signature.params, &signature.results }) {
+        for (uint64_t count = reader.uleb(); count > 0 && !reader.failed; count--) {
+            const uint8_t code = reader.byte();
+            if (code == 0x63 || code == 0x64) {
+                // Typed references are followed by a heap type, which this reader does not decode
+                reader.failed = true;
+            }
+            const auto kind = valkind_of(code);
+            supported &= kind.has_value();
+            if (kind) {
+                kinds->push_back(*kind);
+            }
+        }
+    }
+    if (!supported) {
+        return std::nullopt;
+    }
+    return signature;
+}
+
+std::optional<std::span<const uint8_t>> read_custom_section(const std::span<const uint8_t> wasm, const std::string_view name) {
+    if (wasm.size() < sizeof(wasm_header) || std::memcmp(wasm.data(), wasm_header, sizeof(wasm_header)) != 0) {
+        return std::nullopt;
+    }
+    // Only section boundaries are decoded, the other sections may use features the rewrites do not support
+    ByteReader module_reader(wasm.subspan(sizeof(wasm_header)));
+    while (!module_reader.at_end() && !module_reader.failed) {
+        const uint8_t id = module_reader.byte();
+        const auto payload = module_reader.take(module_reader.uleb());
+        if (id != custom_section || module_reader.failed) {
+            continue;
+        }
+        ByteReader reader(payload);
+        const auto section_name = reader.take(reader.uleb());
+        if (!reader.failed && std::string_view(reinterpret_cast<const char*>(section_name.data()), section_name.size()) == name) {
+            return reader.rest();
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<std::vector<FunctionImport>> read_function_imports(const std::span<const uint8_t> wasm) {
+    const auto module = parse_module(wasm);
+    if (!module) {
+        return std::nullopt;
+    }
+    std::vector<std::optional<FunctionSignature>> types;
+    if (const Section* section = module->find(type_section)) {
+        ByteReader reader(section->payload);
+        for (uint64_t count = reader.uleb(); count > 0 && !reader.failed; count--) {
+            types.push_back(read_function_type(reader));
+        }
+        if (reader.failed) {
+            std::println("ERROR: Unsupported wasm type section");
+            return std::nullopt;
+        }
+    }
+
+    std::vector<FunctionImport> imports;
+    if (const Section* section = module->find(import_section)) {
+        ByteReader reader(section->payload);
+        for (uint64_t count = reader.uleb(); count > 0 && !reader.failed; count--) {
+            FunctionImport import;
+            import.module = read_name(reader);
+            import.name = read_name(reader);
+            if (reader.byte() != extern_func) {
+                std::println("ERROR: Plugin imports {}.{}, but hosts only provide functions", import.module, import.name);
+                return std::nullopt;
+            }
+            const uint64_t type = reader.uleb();
+            if (type >= types.size() || !types[type]) {
+                std::println("ERROR: Plugin import {}.{} has an unsupported type", import.module, import.name);
+                return std::nullopt;
+            }
+            import.signature = *types[type];
+            imports.push_back(std::move(import));
+        }
+        if (reader.failed) {
+            std::println("ERROR: Malformed wasm import section");
+            return std::nullopt;
+        }
+    }
+    return imports;
+}
+
+std::string snapshot_global_getter(const uint32_t index) {
+    return std::format("__snapshot_global_{}", index);
+}
+
+std::optional<std::vector<SnapshotGlobal>> read_snapshot_globals(const std::span<const uint8_t> wasm) {
+    const auto module = parse_module(wasm);
+    if (!module) {
+        return std::nullopt;
+    }
+    if (module->imported_memories > 0 || module->defined_memories != 1 || module->memory64) {
+        std::println("ERROR: Snapshots need a single 32-bit memory defined by the module");
+        return std::nullopt;
+    }
+    if (module->passive_data) {
+        std::println("ERROR: Snapshots do not support passive data segments");
+        return std::nullopt;
+    }
+    std::vector<SnapshotGlobal> globals;
+    for (size_t i = 0; i < module->globals.size(); i++) {
+        const auto& global = module->globals[i];
+        if (!global.is_mutable) {
+            continue;
+        }
+        const auto kind = valkind_of(global.valtype);
+        if (!kind) {
+            std::println("ERROR: Snapshots do not support mutable globals of type {:#x}", global.valtype);
+            return std::nullopt;
+        }
+        globals.push_back({ module->imported_globals + static_cast<uint32_t>(i), *kind });
+    }
+    return globals;
+}
+
+std::optional<std::vector<uint8_t>> add_global_getters(const std::span<const uint8_t> wasm, const std::span<const SnapshotGlobal> globals) {
+    const auto module = parse_module(wasm);
+    if (!module || !has_function_sections(*module)) {
+        return std::nullopt;
+    }
+    AddedFunctions added;
+    for (const SnapshotGlobal& global : globals) {
+        std::vector<uint8_t> code { op_global_get };
+        write_uleb(code, global.index);
+        added.add(*module, snapshot_global_getter(global.index), std::span(&global.kind, 1), code);
+    }
+    return write_module(*module, [&](const Section& section) -> std::optional<std::vector<uint8_t>> {
+        switch (section.id) {
+            case type_section: return append_entries(section.payload, added.count, added.types);
+            case function_section: return append_entries(section.payload, added.count, added.functions);
+            case code_section: return append_entries(section.payload, added.count, added.bodies);
+            case export_section: return append_entries(section.payload, added.export_count, added.exports);
+            default: return copy_payload(section);
+        }
+    });
+}
+
+// Active segments for the non-zero pages of `memory`. Zero pages are left out, fresh memory already is zero
+static std::vector<uint8_t> memory_segments(const std::span<const uint8_t> memory, uint32_t& segment_count) {
+    std::vector<uint8_t> segments;
+    segment_count = 0;
+    const auto page_is_zero = [&](const size_t page) {
+        const auto bytes = memory.subspan(page, std::min(snapshot_page_size, memory.size() - page));
+        return std::ranges::all_of(bytes, [](const uint8_t byte) { return byte == 0; });
+    };
+    size_t page = 0;
+    while (page < memory.size()) {
+        if (page_is_zero(page)) {
+            page += snapshot_page_size;
+            continue;
+        }
+        const size_t start = page;
+        while (page < memory.size() && !page_is_zero(page)) {
+            page += snapshot_page_size;
+        }
+        const auto bytes = memory.subspan(start, std::min(page, memory.size()) - start);
+        write_uleb(segments, 0); // active, memory 0
+        segments.push_back(op_i32_const);
+        write_sleb(segments, static_cast<int32_t>(start));
+        segments.push_back(op_end);
+        write_uleb(segments, bytes.size());
+        write_bytes(segments, bytes);
+        segment_count++;
+    }
+    return segments;
+}
+
+std::optional<std::vector<uint8_t>> bake_snapshot(const std::span<const uint8_t> wasm, const std::span<const SnapshotGlobal> globals, const std::span<const PluginValue> values,
+    const std::span<const uint8_t> memory, const std::span<const std::string_view> dropped_exports) {
+    const auto module = parse_module(wasm);
+    if (!module || !has_function_sections(*module) || globals.size() != values.size() || memory.size() % wasm_page_size != 0) {
+        return std::nullopt;
+    }
+
+    AddedFunctions added;
+    std::vector<uint8_t> restore_code;
+    for (size_t i = 0; i < globals.size(); i++) {
+        write_const(restore_code, globals[i].kind, values[i]);
+        restore_code.push_back(op_global_set);
+        write_uleb(restore_code, globals[i].index);
+    }
+    added.add(*module, restore_globals_export, {}, restore_code);
+
+    uint32_t segment_count = 0;
+    const auto segments = memory_segments(memory, segment_count);
+    bool has_data_section = false;
+    bool failed = false;
+
+    auto baked = write_module(*module, [&](const Section& section) -> std::optional<std::vector<uint8_t>> {
+        switch (section.id) {
+            case type_section: return append_entries(section.payload, added.count, added.types);
+            case function_section: return append_entries(section.payload, added.count, added.functions);
+            case code_section: return append_entries(section.payload, added.count, added.bodies);
+            case start_section: return std::nullopt;
+            case memory_section: {
+                // Grown during initialization, so the module now starts out at the snapshot's size
+                ByteReader reader(section.payload);
+                reader.uleb();
+                const uint8_t flags = reader.byte();
+                reader.uleb();
+                const uint64_t pages = memory.size() / wasm_page_size;
+                std::vector<uint8_t> out;
+                write_uleb(out, 1);
+                out.push_back(flags);
+                write_uleb(out, pages);
+                if (flags & 0x01) {
+                    const uint64_t max_pages = reader.uleb();
+                    failed |= max_pages < pages;
+                    write_uleb(out, max_pages);
+                }
+                write_bytes(out, reader.rest());
+                return out;
+            }
+            case global_section: {
+                std::vector<uint8_t> out;
+                write_uleb(out, module->globals.size());
+                for (size_t i = 0; i < module->globals.size(); i++) {
+                    const auto& global = module->globals[i];
+                    out.push_back(global.valtype);
+                    out.push_back(global.is_mutable ? 1 : 0);
+                    const auto index = module->imported_globals + static_cast<uint32_t>(i);
+                    const auto snapshot = std::ranges::find(globals, index, &SnapshotGlobal::index);
+                    if (snapshot == globals.end()) {
+                        write_bytes(out, global.init);
+                        continue;
+                    }
+                    write_const(out, snapshot->kind, values[snapshot - globals.begin()]);
+                    out.push_back(op_end);
+                }
+                return out;
+            }
+            case export_section: {
+                ByteReader reader(section.payload);
+                std::vector<uint8_t> kept;
+                uint64_t kept_count = 0;
+                for (uint64_t count = reader.uleb(); count > 0 && !reader.failed; count--) {
+                    const size_t start = reader.offset();
+                    const auto name = reader.take(reader.uleb());
+                    reader.byte();
+                    reader.uleb();
+                    const std::string_view export_name { reinterpret_cast<const char*>(name.data()), name.size() };
+                    if (std::ranges::find(dropped_exports, export_name) == dropped_exports.end()) {
+                        write_bytes(kept, reader.since(start));
+                        kept_count++;
+                    }
+                }
+                failed |= reader.failed;
+                std::vector<uint8_t> out;
+                write_uleb(out, kept_count + added.export_count);
+                write_bytes(out, kept);
+                write_bytes(out, added.exports);
+                return out;
+            }
+            case data_count_section: {
+                std::vector<uint8_t> out;
+                write_uleb(out, segment_count);
+                return out;
+            }
+            case data_section: {
+                has_data_section = true;
+                std::vector<uint8_t> out;
+                write_uleb(out, segment_count);
+                write_bytes(out, segments);
+                return out;
+            }
+            default:
+                return copy_payload(section);
+        }
+    });
+    if (failed) {
+        std::println("ERROR: Failed to bake snapshot into the module");
+        return std::nullopt;
+    }
+    if (!has_data_section && segment_count > 0) {
+        // Modules without initialized data still need the snapshot's. Data is the last ordered section, only custom
+        // sections may come after it
+        baked.push_back(data_section);
+        std::vector<uint8_t> payload;
+        write_uleb(payload, segment_count);
+        write_bytes(payload, segments);
+        write_uleb(baked, payload.size());
+        write_bytes(baked, payload);
+    }
+    return baked;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "plugin_values.hpp"
+
+// Binary-level inspection and rewrites of wasm modules, used to check plugins before compiling them and to snapshot
+// pre-initialized ones. Only the sections that matter are decoded, everything else is copied through untouched
+
+struct FunctionImport {
+    std::string module;
+    std::string name;
+    FunctionSignature signature;
+};
+
+// Function imports of `wasm`. Empty if it is malformed, imports anything but functions, which hosts never
+// provide, or imports functions with types other than i32/i64/f32/f64
+std::optional<std::vector<FunctionImport>> read_function_imports(std::span<const uint8_t> wasm);
+
+// Payload of the first custom section called `name`, without its name. Empty if `wasm` has none or is malformed
+std::optional<std::span<const uint8_t>> read_custom_section(std::span<const uint8_t> wasm, std::string_view name);
+
+// A mutable global defined by the module, the state a snapshot carries besides linear memory
+struct SnapshotGlobal {
+    // Index in the module's global index space, imported globals included
+    uint32_t index = 0;
+    ValKind kind = ValKind::I32;
+};
+
+// Exported by baked modules, sets every mutable global back to its snapshot value
+constexpr std::string_view restore_globals_export = "__snapshot_restore_globals";
+
+std::string snapshot_global_getter(uint32_t index);
+
+// The mutable globals of `wasm`. Empty if the module cannot be snapshotted: it imports its memory, uses 64-bit
+// memory or passive data segments, or has mutable globals of types other than i32/i64/f32/f64
+std::optional<std::vector<SnapshotGlobal>> read_snapshot_globals(std::span<const uint8_t> wasm);
+
+// Copy of `wasm` that exports a snapshot_global_getter() function for each of `globals`
+std::optional<std::vector<uint8_t>> add_global_getters(std::span<const uint8_t> wasm, std::span<const SnapshotGlobal> globals);
+
+// Copy of `wasm` that starts out with `memory` as its linear memory and `values` in `globals`. The start function
+// and the exports in `dropped_exports` are removed since their work is already part of the snapshot, and
+// restore_globals_export is added
+std::optional<std::vector<uint8_t>> bake_snapshot(std::span<const uint8_t> wasm, std::span<const SnapshotGlobal> globals, std::span<const PluginValue> values,
+    std::span<const uint8_t> memory, std::span<const std::string_view> dropped_exports);
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+#include <wasm.h>
+
+#include "plugin_values.hpp"
+
+// Maps a C++ scalar type to the wasm value kind it crosses the plugin boundary as
+template<typename T>
+struct WasmValKind;
+
+template<> struct WasmValKind<int32_t> { static constexpr wasm_valkind_t value = WASM_I32; };
+template<> struct WasmValKind<int64_t> { static constexpr wasm_valkind_t value = WASM_I64; };
+template<> struct WasmValKind<float> { static constexpr wasm_valkind_t value = WASM_F32; };
+template<> struct WasmValKind<double> { static constexpr wasm_valkind_t value = WASM_F64; };
+
+template<typename T>
+constexpr wasm_valkind_t wasm_valkind_v = WasmValKind<T>::value;
+
+inline std::optional<ValKind> to_val_kind(const wasm_valkind_t kind) {
+    switch (kind) {
+        case WASM_I32: return ValKind::I32;
+        case WASM_I64: return ValKind::I64;
+        case WASM_F32: return ValKind::F32;
+        case WASM_F64: return ValKind::F64;
+        default: return std::nullopt;
+    }
+}
+
+inline wasm_valkind_t to_wasm_valkind(const ValKind kind) {
+    switch (kind) {
+        case ValKind::I32: return WASM_I32;
+        case ValKind::I64: return WASM_I64;
+        case ValKind::F32: return WASM_F32;
+        case ValKind::F64: return WASM_F64;
+    }
+    return WASM_I32;
+}
+
+// Signature of a wasm function type, empty if it uses types the plugin interface cannot pass
+inline std::optional<FunctionSignature> signature_of_functype(const wasm_functype_t* type) {
+    FunctionSignature signature;
+    const auto convert = [](const wasm_valtype_vec_t* types, std::vector<ValKind>& kinds) {
+        for (size_t i = 0; i < types->size; i++) {
+            const auto kind = to_val_kind(wasm_valtype_kind(types->data[i]));
+            if (!kind) {
+                return false;
+            }
+            kinds.push_back(*kind);
+        }
+        return true;
+    };
+    if (!convert(wasm_functype_params(type), signature.params) || !convert(wasm_functype_results(type), signature.results)) {
+        return std::nullopt;
+    }
+    return signature;
+}
+
+// Builds the wasm function type of `R(Args...)`. The caller owns the result
+template<typename R, typename... Args>
+wasm_functype_t* make_functype() {
+    wasm_valtype_t* param_types[] = { wasm_valtype_new(wasm_valkind_v<Args>)..., nullptr };
+    wasm_valtype_vec_t params;
+    wasm_valtype_vec_new(&params, sizeof...(Args), param_types);
+    wasm_valtype_vec_t results;
+    if constexpr (std::is_void_v<R>) {
+        wasm_valtype_vec_new_empty(&results);
+    }
+    else {
+        wasm_valtype_t* result_types[] = { wasm_valtype_new(wasm_valkind_v<R>) };
+        wasm_valtype_vec_new(&results, 1, result_types);
+    }
+    return wasm_functype_new(&params, &results);
+}
+
+inline wasm_functype_t* make_functype(const FunctionSignature& signature) {
+    const auto make_types = [](const std::vector<ValKind>& kinds) {
+        std::vector<wasm_valtype_t*> types;
+        for (const ValKind kind : kinds) {
+            types.push_back(wasm_valtype_new(to_wasm_valkind(kind)));
+        }
+        wasm_valtype_vec_t vec;
+        wasm_valtype_vec_new(&vec, types.size(), types.data());
+        return vec;
+    };
+    wasm_valtype_vec_t params = make_types(signature.params);
+    wasm_valtype_vec_t results = make_types(signature.results);
+    return wasm_functype_new(&params, &results);
+}
@@ -0,0 +1,405 @@
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <print>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "engine_loader.hpp"
+#include "guest_arena.hpp"
+#include "guest_batch.hpp"
+#include "host_files.hpp"
+#include "guest_ring.hpp"
+#include "plugin_api.hpp"
+#include "plugin_metrics.hpp"
+#include "plugin_spec.hpp"
+#include "points_schema.hpp"
+
+BatchHostFn host_lookup_batch() {
+    return batch_host_fn<int32_t, int32_t>("host_lookup_batch", [](const std::span<const int32_t> keys, const std::span<int32_t> values) {
+        for (size_t i = 0; i < keys.size(); i++) {
+            values[i] = keys[i] * 2;
+        }
+    });
+}
+
+void bench_plugin(BenchReport& report, PluginEngine& engine, const std::filesystem::path& plugin_path) {
+    const std::string plugin = plugin_path.parent_path().filename().string();
+
+    PluginHostOptions options;
+    options.plugin_path = plugin_path;
+    options.host_imports.host_fn = [] { return int32_t { 42 }; };
+    // Optional imports of plugin_host_io.wasm, measured by host_call_batched and file_read_bulk
+    options.host_imports.files = std::make_shared<HostFiles>(options.wasi.data_dir);
+    options.host_imports.batch_fns.push_back(host_lookup_batch());
+    options.wasi.inherit_stdio = false;
+    // The scenarios measure the engine call path, call_sum_memoized turns the cache back on
+    options.result_cache.capacity = 0;
+
+    options.cache_dir.clear();
+    report.run(plugin, { .name = "compile", .samples = 10 }, [&] {
+        return engine.load(options) != nullptr;
+    });
+
+    options.cache_dir = "bench_cache";
+    auto host = engine.load(options);
+    if (!host) {
+        return;
+    }
+    report.run(plugin, { .name = "load_cached", .samples = 50 }, [&] {
+        return engine.load(options) != nullptr;
+    });
+
+    report.run(plugin, { .name = "instantiate", .samples = 1000 }, [&] {
+        return instantiate_plugin(*host) != nullptr;
+    });
+
+    if (const auto instance = instantiate_plugin(*host)) {
+        const auto& exports = instance->exports;
+        int32_t i = 0;
+        report.run(plugin, { .name = "call_sum", .samples = 1000, .batch = 1000 }, [&] {
+            i++;
+            return exports.sum(i, i).has_value();
+        });
+
+        if (exports.sum_batch) {
+            struct SumArgs {
+                int32_t a;
+                int32_t b;
+            };
+            const std::vector<SumArgs> batch_args(1000, { 1, 2 });
+            std::vector<int32_t> batch_results(batch_args.size());
+            GuestScratch scratch(exports);
+            report.run(plugin, { .name = "call_sum_batched", .samples = 1000, .ops_per_invocation = batch_args.size() }, [&] {
+                return call_batch(scratch, exports, exports.sum_batch, std::span(batch_args), std::span(batch_results));
+            });
+        }
+        else {
+            report.skip(plugin, "call_sum_batched", "plugin has no sum_batch export");
+        }
+
+        auto requests = exports.sum_ring ? GuestRing::create(exports, 16 * 1024) : std::nullopt;
+        auto responses = exports.sum_ring ? GuestRing::create(exports, 16 * 1024) : std::nullopt;
+        if (requests && responses) {
+            struct SumArgs {
+                int32_t a;
+                int32_t b;
+            };
+            constexpr int32_t records = 1000;
+            report.run(plugin, { .name = "call_sum_ring", .samples = 1000, .ops_per_invocation = records }, [&] {
+                const auto memory = exports.memory_view();
+                for (int32_t r = 0; r < records; r++) {
+                    if (!requests->push(memory, SumArgs { r, 1 })) {
+                        return false;
+                    }
+                }
+                const auto summed = exports.sum_ring(static_cast<int32_t>(requests->address()), static_cast<int32_t>(responses->address()));
+                // The call may have grown memory, which moves it on some engines
+                const auto drained = responses->drain(exports.memory_view(), [](const std::span<const uint8_t>) {});
+                return summed == records && drained == size_t { records };
+            });
+        }
+        else {
+            report.skip(plugin, "call_sum_ring", exports.sum_ring ? "failed to allocate rings" : "plugin has no sum_ring export");
+        }
+
+        if (exports.sum_host_fn) {
+            report.run(plugin, { .name = "host_call", .samples = 1000, .ops_per_invocation = 1000 }, [&] {
+                return exports.sum_host_fn(1000).has_value();
+            });
+        }
+        else {
+            report.skip(plugin, "host_call", "plugin has no sum_host_fn export");
+        }
+
+        // The same number of values fetched from the host 256 at a time
+        if (exports.sum_host_lookups) {
+            report.run(plugin, { .name = "host_call_batched", .samples = 1000, .ops_per_invocation = 1000 }, [&] {
+                return exports.sum_host_lookups(1000) == 999 * 1000;
+            });
+        }
+        else {
+            report.skip(plugin, "host_call_batched", "plugin has no sum_host_lookups export");
+        }
+
+        if (const auto arena = exports.get_arena_string ? GuestArena::create(exports, 4096) : std::nullopt) {
+            report.run(plugin, { .name = "string_round_trip", .samples = 1000, .batch = 10 }, [&] {
+                const auto address = exports.get_arena_string(static_cast<int32_t>(arena->address()));
+                const auto memory = exports.memory_view();
+                if (!address || *address == 0 || !memory.c_string(static_cast<uint32_t>(*address))) {
+                    return false;
+                }
+                return arena->reset(memory);
+            });
+            guest_free(exports, arena->allocation());
+        }
+        else {
+            report.skip(plugin, "string_round_trip", "plugin has no get_arena_string export");
+        }
+
+        // The same string malloc'ed by the plugin and freed through a second call, as older plugin builds do
+        if (exports.get_heap_allocated_string && exports.free_heap_allocated_string) {
+            report.run(plugin, { .name = "string_round_trip_malloc", .samples = 1000, .batch = 10 }, [&] {
+                const auto address = exports.get_heap_allocated_string();
+                if (!address || !exports.memory_view().c_string(static_cast<uint32_t>(*address))) {
+                    return false;
+                }
+                return exports.free_heap_allocated_string(*address);
+            });
+        }
+        else {
+            report.skip(plugin, "string_round_trip_malloc", "plugin has no get_heap_allocated_string export");
+        }
+
+        // Builds a structured request of 1000 points in guest memory and reads the plugin's summary in place
+        if (exports.sum_points) {
+            constexpr uint32_t point_count = 1000;
+            GuestScratch scratch(exports);
+            const auto region = scratch.reserve(PointsRequestBuilder::size + point_count * PointBuilder::size + 64);
+            const auto arena = GuestArena::create(exports, 4096);
+            if (region && arena) {
+                report.run(plugin, { .name = "call_sum_points", .samples = 1000, .ops_per_invocation = point_count }, [&] {
+                    FlatBuilder builder(exports.memory_view(), *region);
+                    const auto request = builder.create<PointsRequestBuilder>();
+                    request.set_label("bench");
+                    const auto points = request.init_points(point_count);
+                    for (uint32_t i = 0; i < point_count; i++) {
+                        points[i].set_x(static_cast<int32_t>(i));
+                        points[i].set_y(1);
+                    }
+                    if (!builder) {
+                        return false;
+                    }
+                    const auto address = exports.sum_points(static_cast<int32_t>(request.address()), static_cast<int32_t>(arena->address()));
+                    const auto memory = exports.memory_view();
+                    const auto results = arena->contents(memory);
+                    const auto summary = address && results ? read_flat<PointsSummaryView>(memory, *results, static_cast<uint32_t>(*address)) : std::nullopt;
+                    return summary && summary->count() == point_count && arena->reset(memory);
+                });
+                guest_free(exports, arena->allocation());
+            }
+            else {
+                report.skip(plugin, "call_sum_points", "failed to allocate the request and result buffers");
+            }
+        }
+        else {
+            report.skip(plugin, "call_sum_points", "plugin has no sum_points export");
+        }
+
+        if (exports.plugin_alloc) {
+            const std::vector<uint8_t> payload(64 * 1024, 0xab);
+            GuestScratch scratch(exports);
+            const auto region = scratch.reserve(static_cast<uint32_t>(payload.size()));
+            report.run(plugin, { .name = "memory_write_64k", .samples = 1000, .batch = 10 }, [&] {
+                const auto target = region ? exports.memory_view().span(*region) : std::nullopt;
+                if (!target) {
+                    return false;
+                }
+                std::memcpy(target->data(), payload.data(), payload.size());
+                return true;
+            });
+        }
+        else {
+            report.skip(plugin, "memory_write_64k", "plugin has no plugin_alloc export");
+        }
+
+        // The same 1 MiB file read in 64 KiB chunks, through WASI and through the host's file imports
+        constexpr char filename[] = "bench_file_bytes.bin";
+        const std::vector<uint8_t> contents(1024 * 1024, 1);
+        const bool written = std::ofstream(options.wasi.data_dir / filename, std::ios::binary | std::ios::trunc)
+                                 .write(reinterpret_cast<const char*>(contents.data()), static_cast<std::streamsize>(contents.size()))
+                                 .good();
+        const auto name = exports.sum_file_bytes && written ? guest_write(exports, { reinterpret_cast<const uint8_t*>(filename), sizeof(filename) }) : std::nullopt;
+        if (name) {
+            for (const auto& [scenario, use_file_imports] : { std::pair { "file_read_wasi", 0 }, std::pair { "file_read_bulk", 1 } }) {
+                report.run(plugin, { .name = scenario, .samples = 100 }, [&] {
+                    return exports.sum_file_bytes(static_cast<int32_t>(name->offset), use_file_imports) == static_cast<int64_t>(contents.size());
+                });
+            }
+            guest_free(exports, *name);
+        }
+        else {
+            const auto reason = exports.sum_file_bytes ? "failed to write the file" : "plugin has no sum_file_bytes export";
+            report.skip(plugin, "file_read_wasi", reason);
+            report.skip(plugin, "file_read_bulk", reason);
+        }
+    }
+
+    // Same calls with every export and import call recorded, the difference is the cost of the instrumentation
+    if constexpr (metrics_enabled) {
+        PluginHostOptions recorded_options = options;
+        recorded_options.metrics = std::make_shared<PluginMetrics>(plugin);
+        const auto recorded_host = engine.load(recorded_options);
+        if (const auto instance = recorded_host ? instantiate_plugin(*recorded_host) : nullptr) {
+            const auto& exports = instance->exports;
+            int32_t i = 0;
+            report.run(plugin, { .name = "call_sum_recorded", .samples = 1000, .batch = 1000 }, [&] {
+                i++;
+                return exports.sum(i, i).has_value();
+            });
+            if (exports.sum_host_fn) {
+                report.run(plugin, { .name = "host_call_recorded", .samples = 1000, .ops_per_invocation = 1000 }, [&] {
+                    return exports.sum_host_fn(1000).has_value();
+                });
+            }
+        }
+    }
+    else {
+        report.skip(plugin, "call_sum_recorded", "metrics are compiled out");
+    }
+
+    // Calls cycling through a few arguments, all but the first round are answered from the result cache
+    PluginHostOptions memoized_options = options;
+    memoized_options.result_cache = { .pure_exports = { "sum" } };
+    const auto memoized_host = engine.load(memoized_options);
+    if (const auto instance = memoized_host ? instantiate_plugin(*memoized_host) : nullptr) {
+        const auto& exports = instance->exports;
+        int32_t i = 0;
+        report.run(plugin, { .name = "call_sum_memoized", .samples = 1000, .batch = 1000 }, [&] {
+            i = (i + 1) % 64;
+            return exports.sum(i, i).has_value();
+        });
+    }
+
+    auto snapshot = preinitialize_plugin(engine, options, "plugin_init");
+    if (!snapshot) {
+        report.skip(plugin, "instantiate_snapshot", "plugin cannot be pre-initialized");
+        report.skip(plugin, "reset_snapshot", "plugin cannot be pre-initialized");
+        return;
+    }
+    const auto shared_snapshot = std::make_shared<const PluginSnapshot>(std::move(*snapshot));
+    PluginHostOptions snapshot_options = options;
+    snapshot_options.plugin_bytes = shared_snapshot->module;
+    const auto snapshot_host = engine.load(snapshot_options);
+    if (!snapshot_host) {
+        return;
+    }
+    report.run(plugin, { .name = "instantiate_snapshot", .samples = 1000 }, [&] {
+        return instantiate_plugin(*snapshot_host, shared_snapshot) != nullptr;
+    });
+    if (const auto instance = instantiate_plugin(*snapshot_host, shared_snapshot)) {
+        // Dirties a few heap pages like a typical request would before putting the instance back
+        report.run(plugin, { .name = "reset_snapshot", .samples = 1000 }, [&] {
+            const auto& exports = instance->exports;
+            if (!exports.get_arena_string) {
+                if (!exports.get_heap_allocated_string || !exports.free_heap_allocated_string) {
+                    return false;
+                }
+                const auto address = exports.get_heap_allocated_string();
+                return address && exports.free_heap_allocated_string(*address) && instance->reset();
+            }
+            const auto arena = GuestArena::create(exports, 4096);
+            if (!arena) {
+                return false;
+            }
+            const auto address = exports.get_arena_string(static_cast<int32_t>(arena->address()));
+            guest_free(exports, arena->allocation());
+            return address && instance->reset();
+        });
+    }
+}
+
+constexpr size_t tier_compile_samples = 5;
+
+// Compile time of each tier and the call latency of the code it produces, on an engine created with tiering
+void bench_tiers(BenchReport& report, PluginEngine& engine, const std::filesystem::path& plugin_path) {
+    const std::string plugin = plugin_path.parent_path().filename().string();
+
+    PluginHostOptions options;
+    options.plugin_path = plugin_path;
+    options.host_imports.host_fn = [] { return int32_t { 42 }; };
+    options.wasi.inherit_stdio = false;
+    options.cache_dir.clear();
+    options.result_cache.capacity = 0;
+
+    std::vector<double> baseline_ns;
+    std::vector<double> optimized_ns;
+    std::unique_ptr<PluginHost> host;
+    std::unique_ptr<PluginInstance> baseline_instance;
+    for (size_t i = 0; i < tier_compile_samples; i++) {
+        baseline_instance.reset();
+        host = engine.load(options);
+        if (!host) {
+            return;
+        }
+        // Instantiated before the upgrade lands, so it keeps running baseline code
+        baseline_instance = instantiate_plugin(*host);
+        host->wait_for_final_tier();
+        for (const auto& stats : host->tier_stats()) {
+            (stats.tier == CompileTier::Baseline ? baseline_ns : optimized_ns).push_back(std::chrono::duration<double, std::nano>(stats.compile_time).count());
+        }
+    }
+    report.record(plugin, "compile_baseline", std::move(baseline_ns));
+    report.record(plugin, "compile_optimized", std::move(optimized_ns));
+
+    const auto optimized_instance = instantiate_plugin(*host);
+    for (const PluginInstance* instance : { baseline_instance.get(), optimized_instance.get() }) {
+        if (!instance) {
+            continue;
+        }
+        const auto scenario = std::format("call_sum_{}", compile_tier_name(instance->session->compile_tier()));
+        int32_t i = 0;
+        report.run(plugin, { .name = scenario, .samples = 1000, .batch = 1000 }, [&] {
+            i++;
+            return instance->exports.sum(i, i).has_value();
+        });
+        if (instance->exports.sum_host_fn) {
+            report.run(plugin, { .name = std::format("host_call_{}", compile_tier_name(instance->session->compile_tier())), .samples = 1000, .ops_per_invocation = 1000 }, [&] {
+                return instance->exports.sum_host_fn(1000).has_value();
+            });
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    std::vector<PluginSpec> plugins;
+    for (int i = 2; i < argc; i++) {
+        if (auto spec = parse_plugin_spec(argv[i])) {
+            plugins.push_back(std::move(*spec));
+        }
+        else {
+            plugins.clear();
+            break;
+        }
+    }
+    if (plugins.empty()) {
+        std::println("Usage: {} <output.jsonl> <engine>:<plugin.wasm>...", argv[0]);
+        return 1;
+    }
+
+    BenchReport report(argv[1]);
+    if (!report.is_open()) {
+        std::println("ERROR: Failed to open \"{}\" for writing. Exiting...", argv[1]);
+        return 1;
+    }
+
+    EngineSettings settings;
+    settings.max_instances = 64;
+    EngineSettings tiered_settings = settings;
+    tiered_settings.tiered = true;
+    std::map<std::string, std::unique_ptr<PluginEngine>, std::less<>> engines;
+    std::map<std::string, std::unique_ptr<PluginEngine>, std::less<>> tiered_engines;
+    for (const auto& spec : plugins) {
+        auto& engine = engines[spec.engine];
+        if (!engine) {
+            engine = load_plugin_engine(spec.engine, settings);
+        }
+        if (engine) {
+            report.set_engine(engine->name(), engine->version());
+            bench_plugin(report, *engine, spec.plugin_path);
+        }
+        auto& tiered_engine = tiered_engines[spec.engine];
+        if (!tiered_engine) {
+            tiered_engine = load_plugin_engine(spec.engine, tiered_settings);
+        }
+        if (tiered_engine) {
+            bench_tiers(report, *tiered_engine, spec.plugin_path);
+        }
+    }
+    return 0;
+}
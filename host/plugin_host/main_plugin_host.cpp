@@ -0,0 +1,445 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <map>
+#include <memory>
+#include <print>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "engine_loader.hpp"
+#include "event_loop.hpp"
+#include "guest_arena.hpp"
+#include "guest_batch.hpp"
+#include "host_files.hpp"
+#include "instance_pool.hpp"
+#include "output_capture.hpp"
+#include "plugin_api.hpp"
+#include "plugin_executor.hpp"
+#include "plugin_metrics.hpp"
+#include "plugin_registry.hpp"
+#include "plugin_reloader.hpp"
+#include "plugin_spec.hpp"
+#include "points_schema.hpp"
+
+constexpr size_t pool_capacity = 4;
+constexpr size_t async_instance_count = 256;
+
+// Name a plugin's metrics are recorded under, the same plugin on two engines is recorded separately
+std::string metrics_name(const PluginEngine& engine, const std::filesystem::path& plugin_path) {
+    return std::format("{}/{}", engine.name(), plugin_path.parent_path().filename().string());
+}
+
+// The host_lookup_batch import of plugin_host_io.wasm, standing in for host data that plugins look up per record
+BatchHostFn host_lookup_batch() {
+    return batch_host_fn<int32_t, int32_t>("host_lookup_batch", [](const std::span<const int32_t> keys, const std::span<int32_t> values) {
+        for (size_t i = 0; i < keys.size(); i++) {
+            values[i] = keys[i] * 2;
+        }
+    });
+}
+
+bool run_plugin(PluginEngine& engine, const std::filesystem::path& plugin_path, const size_t worker_count, MetricsRegistry* metrics, const std::filesystem::path& profile_dir, const bool capture_output) {
+    std::println("Loading plugin \"{}\" on {} {}...", plugin_path.string(), engine.name(), engine.version());
+    PluginHostOptions options;
+    options.plugin_path = plugin_path;
+    // Generous for the demo calls, it only stops a plugin stuck in a loop from hanging the host
+    options.call_timeout = std::chrono::milliseconds(500);
+    options.host_imports.host_fn = [] {
+        std::println("Running \"host_fn\" on host...");
+        return int32_t { 42 };
+    };
+    // Optional imports, only plugin_host_io.wasm needs them. The files are sandboxed to the directory WASI maps as "."
+    options.host_imports.files = std::make_shared<HostFiles>(options.wasi.data_dir);
+    options.host_imports.batch_fns.push_back(host_lookup_batch());
+    // Declared by the plugins' "plugin.pure" section too, listed here for builds that predate it
+    options.result_cache.pure_exports = { "sum" };
+    if (capture_output) {
+        // Printed by the host in batches, each line tagged with the instance that wrote it
+        options.wasi.capture = std::make_shared<OutputCapture>(print_output_sink(plugin_path.parent_path().filename().string()));
+    }
+    // Plugins with an initialization export start every instance from a snapshot taken after it ran
+    std::shared_ptr<const PluginSnapshot> snapshot;
+    if (auto taken = preinitialize_plugin(engine, options, "plugin_init")) {
+        snapshot = std::make_shared<const PluginSnapshot>(std::move(*taken));
+        options.plugin_bytes = snapshot->module;
+    }
+    if (metrics) {
+        options.metrics = metrics->plugin(metrics_name(engine, plugin_path));
+    }
+    if (!profile_dir.empty()) {
+        options.guest_profile = profile_dir / std::format("{}-{}.json", engine.name(), plugin_path.parent_path().filename().string());
+    }
+    auto host = engine.load(options);
+    if (!host) {
+        std::println("ERROR: Failed to load plugin");
+        return false;
+    }
+    std::println(R"(Mapping WASI path "." to physical path "{}")", options.wasi.data_dir.string());
+
+    {
+        std::println("Filling instance pool...");
+        InstancePool<PluginInstance> pool([&] { return instantiate_plugin(*host, snapshot); }, pool_capacity);
+        auto plugin = pool.acquire();
+        if (!plugin) {
+            std::println("ERROR: Failed to instantiate plugin");
+            return false;
+        }
+        const auto& exports = plugin->exports;
+
+        const auto sum_result = exports.sum(7, 3);
+        std::println("Sum result 7 + 3 = {}", *sum_result);
+        // Answered by the host's result cache, the plugin is not called again
+        for (int32_t i = 0; i < 10; i++) {
+            exports.sum(7, 3);
+        }
+
+        exports.test_print();
+
+        if (const auto arena = exports.get_arena_string ? GuestArena::create(exports, 4096) : std::nullopt) {
+            const auto address = exports.get_arena_string(static_cast<int32_t>(arena->address()));
+            const auto memory = exports.memory_view();
+            if (const auto arena_str = address && *address != 0 ? memory.c_string(static_cast<uint32_t>(*address)) : std::nullopt) {
+                std::println("Arena str: {} ({} bytes of the arena used)", *memory.string(*arena_str), arena->used(memory).value_or(0));
+            }
+            else {
+                std::println("ERROR: Plugin returned an out of bounds string");
+            }
+            guest_free(exports, arena->allocation());
+        }
+        else if (exports.get_heap_allocated_string && exports.free_heap_allocated_string) {
+            int32_t address = *exports.get_heap_allocated_string();
+            const auto memory = exports.memory_view();
+            if (const auto heap_str = memory.c_string(static_cast<uint32_t>(address))) {
+                std::println("Heap str: {}", *memory.string(*heap_str));
+            }
+            else {
+                std::println("ERROR: Plugin returned an out of bounds string");
+            }
+            exports.free_heap_allocated_string(address);
+        }
+
+        constexpr std::string_view input = "Written by the host";
+        if (const auto buffer = guest_write(exports, { reinterpret_cast<const uint8_t*>(input.data()), input.size() })) {
+            std::println("Guest buffer at {}: {}", buffer->offset, *exports.memory_view().string(GuestString { *buffer }));
+            guest_free(exports, *buffer);
+        }
+
+        if (exports.sum_batch) {
+            struct SumArgs {
+                int32_t a;
+                int32_t b;
+            };
+            std::vector<SumArgs> batch_args;
+            for (int32_t i = 0; i < 1000; i++) {
+                batch_args.push_back({ i, i });
+            }
+            std::vector<int32_t> batch_results(batch_args.size());
+            GuestScratch scratch(exports);
+            if (call_batch(scratch, exports, exports.sum_batch, std::span<const SumArgs>(batch_args), std::span(batch_results))) {
+                int64_t total = 0;
+                for (const int32_t result : batch_results) {
+                    total += result;
+                }
+                std::println("Total of 1000 batched sum calls = {}", total);
+            }
+        }
+
+        if (exports.sum_points) {
+            GuestScratch scratch(exports);
+            const auto region = scratch.reserve(1024);
+            const auto arena = GuestArena::create(exports, 1024);
+            if (region && arena) {
+                // Written straight into guest memory, where the plugin reads it without decoding it
+                FlatBuilder builder(exports.memory_view(), *region);
+                const auto request = builder.create<PointsRequestBuilder>();
+                request.set_label("square");
+                const auto points = request.init_points(4);
+                for (uint32_t i = 0; i < points.size(); i++) {
+                    points[i].set_x(i & 1 ? 10 : 0);
+                    points[i].set_y(i & 2 ? 10 : 0);
+                }
+                const auto address = builder ? exports.sum_points(static_cast<int32_t>(request.address()), static_cast<int32_t>(arena->address())) : std::nullopt;
+                const auto memory = exports.memory_view();
+                const auto results = arena->contents(memory);
+                if (const auto summary = address && results ? read_flat<PointsSummaryView>(memory, *results, static_cast<uint32_t>(*address)) : std::nullopt) {
+                    std::println("Sum of {} points of {} = ({}, {})", summary->count(), summary->label().value_or("?"), summary->sum().x(), summary->sum().y());
+                }
+                else {
+                    std::println("ERROR: Plugin returned an invalid points summary");
+                }
+                guest_free(exports, arena->allocation());
+            }
+        }
+
+        exports.test_file_io();
+        if (exports.test_bulk_file_io) {
+            exports.test_bulk_file_io();
+        }
+        exports.test_host_fn();
+        if (exports.sum_host_lookups) {
+            std::println("Sum of 1000 host lookups made 256 at a time = {}", exports.sum_host_lookups(1000).value_or(-1));
+        }
+    }
+
+    {
+        std::println("Running sum on {} worker threads...", worker_count);
+        PluginExecutor<PluginInstance> executor([&] { return instantiate_plugin(*host, snapshot); }, worker_count);
+        std::vector<std::future<std::optional<int32_t>>> results;
+        for (int32_t i = 0; i < 1000; i++) {
+            results.push_back(executor.submit([i](const PluginInstance& plugin) { return plugin.exports.sum(i, i); }));
+        }
+        int64_t total = 0;
+        for (auto& result : results) {
+            total += result.get().value_or(0);
+        }
+        std::println("Total of 1000 parallel sum calls = {}", total);
+    }
+
+    for (const auto& stats : host->tier_stats()) {
+        std::println("{} code {} in {:.1f}ms", compile_tier_name(stats.tier), stats.from_cache ? "loaded from cache" : "compiled",
+            std::chrono::duration<double, std::milli>(stats.compile_time).count());
+    }
+    if (const ResultCache* cache = host->result_cache()) {
+        const auto stats = cache->stats();
+        std::println("Result cache: {} hits, {} misses ({:.1f}% hit rate), {} results kept, {} evicted", stats.hits, stats.misses, stats.hit_rate() * 100,
+            stats.entries, stats.evictions);
+    }
+    return true;
+}
+
+// Every plugin call waits on host I/O, yet a single thread keeps all of them in flight at once
+bool run_plugin_async(PluginEngine& engine, const std::filesystem::path& plugin_path, MetricsRegistry* metrics) {
+    std::println("Loading plugin \"{}\" on {} {} in async mode...", plugin_path.string(), engine.name(), engine.version());
+    EventLoop loop;
+    PluginHostOptions options;
+    options.plugin_path = plugin_path;
+    options.wasi.inherit_stdio = false;
+    options.host_imports.host_fn_async = async_host_fn<int32_t()>(loop, [&loop]() -> Task<int32_t> {
+        // Stands in for a network or disk request
+        co_await loop.sleep_for(std::chrono::milliseconds(10));
+        co_return 42;
+    });
+    if (metrics) {
+        options.metrics = metrics->plugin(metrics_name(engine, plugin_path));
+    }
+    auto host = engine.load(options);
+    if (!host) {
+        std::println("ERROR: Failed to load plugin");
+        return false;
+    }
+
+    std::vector<std::unique_ptr<PluginInstance>> instances;
+    for (size_t i = 0; i < async_instance_count; i++) {
+        auto instance = instantiate_plugin(*host);
+        if (!instance || (!instance->exports.sum_host_fn && !instance->exports.test_host_fn)) {
+            std::println("ERROR: Failed to instantiate plugin with a sum_host_fn or test_host_fn export");
+            return false;
+        }
+        instances.push_back(std::move(instance));
+    }
+
+    // Plugins without sum_host_fn make their one host request through test_host_fn
+    const int32_t requests = instances.front()->exports.sum_host_fn ? 4 : 1;
+    int64_t total = 0;
+    size_t finished = 0;
+    for (const auto& instance : instances) {
+        loop.spawn([](const PluginExports& exports, EventLoop& loop, const int32_t requests, int64_t& total, size_t& finished) -> Task<void> {
+            if (exports.sum_host_fn) {
+                const auto result = co_await exports.sum_host_fn.async(loop, requests);
+                total += result.value_or(0);
+                finished += result.has_value();
+            }
+            else {
+                finished += co_await exports.test_host_fn.async(loop);
+            }
+        }(instance->exports, loop, requests, total, finished));
+    }
+    const auto start = std::chrono::steady_clock::now();
+    loop.run();
+    const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::println("{} of {} concurrent calls making {} host requests each finished in {:.1f}ms on one thread, returning {}", finished, instances.size(), requests,
+        elapsed, total);
+    return finished == instances.size();
+}
+
+// Loads every plugin below a directory, only the plugin that is called gets instantiated
+bool run_plugin_directory(PluginEngine& engine, const std::filesystem::path& directory, const size_t thread_count) {
+    std::println("Loading plugins below \"{}\" on {} {}...", directory.string(), engine.name(), engine.version());
+    PluginHostOptions options;
+    options.host_imports.host_fn = [] { return int32_t { 42 }; };
+    PluginRegistry registry(engine, options);
+    const auto start = std::chrono::steady_clock::now();
+    const size_t loaded = registry.load_directory(directory, thread_count);
+    const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::println("Loaded {} plugins in {:.1f}ms on {} threads", loaded, elapsed, thread_count);
+    if (loaded == 0) {
+        return false;
+    }
+
+    const auto names = registry.names();
+    const auto* plugin = registry.get(names.front());
+    if (!plugin) {
+        std::println("ERROR: Failed to instantiate plugin {}", names.front());
+        return false;
+    }
+    std::println("{}: sum(7, 3) = {}", names.front(), plugin->exports.sum(7, 3).value_or(0));
+    std::println("{} of {} plugins instantiated", registry.instantiated_count(), registry.size());
+    return true;
+}
+
+// Keeps calling the plugin from every worker while it is reloaded whenever its file changes, until the host is stopped
+bool run_plugin_watch(PluginEngine& engine, const std::filesystem::path& plugin_path, const size_t worker_count) {
+    std::println("Watching plugin \"{}\" on {} {}...", plugin_path.string(), engine.name(), engine.version());
+    PluginHostOptions options;
+    options.plugin_path = plugin_path;
+    options.call_timeout = std::chrono::milliseconds(500);
+    options.host_imports.host_fn = [] { return int32_t { 42 }; };
+    ReloadablePlugin plugin(engine, options, pool_capacity);
+    if (!plugin.reload()) {
+        return false;
+    }
+    plugin.watch(std::chrono::milliseconds(250));
+
+    std::atomic<uint64_t> calls = 0;
+    std::vector<std::jthread> workers;
+    for (size_t i = 0; i < worker_count; i++) {
+        workers.emplace_back([&plugin, &calls](const std::stop_token& stop) {
+            while (!stop.stop_requested()) {
+                auto instance = plugin.acquire();
+                if (!instance) {
+                    continue;
+                }
+                if (!instance->exports.sum(7, 3)) {
+                    instance.discard();
+                }
+                calls.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        std::println("Version {}: {} calls/s", plugin.generation(), calls.exchange(0, std::memory_order_relaxed));
+    }
+}
+
+int main(int argc, char** argv) {
+    std::vector<PluginSpec> plugins;
+    bool async = false;
+    bool tiered = false;
+    bool plugin_dirs = false;
+    bool watch = false;
+    bool capture_output = false;
+    std::filesystem::path metrics_path;
+    std::filesystem::path profile_dir;
+    JitProfiler jit_profiler = JitProfiler::None;
+    for (int i = 1; i < argc; i++) {
+        if (std::string_view(argv[i]).starts_with("--guest-profile=")) {
+            profile_dir = std::string_view(argv[i]).substr(std::string_view("--guest-profile=").size());
+            std::filesystem::create_directories(profile_dir);
+            continue;
+        }
+        if (std::string_view(argv[i]) == "--perf-map") {
+            jit_profiler = JitProfiler::PerfMap;
+            continue;
+        }
+        if (std::string_view(argv[i]) == "--jitdump") {
+            jit_profiler = JitProfiler::JitDump;
+            continue;
+        }
+        if (std::string_view(argv[i]).starts_with("--metrics=")) {
+            metrics_path = std::string_view(argv[i]).substr(std::string_view("--metrics=").size());
+            continue;
+        }
+        if (std::string_view(argv[i]) == "--watch") {
+            watch = true;
+            continue;
+        }
+        if (std::string_view(argv[i]) == "--plugin-dir") {
+            plugin_dirs = true;
+            continue;
+        }
+        if (std::string_view(argv[i]) == "--async") {
+            async = true;
+            continue;
+        }
+        if (std::string_view(argv[i]) == "--capture-output") {
+            capture_output = true;
+            continue;
+        }
+        if (std::string_view(argv[i]) == "--tiered") {
+            tiered = true;
+            continue;
+        }
+        auto spec = parse_plugin_spec(argv[i]);
+        if (!spec) {
+            std::println("Usage: {} [--async] [--tiered] [--capture-output] [--plugin-dir] [--watch] [--metrics=<file.prom or file.json>] [--perf-map | --jitdump] [--guest-profile=<directory>] [<engine>:<plugin.wasm or directory>]...", argv[0]);
+            return 1;
+        }
+        plugins.push_back(std::move(*spec));
+    }
+    if (plugins.empty()) {
+        plugins.push_back({ "wasmtime", "../../../plugins/zig/plugin.wasm" });
+    }
+
+    const size_t worker_count = std::max(1u, std::thread::hardware_concurrency());
+    EngineSettings settings;
+    // Every live instance takes a slot: the pool, one spare for refills and the executor workers
+    settings.max_instances = static_cast<uint32_t>(pool_capacity + 1 + worker_count);
+    settings.interruptible = true;
+    settings.tiered = tiered;
+    settings.jit_profiler = jit_profiler;
+    if (async) {
+        settings.max_instances = static_cast<uint32_t>(async_instance_count);
+        settings.async_calls = true;
+    }
+    if (plugin_dirs || watch) {
+        // Allocated on demand, so plugins that are never called reserve no instance memory either, and old versions
+        // draining next to a reloaded one do not run out of slots
+        settings.max_instances = 0;
+    }
+
+    // Plugins that pick the same engine share it, each engine lives until every plugin on it is done
+    std::map<std::string, std::unique_ptr<PluginEngine>, std::less<>> engines;
+    MetricsRegistry metrics;
+    int exit_code = 0;
+    for (const auto& spec : plugins) {
+        auto& engine = engines[spec.engine];
+        if (!engine) {
+            std::println("Creating {} engine...", spec.engine);
+            engine = load_plugin_engine(spec.engine, settings);
+        }
+        if (!engine) {
+            exit_code = 1;
+            continue;
+        }
+        bool succeeded = false;
+        if (watch) {
+            succeeded = run_plugin_watch(*engine, spec.plugin_path, worker_count);
+        }
+        else if (plugin_dirs) {
+            succeeded = run_plugin_directory(*engine, spec.plugin_path, worker_count);
+        }
+        else if (async) {
+            succeeded = run_plugin_async(*engine, spec.plugin_path, metrics_path.empty() ? nullptr : &metrics);
+        }
+        else {
+            succeeded = run_plugin(*engine, spec.plugin_path, worker_count, metrics_path.empty() ? nullptr : &metrics, profile_dir, capture_output);
+        }
+        if (!succeeded) {
+            exit_code = 1;
+        }
+    }
+    if (!metrics_path.empty()) {
+        if constexpr (!metrics_enabled) {
+            std::println("WARNING: Metrics are compiled out, \"{}\" only lists the plugins", metrics_path.string());
+        }
+        if (!metrics.write(metrics_path)) {
+            exit_code = 1;
+        }
+    }
+    return exit_code;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// A plugin and the engine to run it on, given on the command line as `<engine>:<plugin.wasm>`
+struct PluginSpec {
+    std::string engine;
+    std::filesystem::path plugin_path;
+};
+
+inline std::optional<PluginSpec> parse_plugin_spec(const std::string_view arg) {
+    const auto separator = arg.find(':');
+    if (separator == std::string_view::npos || separator == 0 || separator + 1 == arg.size()) {
+        return std::nullopt;
+    }
+    return PluginSpec { std::string(arg.substr(0, separator)), arg.substr(separator + 1) };
+}
@@ -0,0 +1,70 @@
+#include <cstdint>
+#include <cstring>
+#include <print>
+#include <span>
+
+#include "fake_plugin.hpp"
+#include "host_imports.hpp"
+#include "test.hpp"
+
+struct Request {
+    int64_t key;
+};
+
+struct Result {
+    int32_t value;
+};
+
+int main() {
+    FakePlugin plugin(256);
+    int calls = 0;
+    const auto batch = batch_host_fn<Request, Result>("lookup", [&](const std::span<const Request> requests, const std::span<Result> results) {
+        calls++;
+        for (size_t i = 0; i < requests.size(); i++) {
+            results[i].value = static_cast<int32_t>(requests[i].key * 10);
+        }
+    });
+    const auto call = [&](const int32_t requests, const int32_t count, const int32_t results) { return batch.call(plugin.memory_view(), requests, count, results); };
+
+    // Requests at 16 and results right after them
+    for (int64_t i = 0; i < 4; i++) {
+        std::memcpy(plugin.memory.data() + 16 + i * sizeof(Request), &i, sizeof(i));
+    }
+    CHECK(call(16, 4, 48) == 4 && calls == 1);
+    int32_t last;
+    std::memcpy(&last, plugin.memory.data() + 48 + 3 * sizeof(Result), sizeof(last));
+    CHECK(last == 30);
+    CHECK(call(16, 0, 16) == 0 && calls == 1);
+
+    // Malformed counts, alignments and bounds are rejected without calling the host function
+    CHECK(call(16, -1, 48) == -1);
+    CHECK(call(20, 1, 48) == -1);
+    CHECK(call(16, 1, 50) == -1);
+    CHECK(call(240, 4, 16) == -1);
+    CHECK(call(16, 4, 248) == -1);
+    CHECK(call(-8, 1, 48) == -1);
+    CHECK(call(16, 1, -4) == -1);
+    // Lengths past the 32-bit address space, which would wrap if multiplied in 32 bits
+    CHECK(call(16, 0x20000000, 48) == -1);
+    CHECK(call(16, INT32_MAX, 48) == -1);
+
+    // Arrays overlapping in either order, or one inside the other
+    CHECK(call(16, 4, 40) == -1);
+    CHECK(call(40, 2, 36) == -1);
+    CHECK(call(16, 4, 24) == -1);
+    CHECK(call(16, 2, 32) == 2);
+    CHECK(calls == 2);
+
+    // Arrays ending exactly at the end of memory, which ASan checks after the truncation
+    plugin.truncate(64);
+    CHECK(call(16, 4, 52) == -1);
+    CHECK(call(16, 4, 48) == 4);
+    CHECK(calls == 3);
+
+    if (test_failures > 0) {
+        std::println("{} checks failed", test_failures);
+        return 1;
+    }
+    std::println("All checks passed");
+    return 0;
+}
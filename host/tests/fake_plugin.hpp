@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "guest_memory.hpp"
+
+// Stands in for a plugin's linear memory and its plugin_alloc/plugin_free exports, for host code that works on
+// guest memory. Allocations are bumped from the start and never reused
+class FakePlugin {
+public:
+    explicit FakePlugin(const size_t memory_size) : memory(memory_size) {}
+    FakePlugin(const FakePlugin&) = delete;
+    FakePlugin& operator=(const FakePlugin&) = delete;
+
+    struct Alloc {
+        FakePlugin* plugin;
+
+        explicit operator bool() const { return true; }
+        std::optional<int32_t> operator()(const int32_t size) const {
+            const uint32_t address = (plugin->next + 15) & ~15u;
+            if (size < 0 || address + static_cast<uint64_t>(size) > plugin->memory.size()) {
+                return int32_t { 0 };
+            }
+            plugin->next = address + static_cast<uint32_t>(size);
+            return static_cast<int32_t>(address);
+        }
+    };
+
+    struct Free {
+        explicit operator bool() const { return true; }
+        bool operator()(int32_t, int32_t) const { return true; }
+    };
+
+    // Ends the memory right after `size` bytes in an allocation of its own, so the sanitizers catch reads past it
+    void truncate(const size_t size) { memory = std::vector<uint8_t>(memory.begin(), memory.begin() + static_cast<std::ptrdiff_t>(size)); }
+
+    GuestMemoryView memory_view() const { return GuestMemoryView(std::span(const_cast<uint8_t*>(memory.data()), memory.size())); }
+
+    std::vector<uint8_t> memory;
+    uint32_t next = 16;
+    Alloc plugin_alloc { this };
+    Free plugin_free;
+};
@@ -0,0 +1,89 @@
+#include <cstdint>
+#include <cstring>
+#include <print>
+#include <string_view>
+
+#include "fake_plugin.hpp"
+#include "flat_message.hpp"
+#include "points_schema.hpp"
+#include "test.hpp"
+
+// Overwrites the reference at `ref` in guest memory, as a plugin building a malformed message would
+static void write_ref(FakePlugin& plugin, const uint32_t ref, const int32_t relative, const uint32_t count) {
+    std::memcpy(plugin.memory.data() + ref, &relative, sizeof(relative));
+    std::memcpy(plugin.memory.data() + ref + sizeof(relative), &count, sizeof(count));
+}
+
+int main() {
+    FakePlugin plugin(512);
+    const GuestSpan region { 64, 128 };
+
+    // A message built by the host reads back in place
+    FlatBuilder builder(plugin.memory_view(), region);
+    const auto request = builder.create<PointsRequestBuilder>();
+    request.set_label("points");
+    const auto points = request.init_points(3);
+    for (uint32_t i = 0; i < points.size(); i++) {
+        points[i].set_x(static_cast<int32_t>(i));
+        points[i].set_y(-static_cast<int32_t>(i));
+    }
+    points[3].set_x(99);
+    CHECK(builder);
+    const uint32_t root = request.address();
+    const auto view = read_flat<PointsRequestView>(plugin.memory_view(), region, root);
+    CHECK(view && view->label() == "points");
+    const auto list = view ? view->points() : std::nullopt;
+    CHECK(list && list->size() == 3 && (*list)[2].x() == 2 && (*list)[2].y() == -2);
+
+    // Roots outside the message, or straddling its end
+    CHECK(!read_flat<PointsRequestView>(plugin.memory_view(), region, 60));
+    CHECK(!read_flat<PointsRequestView>(plugin.memory_view(), region, 64 + 128 - 8));
+    CHECK(read_flat<PointsRequestView>(plugin.memory_view(), region, 64 + 128 - 16));
+    CHECK(!read_flat<PointsRequestView>(plugin.memory_view(), region, 0xfffffff0));
+    CHECK(!read_flat<PointsRequestView>(plugin.memory_view(), { 500, 64 }, 500));
+
+    // References out of the message in either direction, too long, or wrapping around 32 bits
+    const auto reread = [&] { return read_flat<PointsRequestView>(plugin.memory_view(), region, root); };
+    const uint32_t label_ref = root;
+    const uint32_t points_ref = root + 8;
+    write_ref(plugin, label_ref, -static_cast<int32_t>(label_ref - region.offset) - 1, 1);
+    CHECK(!reread()->label());
+    write_ref(plugin, label_ref, 8, 128);
+    CHECK(!reread()->label());
+    write_ref(plugin, label_ref, INT32_MAX, 1);
+    CHECK(!reread()->label());
+    write_ref(plugin, points_ref, 8, 0x20000000);
+    CHECK(!reread()->points());
+    write_ref(plugin, points_ref, 8, 0xffffffff);
+    CHECK(!reread()->points());
+    // An empty reference is valid wherever it points
+    write_ref(plugin, points_ref, INT32_MIN, 0);
+    CHECK(reread()->points() && reread()->points()->empty());
+
+    // The last element of a list ending at the end of memory, which ASan checks after the truncation
+    plugin.truncate(region.offset + region.length);
+    // References are relative to themselves, both offsets are in the message
+    const auto to_last_point = static_cast<int32_t>(region.length - PointView::size) - static_cast<int32_t>(points_ref - region.offset);
+    write_ref(plugin, points_ref, to_last_point, 1);
+    CHECK(reread()->points() && (*reread()->points())[0].x() == 0);
+    write_ref(plugin, points_ref, to_last_point + 1, 1);
+    CHECK(!reread()->points());
+
+    // A message that does not fit its region fails, and nothing is written past the region
+    FakePlugin small(256);
+    small.memory[32] = 0xaa;
+    FlatBuilder overflow(small.memory_view(), { 16, 16 });
+    const auto too_long = overflow.create<PointsRequestBuilder>();
+    too_long.set_label("does not fit");
+    too_long.init_points(4)[3].set_x(1);
+    CHECK(!overflow);
+    CHECK(small.memory[32] == 0xaa);
+    CHECK(!FlatBuilder(small.memory_view(), { 250, 16 }));
+
+    if (test_failures > 0) {
+        std::println("{} checks failed", test_failures);
+        return 1;
+    }
+    std::println("All checks passed");
+    return 0;
+}
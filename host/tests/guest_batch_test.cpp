@@ -0,0 +1,58 @@
+#include <cstdint>
+#include <cstring>
+#include <print>
+#include <span>
+#include <vector>
+
+#include "fake_plugin.hpp"
+#include "guest_batch.hpp"
+#include "test.hpp"
+
+int main() {
+    FakePlugin plugin(4096);
+    GuestScratch<FakePlugin> scratch(plugin);
+    int batch_calls = 0;
+    // Doubles each i32 input into an i64 output, like a plugin's batch export would
+    const auto double_all = [&](const int32_t inputs, const int32_t count, const int32_t outputs) {
+        batch_calls++;
+        const auto memory = plugin.memory_view();
+        for (int32_t i = 0; i < count; i++) {
+            int32_t input;
+            std::memcpy(&input, memory.span({ static_cast<uint32_t>(inputs) + 4 * i, 4 })->data(), 4);
+            const int64_t output = 2 * int64_t { input };
+            std::memcpy(memory.span({ static_cast<uint32_t>(outputs) + 8 * i, 8 })->data(), &output, 8);
+        }
+        return true;
+    };
+
+    // Outputs are aligned past the inputs and copied back, and the scratch region is reused
+    const std::vector<int32_t> inputs = { 1, -2, 3 };
+    std::vector<int64_t> outputs(3);
+    CHECK(call_batch(scratch, plugin, double_all, std::span<const int32_t>(inputs), std::span<int64_t>(outputs)));
+    CHECK(outputs == std::vector<int64_t>({ 2, -4, 6 }));
+    const uint32_t next = plugin.next;
+    CHECK(call_batch(scratch, plugin, double_all, std::span<const int32_t>(inputs), std::span<int64_t>(outputs)));
+    CHECK(plugin.next == next && batch_calls == 2);
+
+    // Mismatched counts, and batches larger than the guest's address space, are rejected before the call. The spans
+    // are never read, they only carry a size that would wrap around 32 bits
+    CHECK(!call_batch(scratch, plugin, double_all, std::span<const int32_t>(inputs), std::span<int64_t>(outputs).first(2)));
+    const size_t wrapping_count = (size_t { 1 } << 30) + 1;
+    CHECK(!call_batch(scratch, plugin, double_all, std::span<const int32_t>(inputs.data(), wrapping_count), std::span<int64_t>(outputs.data(), wrapping_count)));
+    const size_t outputs_past_limit = (size_t { 1 } << 29) - 1;
+    CHECK(!call_batch(scratch, plugin, double_all, std::span<const int32_t>(inputs.data(), outputs_past_limit), std::span<int64_t>(outputs.data(), outputs_past_limit)));
+    CHECK(batch_calls == 2);
+
+    // A batch larger than the guest can allocate fails without a call
+    std::vector<int32_t> many(2048);
+    std::vector<int64_t> many_outputs(2048);
+    CHECK(!call_batch(scratch, plugin, double_all, std::span<const int32_t>(many), std::span<int64_t>(many_outputs)));
+    CHECK(batch_calls == 2);
+
+    if (test_failures > 0) {
+        std::println("{} checks failed", test_failures);
+        return 1;
+    }
+    std::println("All checks passed");
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include <cstdint>
+#include <print>
+#include <span>
+#include <vector>
+
+#include "fake_plugin.hpp"
+#include "guest_ring.hpp"
+#include "test.hpp"
+
+constexpr uint32_t capacity = 64;
+
+// A ring that ends exactly where the plugin's memory ends, like one plugin_alloc put at the top of the heap
+struct RingAtEnd {
+    FakePlugin plugin { 4096 };
+    GuestRing ring;
+
+    RingAtEnd() : ring(*GuestRing::create(plugin, capacity)) { plugin.truncate(ring.address() + ring_header_size + capacity); }
+
+    void set_indices(const uint32_t head, const uint32_t tail) const {
+        plugin.memory_view().store(ring.address() + ring_head_offset, head);
+        plugin.memory_view().store(ring.address() + ring_tail_offset, tail);
+    }
+    void store_data(const uint32_t position, const uint32_t value) const { plugin.memory_view().store(ring.address() + ring_header_size + position, value); }
+    uint32_t load_index(const uint32_t offset) const { return *plugin.memory_view().load<uint32_t>(ring.address() + offset); }
+
+    std::optional<size_t> drain(std::vector<uint32_t>* records = nullptr) {
+        return ring.drain(plugin.memory_view(), [&](const std::span<const uint8_t> record) {
+            if (records && record.size() == sizeof(uint32_t)) {
+                uint32_t value;
+                std::memcpy(&value, record.data(), sizeof(value));
+                records->push_back(value);
+            }
+        });
+    }
+};
+
+int main() {
+    {
+        // Records go around the end of the data area several times, with skip markers where one does not fit
+        RingAtEnd ring;
+        std::vector<uint32_t> drained;
+        for (uint32_t round = 0; round < 10; round++) {
+            for (uint32_t i = 0; i < 5; i++) {
+                CHECK(ring.ring.push(ring.plugin.memory_view(), round * 10 + i));
+            }
+            const std::vector<uint8_t> large(20, 1);
+            CHECK(ring.ring.push(ring.plugin.memory_view(), std::span<const uint8_t>(large)));
+            CHECK(ring.drain(&drained) == size_t { 6 });
+        }
+        CHECK(drained.size() == 50 && drained.front() == 0 && drained.back() == 94);
+        CHECK(ring.load_index(ring_head_offset) == ring.load_index(ring_tail_offset));
+        CHECK(!ring.ring.push(ring.plugin.memory_view(), std::span<const uint8_t>(std::vector<uint8_t>(capacity + 1))));
+    }
+
+    // Indices the plugin left unaligned would put a record's length across the end of the memory
+    for (const auto& [head, tail] : { std::pair { 62u, 0u }, std::pair { 64u, 2u }, std::pair { 63u, 61u }, std::pair { 3u, 0u } }) {
+        RingAtEnd ring;
+        ring.set_indices(head, tail);
+        CHECK(!ring.drain());
+    }
+    {
+        RingAtEnd ring;
+        ring.set_indices(capacity - 2, capacity - 2);
+        CHECK(!ring.ring.push(ring.plugin.memory_view(), uint32_t { 7 }));
+        CHECK(ring.load_index(ring_head_offset) == capacity - 2);
+    }
+    {
+        RingAtEnd ring;
+        // The consumer's index is only read once the ring looks full
+        ring.set_indices(0, 2);
+        CHECK(ring.ring.push(ring.plugin.memory_view(), std::span<const uint8_t>(std::vector<uint8_t>(capacity - 8))));
+        CHECK(!ring.ring.push(ring.plugin.memory_view(), std::span<const uint8_t>(std::vector<uint8_t>(capacity - 8))));
+    }
+
+    // Lengths that run past the data area or past what the producer published
+    {
+        RingAtEnd ring;
+        ring.set_indices(capacity, 0);
+        ring.store_data(0, capacity);
+        CHECK(!ring.drain());
+        ring.store_data(0, capacity - 4);
+        CHECK(ring.drain() == size_t { 1 });
+    }
+    {
+        RingAtEnd ring;
+        ring.set_indices(capacity + 56, 56);
+        ring.store_data(56, 5);
+        CHECK(!ring.drain());
+        ring.store_data(56, 0xffff'fff0);
+        CHECK(!ring.drain());
+    }
+    {
+        RingAtEnd ring;
+        ring.set_indices(8, 0);
+        ring.store_data(0, 16);
+        CHECK(!ring.drain());
+    }
+
+    // More published than the ring holds, and a skip marker past the published bytes
+    {
+        RingAtEnd ring;
+        ring.set_indices(capacity + 4, 0);
+        CHECK(!ring.drain());
+    }
+    {
+        RingAtEnd ring;
+        ring.set_indices(52, 48);
+        ring.store_data(48, ring_skip_marker);
+        CHECK(!ring.drain());
+    }
+
+    if (test_failures > 0) {
+        std::println("{} checks failed", test_failures);
+        return 1;
+    }
+    std::println("All checks passed");
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <print>
+#include <string_view>
+#include <vector>
+
+#include "host_files.hpp"
+#include "test.hpp"
+
+// Guest memory of the test, paths are written at its start and buffers follow them
+struct TestMemory {
+    std::vector<uint8_t> bytes = std::vector<uint8_t>(4096);
+    GuestMemoryView view { bytes };
+
+    GuestString path(const std::string_view text) {
+        std::ranges::copy(text, bytes.begin());
+        return { { 0, static_cast<uint32_t>(text.size()) } };
+    }
+    GuestSpan buffer(const uint32_t length) { return { 1024, length }; }
+    std::string_view read(const uint32_t length) const { return { reinterpret_cast<const char*>(bytes.data()) + 1024, length }; }
+};
+
+static void write_text(const std::filesystem::path& path, const std::string_view text) {
+    std::ofstream(path, std::ios::binary) << text;
+}
+
+int main() {
+    const auto base = std::filesystem::temp_directory_path() / std::format("host_files_test_{}", std::chrono::steady_clock::now().time_since_epoch().count());
+    std::filesystem::remove_all(base);
+    const auto root = base / "data";
+    std::filesystem::create_directories(root / "nested");
+    write_text(root / "inside.txt", "inside");
+    write_text(root / "nested" / "deep.txt", "deep");
+    write_text(base / "outside.txt", "outside");
+    std::filesystem::create_symlink(base / "outside.txt", root / "leak.txt");
+    std::filesystem::create_directory_symlink(base, root / "leak_dir");
+    std::filesystem::create_symlink("inside.txt", root / "alias.txt");
+
+    HostFiles files(root);
+    TestMemory memory;
+
+    // Paths leading out of the directory, lexically or through a symlink. Symlinks are never followed, so even one
+    // to a file inside is rejected
+    const std::string absolute = (base / "outside.txt").string();
+    const std::string_view escaping[] = { "..", "../outside.txt", "nested/../../outside.txt", "/etc/passwd", absolute,
+                                          "leak.txt", "leak_dir/outside.txt", "alias.txt", "", std::string_view("a\0b", 3) };
+    for (const std::string_view path : escaping) {
+        CHECK(files.file_size(memory.view, memory.path(path)) == host_file_invalid_argument);
+        CHECK(files.read_file(memory.view, memory.path(path), memory.buffer(64)) == host_file_invalid_argument);
+        CHECK(files.read_file_at(memory.view, memory.path(path), 0, memory.buffer(64)) == host_file_invalid_argument);
+        CHECK(files.write_file(memory.view, memory.path(path), memory.buffer(4)) == host_file_invalid_argument);
+    }
+    CHECK(std::filesystem::file_size(base / "outside.txt") == 7);
+
+    // Paths that stay inside, including a ".." that does not leave it
+    CHECK(files.read_file(memory.view, memory.path("inside.txt"), memory.buffer(64)) == 6 && memory.read(6) == "inside");
+    CHECK(files.read_file(memory.view, memory.path("nested/../nested/deep.txt"), memory.buffer(64)) == 4 && memory.read(4) == "deep");
+    CHECK(files.read_file(memory.view, memory.path("./nested/deep.txt"), memory.buffer(64)) == 4 && memory.read(4) == "deep");
+    CHECK(files.file_size(memory.view, memory.path("missing.txt")) == host_file_not_found);
+    CHECK(files.read_file(memory.view, memory.path("missing.txt"), memory.buffer(64)) == host_file_not_found);
+
+    // Reads return the whole size but copy only up to the capacity, and windows stop at the end of the file
+    CHECK(files.read_file(memory.view, memory.path("inside.txt"), memory.buffer(2)) == 6 && memory.read(2) == "in");
+    CHECK(files.read_file_at(memory.view, memory.path("inside.txt"), 2, memory.buffer(64)) == 4 && memory.read(4) == "side");
+    CHECK(files.read_file_at(memory.view, memory.path("inside.txt"), 6, memory.buffer(64)) == 0);
+    CHECK(files.read_file_at(memory.view, memory.path("inside.txt"), -1, memory.buffer(64)) == host_file_invalid_argument);
+    CHECK(files.read_file(memory.view, memory.path("inside.txt"), { 4090, 64 }) == host_file_invalid_argument);
+
+    // A file truncated between reads is read at its new size
+    write_text(root / "inside.txt", "in");
+    CHECK(files.read_file(memory.view, memory.path("inside.txt"), memory.buffer(64)) == 2 && memory.read(2) == "in");
+    CHECK(files.read_file_at(memory.view, memory.path("inside.txt"), 4, memory.buffer(64)) == 0);
+
+    // Writes replace the file, new files are created inside the directory
+    const std::string_view written = "written";
+    std::ranges::copy(written, memory.bytes.begin() + 1024);
+    CHECK(files.write_file(memory.view, memory.path("nested/new.txt"), memory.buffer(static_cast<uint32_t>(written.size()))) == 0);
+    CHECK(files.file_size(memory.view, memory.path("nested/new.txt")) == static_cast<int64_t>(written.size()));
+    CHECK(files.write_file(memory.view, memory.path("missing_dir/new.txt"), memory.buffer(4)) == host_file_not_found);
+
+    std::filesystem::remove_all(base);
+    if (test_failures > 0) {
+        std::println("{} checks failed", test_failures);
+        return 1;
+    }
+    std::println("All checks passed");
+    return 0;
+}
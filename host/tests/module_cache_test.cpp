@@ -0,0 +1,47 @@
+#include <cstdint>
+#include <print>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "module_cache.hpp"
+#include "test.hpp"
+
+static std::span<const uint8_t> bytes(const std::string_view text) {
+    return { reinterpret_cast<const uint8_t*>(text.data()), text.size() };
+}
+
+static std::string sha256_hex(const std::string_view text) {
+    constexpr std::string_view digits = "0123456789abcdef";
+    std::string hex;
+    for (const uint8_t byte : sha256(bytes(text))) {
+        hex += digits[byte >> 4];
+        hex += digits[byte & 15];
+    }
+    return hex;
+}
+
+int main() {
+    // FIPS 180-4 examples, plus lengths around the padding that does and does not fit the last block
+    CHECK(sha256_hex("") == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    CHECK(sha256_hex("abc") == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    CHECK(sha256_hex("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq") == "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+    CHECK(sha256_hex(std::string(55, 'a')) == "9f4390f8d30c2dd92ec9f095b65e2b9ae9b0a925a5258e241c9f1e910f734318");
+    CHECK(sha256_hex(std::string(64, 'a')) == "ffe054fe7ae0cb6dc65c3af9b61d5209f439851db43d0ba5997337df154668eb");
+    CHECK(sha256_hex(std::string(1000000, 'a')) == "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+
+    // Entries differ by content of the same size and by engine config
+    const ModuleCache cache { "cache", "engine;a" };
+    const ModuleCache other_engine { "cache", "engine;b" };
+    CHECK(module_cache_entry_path(cache, bytes("wasm1")) != module_cache_entry_path(cache, bytes("wasm2")));
+    CHECK(module_cache_entry_path(cache, bytes("wasm1")) != module_cache_entry_path(other_engine, bytes("wasm1")));
+    CHECK(module_cache_entry_path(cache, bytes("wasm1")) == module_cache_entry_path(cache, bytes("wasm1")));
+    CHECK(module_cache_entry_path(cache, bytes("wasm1")).parent_path() == "cache");
+
+    if (test_failures > 0) {
+        std::println("{} checks failed", test_failures);
+        return 1;
+    }
+    std::println("All checks passed");
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <print>
+#include <thread>
+#include <vector>
+
+#include "plugin_executor.hpp"
+#include "test.hpp"
+
+// Stands in for a plugin instance, a task poisons it the way a trapping call would
+struct FakeInstance {
+    bool poisoned = false;
+    bool is_poisoned() const { return poisoned; }
+};
+
+// Waits for a worker to finish retiring, which happens after the task that poisoned it has completed
+static bool wait_for_live_workers(const PluginExecutor<FakeInstance>& executor, const size_t count) {
+    for (int i = 0; i < 1000 && executor.live_workers() != count; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return executor.live_workers() == count;
+}
+
+static bool is_broken_promise(std::future<bool>& future) {
+    try {
+        future.get();
+    }
+    catch (const std::future_error& error) {
+        return error.code() == std::future_errc::broken_promise;
+    }
+    return false;
+}
+
+int main() {
+    // Every task runs once, on some worker
+    {
+        PluginExecutor<FakeInstance> executor([] { return std::make_unique<FakeInstance>(); }, 4);
+        CHECK(executor.live_workers() == 4);
+        std::vector<std::future<int64_t>> results;
+        for (int64_t i = 0; i < 10000; i++) {
+            results.push_back(executor.submit([i](FakeInstance&) { return i; }));
+        }
+        int64_t total = 0;
+        for (auto& result : results) {
+            total += result.get();
+        }
+        CHECK(total == 10000 * 9999 / 2);
+    }
+
+    // Instances are built for the two workers, then every rebuild fails
+    std::atomic<int> builds = 0;
+    const auto factory = [&]() -> std::unique_ptr<FakeInstance> { return builds++ < 2 ? std::make_unique<FakeInstance>() : nullptr; };
+    {
+        PluginExecutor<FakeInstance> executor(factory, 2);
+        CHECK(executor.live_workers() == 2);
+        // Tasks report whether they ran on a poisoned instance, which must never happen
+        const auto poison = [](FakeInstance& instance) { const bool was_poisoned = instance.poisoned; instance.poisoned = true; return !was_poisoned; };
+        const auto call = [](FakeInstance& instance) { return !instance.poisoned; };
+
+        auto first = executor.submit(poison);
+        CHECK(first.get());
+        CHECK(wait_for_live_workers(executor, 1));
+        std::vector<std::future<bool>> results;
+        for (int i = 0; i < 1000; i++) {
+            results.push_back(executor.submit(call));
+        }
+        for (auto& result : results) {
+            CHECK(result.get());
+        }
+
+        // Once the last worker retires, queued and new tasks fail instead of hanging
+        auto last = executor.submit(poison);
+        CHECK(last.get());
+        CHECK(wait_for_live_workers(executor, 0));
+        auto after = executor.submit(call);
+        CHECK(is_broken_promise(after));
+    }
+
+    // Tasks queued behind the call that poisons the last worker are dropped with it
+    builds = 1;
+    {
+        PluginExecutor<FakeInstance> executor(factory, 1);
+        std::promise<void> started;
+        std::promise<void> release;
+        auto blocked = executor.submit([&started, gate = release.get_future().share()](FakeInstance& instance) {
+            started.set_value();
+            gate.wait();
+            instance.poisoned = true;
+            return true;
+        });
+        // Workers run their own newest task first, so the rest is only queued once this one runs
+        started.get_future().wait();
+        std::vector<std::future<bool>> queued;
+        for (int i = 0; i < 10; i++) {
+            queued.push_back(executor.submit([](FakeInstance& instance) { return !instance.poisoned; }));
+        }
+        release.set_value();
+        CHECK(blocked.get());
+        for (auto& result : queued) {
+            CHECK(is_broken_promise(result));
+        }
+        CHECK(executor.live_workers() == 0);
+    }
+
+    if (test_failures > 0) {
+        std::println("{} checks failed", test_failures);
+        return 1;
+    }
+    std::println("All checks passed");
+    return 0;
+}
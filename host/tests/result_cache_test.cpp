@@ -0,0 +1,71 @@
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <print>
+#include <vector>
+
+#include "result_cache.hpp"
+#include "test.hpp"
+
+int main() {
+    std::vector<uint8_t> memory(256);
+    const auto memory_fn = [&] { return GuestMemoryView { memory }; };
+    const auto write_words = [&](const uint32_t address, const uint64_t first, const uint64_t second) {
+        std::memcpy(memory.data() + address, &first, sizeof(first));
+        std::memcpy(memory.data() + address + sizeof(first), &second, sizeof(second));
+    };
+
+    ResultCache cache(parse_pure_exports("sum\nchecksum 0:1\n"), { .capacity = 2, .shards = 1, .max_buffer_bytes = 64 });
+    const auto checksum = cache.find_export("checksum", signature_of<int32_t, int32_t, int32_t>());
+    CHECK(checksum && !cache.find_export("checksum", signature_of<int32_t, int64_t, int32_t>()));
+    CHECK(!cache.find_export("missing", signature_of<int32_t, int32_t>()));
+
+    // Two buffers of different contents whose hashes collide. hash_mix(0, x) is a bijection, so the second word
+    // can be picked to cancel out the difference in the first
+    const uint64_t first = 0x0123456789abcdef;
+    const uint64_t other_first = 0xfedcba9876543210;
+    const uint64_t second = 42;
+    const uint64_t colliding_second = hash_mix(0, first) ^ second ^ hash_mix(0, other_first);
+    write_words(0, first, second);
+    const auto key = cache.key(*checksum, memory_fn, 0, 16);
+    write_words(0, other_first, colliding_second);
+    const auto colliding_key = cache.key(*checksum, memory_fn, 0, 16);
+    CHECK(key && colliding_key);
+    CHECK(key->hash == colliding_key->hash && !(*key == *colliding_key));
+    cache.insert(*colliding_key, { .i32 = 2 });
+    CHECK(!cache.find(*key));
+    write_words(0, first, second);
+    cache.insert(*key, { .i32 = 1 });
+    CHECK(cache.find(*key) && cache.find(*key)->i32 == 1);
+    CHECK(cache.find(*colliding_key) && cache.find(*colliding_key)->i32 == 2);
+
+    // The key keeps its own copy, a buffer changed after the call misses
+    write_words(0, first, second + 1);
+    CHECK(!cache.find(*cache.key(*checksum, memory_fn, 0, 16)));
+    write_words(0, first, second);
+    CHECK(cache.find(*cache.key(*checksum, memory_fn, 0, 16)));
+
+    // Buffers out of bounds, wrapping around the address space or over max_buffer_bytes are not cached
+    CHECK(!cache.key(*checksum, memory_fn, 250, 16));
+    CHECK(!cache.key(*checksum, memory_fn, -8, 16));
+    CHECK(!cache.key(*checksum, memory_fn, 16, -1));
+    CHECK(!cache.key(*checksum, memory_fn, 0, 65));
+    CHECK(cache.key(*checksum, memory_fn, 0, 64));
+    CHECK(cache.key(*checksum, memory_fn, 256, 0));
+
+    // Scalar arguments are compared bit for bit, and a full shard evicts
+    const auto sum = cache.find_export("sum", signature_of<int32_t, int32_t, int32_t>());
+    CHECK(sum);
+    cache.insert(*cache.key(*sum, memory_fn, 1, 2), { .i32 = 3 });
+    CHECK(cache.find(*cache.key(*sum, memory_fn, 1, 2))->i32 == 3);
+    CHECK(!cache.find(*cache.key(*sum, memory_fn, 2, 1)));
+    const auto stats = cache.stats();
+    CHECK(stats.entries == 2 && stats.evictions == 1);
+
+    if (test_failures > 0) {
+        std::println("{} checks failed", test_failures);
+        return 1;
+    }
+    std::println("All checks passed");
+    return 0;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <print>
+
+// Unlike assert, also checked in release builds. Failures are reported and counted, so one run shows all of them
+inline int test_failures = 0;
+
+#define CHECK(condition)                                                                \
+    do {                                                                                \
+        if (!(condition)) {                                                             \
+            std::println("FAILED: {}:{}: {}", __FILE__, __LINE__, #condition);          \
+            test_failures++;                                                            \
+        }                                                                               \
+    } while (false)
@@ -0,0 +1,356 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <print>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "engine_loader.hpp"
+#include "plugin_api.hpp"
+#include "snapshot.hpp"
+#include "test.hpp"
+#include "wasm_rewriter.hpp"
+
+// Bakes a small module and reads it back. Without arguments only the rewritten bytes are checked, each argument
+// names an engine backend that also snapshots the module for real and runs the baked one
+
+constexpr int32_t init_i32 = 42;
+constexpr int64_t init_i64 = -7;
+constexpr double init_f64 = 2.5;
+constexpr int32_t immutable_i32 = 5;
+constexpr uint32_t grown_address = 65536 + 16;
+constexpr int32_t grown_value = 0x12345678;
+constexpr std::string_view data_bytes = "abc";
+constexpr size_t page_size = 65536;
+
+static void uleb(std::vector<uint8_t>& out, uint64_t value) {
+    do {
+        const uint8_t next = value & 0x7f;
+        value >>= 7;
+        out.push_back(value ? next | 0x80 : next);
+    } while (value);
+}
+
+static void sleb(std::vector<uint8_t>& out, int64_t value) {
+    while (true) {
+        const uint8_t next = value & 0x7f;
+        value >>= 7;
+        if ((value == 0 && !(next & 0x40)) || (value == -1 && (next & 0x40))) {
+            out.push_back(next);
+            return;
+        }
+        out.push_back(next | 0x80);
+    }
+}
+
+static void name(std::vector<uint8_t>& out, const std::string_view text) {
+    uleb(out, text.size());
+    out.insert(out.end(), text.begin(), text.end());
+}
+
+static void f64_const(std::vector<uint8_t>& out, const double value) {
+    out.push_back(0x44);
+    const auto bits = std::bit_cast<std::array<uint8_t, 8>>(value);
+    out.insert(out.end(), bits.begin(), bits.end());
+}
+
+static void section(std::vector<uint8_t>& out, const uint8_t id, const std::vector<uint8_t>& payload) {
+    out.push_back(id);
+    uleb(out, payload.size());
+    out.insert(out.end(), payload.begin(), payload.end());
+}
+
+// Globals: 0 mutable i32, 1 mutable i64, 2 immutable i32, 3 mutable f64. The start function adds init_i32 to
+// global 0, grows memory by a page and stores grown_value in it, plugin_init sets globals 1 and 3. Running the
+// start function again on a baked module would leave global 0 at twice init_i32
+static std::vector<uint8_t> build_module() {
+    std::vector<uint8_t> wasm { 0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00 };
+
+    // () -> (), () -> i32, () -> i64, () -> f64
+    section(wasm, 1, { 4, 0x60, 0, 0, 0x60, 0, 1, 0x7f, 0x60, 0, 1, 0x7e, 0x60, 0, 1, 0x7c });
+    // start, plugin_init, clobber, get_i32, get_i64, get_f64, load_grown, get_immutable
+    section(wasm, 3, { 8, 0, 0, 0, 1, 2, 3, 1, 1 });
+    // One memory of 1 to 4 pages
+    section(wasm, 5, { 1, 0x01, 1, 4 });
+
+    std::vector<uint8_t> globals { 4 };
+    globals.insert(globals.end(), { 0x7f, 1, 0x41, 0, 0x0b });
+    globals.insert(globals.end(), { 0x7e, 1, 0x42, 0, 0x0b });
+    globals.insert(globals.end(), { 0x7f, 0, 0x41, immutable_i32, 0x0b });
+    globals.insert(globals.end(), { 0x7c, 1 });
+    f64_const(globals, 0.0);
+    globals.push_back(0x0b);
+    section(wasm, 6, globals);
+
+    std::vector<uint8_t> exports { 8 };
+    name(exports, "memory");
+    exports.insert(exports.end(), { 0x02, 0 });
+    const std::string_view function_exports[] = { "plugin_init", "clobber", "get_i32", "get_i64", "get_f64", "load_grown", "get_immutable" };
+    for (size_t i = 0; i < std::size(function_exports); i++) {
+        name(exports, function_exports[i]);
+        exports.push_back(0x00);
+        uleb(exports, i + 1);
+    }
+    section(wasm, 7, exports);
+    section(wasm, 8, { 0 });
+
+    std::vector<std::vector<uint8_t>> bodies(8);
+    bodies[0] = { 0x23, 0, 0x41 };
+    sleb(bodies[0], init_i32);
+    bodies[0].insert(bodies[0].end(), { 0x6a, 0x24, 0, 0x41, 1, 0x40, 0, 0x1a, 0x41 });
+    sleb(bodies[0], grown_address);
+    bodies[0].push_back(0x41);
+    sleb(bodies[0], grown_value);
+    bodies[0].insert(bodies[0].end(), { 0x36, 2, 0 });
+    bodies[1] = { 0x42 };
+    sleb(bodies[1], init_i64);
+    bodies[1].insert(bodies[1].end(), { 0x24, 1 });
+    f64_const(bodies[1], init_f64);
+    bodies[1].insert(bodies[1].end(), { 0x24, 3 });
+    bodies[2] = { 0x41, 0, 0x24, 0, 0x42, 0, 0x24, 1 };
+    f64_const(bodies[2], 0.0);
+    bodies[2].insert(bodies[2].end(), { 0x24, 3 });
+    bodies[3] = { 0x23, 0 };
+    bodies[4] = { 0x23, 1 };
+    bodies[5] = { 0x23, 3 };
+    bodies[6] = { 0x41 };
+    sleb(bodies[6], grown_address);
+    bodies[6].insert(bodies[6].end(), { 0x28, 2, 0 });
+    bodies[7] = { 0x23, 2 };
+    std::vector<uint8_t> code;
+    uleb(code, bodies.size());
+    for (auto& body : bodies) {
+        body.insert(body.begin(), 0); // no locals
+        body.push_back(0x0b);
+        uleb(code, body.size());
+        code.insert(code.end(), body.begin(), body.end());
+    }
+    section(wasm, 10, code);
+
+    std::vector<uint8_t> data { 1, 0, 0x41, 0, 0x0b };
+    name(data, data_bytes);
+    section(wasm, 11, data);
+    return wasm;
+}
+
+// Just enough of a decoder to check what the rewrite produced
+class TestReader {
+public:
+    explicit TestReader(const std::span<const uint8_t> bytes) : bytes(bytes) {}
+
+    bool at_end() const { return position >= bytes.size(); }
+    uint8_t byte() { return position < bytes.size() ? bytes[position++] : 0; }
+
+    uint64_t uleb() {
+        uint64_t value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            const uint8_t next = byte();
+            value |= static_cast<uint64_t>(next & 0x7f) << shift;
+            if (!(next & 0x80)) {
+                break;
+            }
+        }
+        return value;
+    }
+
+    int64_t sleb() {
+        int64_t value = 0;
+        unsigned shift = 0;
+        uint8_t next = 0;
+        do {
+            next = byte();
+            value |= static_cast<int64_t>(next & 0x7f) << shift;
+            shift += 7;
+        } while ((next & 0x80) && shift < 64);
+        if (shift < 64 && (next & 0x40)) {
+            value |= -(int64_t { 1 } << shift);
+        }
+        return value;
+    }
+
+    std::span<const uint8_t> take(const size_t count) {
+        const auto taken = bytes.subspan(std::min(position, bytes.size()), std::min(count, bytes.size() - std::min(position, bytes.size())));
+        position += count;
+        return taken;
+    }
+
+    std::string_view name() {
+        const auto text = take(uleb());
+        return { reinterpret_cast<const char*>(text.data()), text.size() };
+    }
+
+private:
+    std::span<const uint8_t> bytes;
+    size_t position = 0;
+};
+
+// Payloads of the module's sections by id, custom sections left out
+static std::vector<std::span<const uint8_t>> read_sections(const std::span<const uint8_t> wasm) {
+    std::vector<std::span<const uint8_t>> sections(13);
+    TestReader reader(wasm.subspan(8));
+    while (!reader.at_end()) {
+        const uint8_t id = reader.byte();
+        const auto payload = reader.take(reader.uleb());
+        if (id > 0 && id < sections.size()) {
+            sections[id] = payload;
+        }
+    }
+    return sections;
+}
+
+static void check_baked_bytes(const std::vector<uint8_t>& wasm) {
+    const auto globals = read_snapshot_globals(wasm);
+    CHECK(globals && globals->size() == 3);
+    if (!globals || globals->size() != 3) {
+        return;
+    }
+    CHECK((*globals)[0].index == 0 && (*globals)[0].kind == ValKind::I32);
+    CHECK((*globals)[1].index == 1 && (*globals)[1].kind == ValKind::I64);
+    CHECK((*globals)[2].index == 3 && (*globals)[2].kind == ValKind::F64);
+
+    // Memory as the start function and plugin_init left it: the data segment, and a second page they grew
+    std::vector<uint8_t> memory(2 * page_size);
+    std::ranges::copy(data_bytes, memory.begin());
+    std::memcpy(memory.data() + grown_address, &grown_value, sizeof(grown_value));
+    PluginValue values[3];
+    values[0].i32 = init_i32;
+    values[1].i64 = init_i64;
+    values[2].f64 = init_f64;
+    const std::string_view dropped_exports[] = { "plugin_init" };
+    const auto baked = bake_snapshot(wasm, *globals, values, memory, dropped_exports);
+    CHECK(baked.has_value());
+    if (!baked) {
+        return;
+    }
+
+    // The rewritten module still parses, with the same mutable globals
+    const auto baked_globals = read_snapshot_globals(*baked);
+    CHECK(baked_globals && baked_globals->size() == globals->size());
+    for (size_t i = 0; baked_globals && i < std::min(baked_globals->size(), globals->size()); i++) {
+        CHECK((*baked_globals)[i].index == (*globals)[i].index && (*baked_globals)[i].kind == (*globals)[i].kind);
+    }
+    CHECK(read_function_imports(*baked).has_value());
+
+    const auto sections = read_sections(*baked);
+    CHECK(sections[8].empty());
+
+    TestReader memories(sections[5]);
+    CHECK(memories.uleb() == 1 && memories.byte() == 0x01 && memories.uleb() == 2 && memories.uleb() == 4);
+
+    TestReader global_inits(sections[6]);
+    CHECK(global_inits.uleb() == 4);
+    CHECK(global_inits.byte() == 0x7f && global_inits.byte() == 1 && global_inits.byte() == 0x41 && global_inits.sleb() == init_i32 && global_inits.byte() == 0x0b);
+    CHECK(global_inits.byte() == 0x7e && global_inits.byte() == 1 && global_inits.byte() == 0x42 && global_inits.sleb() == init_i64 && global_inits.byte() == 0x0b);
+    CHECK(global_inits.byte() == 0x7f && global_inits.byte() == 0 && global_inits.byte() == 0x41 && global_inits.sleb() == immutable_i32 && global_inits.byte() == 0x0b);
+    CHECK(global_inits.byte() == 0x7c && global_inits.byte() == 1 && global_inits.byte() == 0x44);
+    double f64_init = 0.0;
+    std::memcpy(&f64_init, global_inits.take(8).data(), sizeof(f64_init));
+    CHECK(f64_init == init_f64 && global_inits.byte() == 0x0b);
+
+    std::vector<std::string_view> export_names;
+    TestReader exports(sections[7]);
+    for (uint64_t count = exports.uleb(); count > 0 && !exports.at_end(); count--) {
+        export_names.push_back(exports.name());
+        exports.byte();
+        exports.uleb();
+    }
+    CHECK(std::ranges::find(export_names, restore_globals_export) != export_names.end());
+    CHECK(std::ranges::find(export_names, "plugin_init") == export_names.end());
+    CHECK(std::ranges::find(export_names, "get_i32") != export_names.end());
+
+    // One restore function added to the eight of the module
+    TestReader functions(sections[3]);
+    TestReader code(sections[10]);
+    CHECK(functions.uleb() == 9 && code.uleb() == 9);
+
+    // Both pages hold data, so both become segments and the module's own is dropped
+    TestReader data(sections[11]);
+    CHECK(data.uleb() == 2);
+}
+
+// Snapshots the module on `backend` the way plugin hosts do, then checks that instances of the baked module
+// start out initialized without running the start function again, and that restoring the globals undoes calls
+static void check_baked_instance(const std::string_view backend, const std::vector<uint8_t>& wasm, const std::filesystem::path& directory) {
+    std::println("Running the baked module on {}", backend);
+    const auto engine = load_plugin_engine(backend, {});
+    CHECK(engine != nullptr);
+    if (!engine) {
+        return;
+    }
+    PluginHostOptions options;
+    options.plugin_path = directory / "rewriter_test.wasm";
+    options.cache_dir.clear();
+    options.wasi.data_dir = directory / "data";
+    options.wasi.inherit_stdio = false;
+    std::ofstream(options.plugin_path, std::ios::binary).write(reinterpret_cast<const char*>(wasm.data()), static_cast<std::streamsize>(wasm.size()));
+
+    const auto snapshot = preinitialize_plugin(*engine, options, "plugin_init");
+    CHECK(snapshot.has_value());
+    if (!snapshot) {
+        return;
+    }
+    CHECK(snapshot->memory.size() == 2 * page_size);
+    options.plugin_bytes = snapshot->module;
+    const auto host = engine->load(options);
+    const auto session = host ? host->instantiate() : nullptr;
+    CHECK(session != nullptr);
+    if (!session) {
+        return;
+    }
+
+    PluginFn<void()> clobber, restore_globals;
+    PluginFn<int32_t()> get_i32, load_grown, get_immutable;
+    PluginFn<int64_t()> get_i64;
+    PluginFn<double()> get_f64;
+    CHECK(clobber.bind(*host, *session, "clobber") && restore_globals.bind(*host, *session, restore_globals_export));
+    CHECK(get_i32.bind(*host, *session, "get_i32") && get_i64.bind(*host, *session, "get_i64") && get_f64.bind(*host, *session, "get_f64"));
+    CHECK(load_grown.bind(*host, *session, "load_grown") && get_immutable.bind(*host, *session, "get_immutable"));
+    CHECK(!host->find_function("plugin_init", signature_of<void>()));
+    if (!clobber || !restore_globals || !get_i32 || !get_i64 || !get_f64 || !load_grown || !get_immutable) {
+        return;
+    }
+
+    const auto check_initialized = [&] {
+        CHECK(get_i32() == init_i32);
+        CHECK(get_i64() == init_i64);
+        CHECK(get_f64() == init_f64);
+        CHECK(get_immutable() == immutable_i32);
+    };
+    check_initialized();
+    CHECK(load_grown() == grown_value);
+    const auto memory = session->memory_view();
+    CHECK(memory.size() == 2 * page_size && memory.string({ 0, static_cast<uint32_t>(data_bytes.size()) }) == data_bytes);
+
+    CHECK(clobber() && get_i32() == 0 && get_i64() == 0 && get_f64() == 0.0);
+    CHECK(restore_globals());
+    check_initialized();
+}
+
+int main(const int argc, char** argv) {
+    const auto wasm = build_module();
+    check_baked_bytes(wasm);
+
+    if (argc > 1) {
+        const auto directory = std::filesystem::temp_directory_path() / std::format("wasm_rewriter_test_{}", std::chrono::steady_clock::now().time_since_epoch().count());
+        std::filesystem::create_directories(directory);
+        for (int i = 1; i < argc; i++) {
+            check_baked_instance(argv[i], wasm, directory);
+        }
+        std::filesystem::remove_all(directory);
+    }
+
+    if (test_failures > 0) {
+        std::println("{} checks failed", test_failures);
+        return 1;
+    }
+    std::println("All checks passed");
+    return 0;
+}
@@ -0,0 +1,26 @@
+#include "engine_config.hpp"
+
+#include <format>
+#include <limits>
+
+// Every operator costs one point. The budget a call starts with is set per call, so instances start unlimited
+static uint64_t metering_cost(wasmer_parser_operator_t) {
+    return 1;
+}
+
+wasm_engine_t* create_engine(const EngineOptions& options) {
+    wasm_config_t* config = wasm_config_new();
+    if (!config) {
+        return nullptr;
+    }
+    wasm_config_set_compiler(config, options.compiler);
+    if (options.metering) {
+        wasmer_metering_t* metering = wasmer_metering_new(std::numeric_limits<uint64_t>::max(), metering_cost);
+        wasm_config_push_middleware(config, wasmer_metering_as_middleware(metering));
+    }
+    return wasm_engine_new_with_config(config);
+}
+
+std::string engine_fingerprint(const EngineOptions& options) {
+    return std::format("wasmer-{};compiler={};metering={}", WASMER_VERSION, static_cast<int>(options.compiler), options.metering);
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+#include <wasmer.h>
+
+// Engine-wide settings. Everything here that affects generated code must be part of engine_fingerprint()
+struct EngineOptions {
+    wasmer_compiler_t compiler = CRANELIFT;
+    // Instrument plugins to count executed operators, so calls can be given a budget of points
+    bool metering = false;
+};
+
+wasm_engine_t* create_engine(const EngineOptions& options);
+
+// Identifies the engine version and code generation settings, used to key precompiled modules
+std::string engine_fingerprint(const EngineOptions& options);
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <print>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <wasmer.h>
+
+#include "wasm_types.hpp"
+#include "wasmer_errors.hpp"
+
+template<typename T>
+T load_val(const wasm_val_t& val) {
+    if constexpr (std::is_same_v<T, int32_t>) return val.of.i32;
+    else if constexpr (std::is_same_v<T, int64_t>) return val.of.i64;
+    else if constexpr (std::is_same_v<T, float>) return val.of.f32;
+    else if constexpr (std::is_same_v<T, double>) return val.of.f64;
+}
+
+template<typename T>
+void store_val(wasm_val_t& val, const T value) {
+    val.kind = wasm_valkind_v<T>;
+    if constexpr (std::is_same_v<T, int32_t>) val.of.i32 = value;
+    else if constexpr (std::is_same_v<T, int64_t>) val.of.i64 = value;
+    else if constexpr (std::is_same_v<T, float>) val.of.f32 = value;
+    else if constexpr (std::is_same_v<T, double>) val.of.f64 = value;
+}
+
+template<typename Signature>
+struct HostFn;
+
+// Trampoline between wasmer's host call convention and a typed C++ callable. The store checks the import's type
+// against the declared signature when the plugin is instantiated, so the values can be read without checks
+template<typename R, typename... Args>
+struct HostFn<R(Args...)> {
+    static wasm_functype_t* functype() { return make_functype<R, Args...>(); }
+
+    template<typename F>
+    static wasm_trap_t* invoke(void* env, const wasm_val_vec_t* args, wasm_val_vec_t* results) {
+        auto& fn = *static_cast<F*>(env);
+        return invoke_with(fn, args, results, std::index_sequence_for<Args...> {});
+    }
+
+private:
+    template<typename F, size_t... I>
+    static wasm_trap_t* invoke_with(F& fn, const wasm_val_vec_t* args, wasm_val_vec_t* results, std::index_sequence<I...>) {
+        if constexpr (std::is_void_v<R>) {
+            fn(load_val<Args>(args->data[I])...);
+        }
+        else {
+            store_val<R>(results->data[0], fn(load_val<Args>(args->data[I])...));
+        }
+        return nullptr;
+    }
+};
+
+// Typed host function backed by `fn`, owned by the caller. Null if it could not be created
+template<typename Signature, typename F>
+wasm_func_t* create_host_func(wasm_store_t* store, const std::string_view name, F&& fn) {
+    using Callable = std::decay_t<F>;
+    wasm_functype_t* type = HostFn<Signature>::functype();
+    auto* env = new Callable(std::forward<F>(fn));
+    auto* func = wasm_func_new_with_env(store, type, &HostFn<Signature>::template invoke<Callable>, env,
+        [](void* env) { delete static_cast<Callable*>(env); });
+    wasm_functype_delete(type);
+    if (!func) {
+        // The finalizer only runs for a function that was created
+        delete env;
+        std::println(R"(ERROR: Failed to create "{}" function)", name);
+        print_wasmer_error();
+    }
+    return func;
+}
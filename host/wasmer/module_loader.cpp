@@ -0,0 +1,61 @@
+#include "module_loader.hpp"
+
+#include <print>
+
+#include "mapped_file.hpp"
+#include "wasmer_errors.hpp"
+
+// The engine only reads through the vector, so it may point into read-only mapped pages
+static byte_t* to_byte_ptr(const std::span<const uint8_t> bytes) {
+    return reinterpret_cast<byte_t*>(const_cast<uint8_t*>(bytes.data()));
+}
+
+wasm_module_t* load_plugin_module(wasm_store_t* store, const std::filesystem::path& plugin_path, std::span<const uint8_t> wasm_binary, const ModuleCache* cache) {
+    std::optional<std::vector<uint8_t>> wasm_file;
+    if (wasm_binary.empty()) {
+        wasm_file = read_file_bytes(plugin_path);
+        if (!wasm_file) {
+            std::println("ERROR: Failed to read plugin file \"{}\"", plugin_path.string());
+            return nullptr;
+        }
+        wasm_binary = *wasm_file;
+    }
+
+    std::filesystem::path cache_entry;
+    if (cache) {
+        cache_entry = module_cache_entry_path(*cache, wasm_binary);
+        // The wasmer C API has no file based deserialize, so hand it the mapped artifact instead of a copy
+        if (const auto artifact = MappedFile::open(cache_entry)) {
+            const wasm_byte_vec_t artifact_bytes { artifact->bytes().size(), to_byte_ptr(artifact->bytes()) };
+            if (const auto module = wasm_module_deserialize(store, &artifact_bytes)) {
+                std::println("Loaded precompiled module \"{}\"", cache_entry.string());
+                return module;
+            }
+            // Artifacts from an incompatible engine build are rejected here, recompile and overwrite them
+            std::println("Discarding stale module cache entry \"{}\"", cache_entry.string());
+            print_wasmer_error();
+        }
+    }
+
+    const wasm_byte_vec_t wasm_bytes { wasm_binary.size(), to_byte_ptr(wasm_binary) };
+    const auto module = wasm_module_new(store, &wasm_bytes);
+    if (!module) {
+        std::println("ERROR: Failed to compile WASM module \"{}\"", plugin_path.string());
+        print_wasmer_error();
+        return nullptr;
+    }
+
+    if (cache) {
+        wasm_byte_vec_t artifact;
+        wasm_module_serialize(module, &artifact);
+        if (artifact.size > 0) {
+            write_module_cache_entry(cache_entry, { reinterpret_cast<const uint8_t*>(artifact.data), artifact.size });
+        }
+        else {
+            std::println("ERROR: Failed to serialize module for the cache");
+            print_wasmer_error();
+        }
+        wasm_byte_vec_delete(&artifact);
+    }
+    return module;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+
+#include <wasmer.h>
+
+#include "module_cache.hpp"
+
+// Compiles the plugin at `plugin_path`, or loads its precompiled artifact when `cache` holds a matching one.
+// Non-empty `wasm_binary` is compiled instead of reading the file, `plugin_path` then only names the plugin
+wasm_module_t* load_plugin_module(wasm_store_t* store, const std::filesystem::path& plugin_path, std::span<const uint8_t> wasm_binary, const ModuleCache* cache);
@@ -0,0 +1,222 @@
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <print>
+#include <span>
+#include <vector>
+
+#include <wasmer.h>
+
+#include "engine_config.hpp"
+#include "export_table.hpp"
+#include "mapped_file.hpp"
+#include "module_loader.hpp"
+#include "plugin_host.hpp"
+#include "tiered_code.hpp"
+#include "wasmer_errors.hpp"
+#include "wasmer_session.hpp"
+
+// Operators compiled code runs per millisecond, roughly. Only used to turn call timeouts into metering budgets
+constexpr uint64_t metering_points_per_ms = 1'000'000;
+
+// An engine with the code generation settings of one tier
+struct TierEngine {
+    wasm_engine_t* engine = nullptr;
+    EngineOptions options;
+    CompileTier tier = CompileTier::Optimized;
+};
+
+class WasmerPluginHost final : public PluginHost {
+public:
+    WasmerPluginHost(const PluginHostOptions& options, const uint64_t call_budget)
+        : plugin_path(options.plugin_path), cache_dir(options.cache_dir), wasi_options(options.wasi), host_imports(options.host_imports),
+          upgrade_tier(options.upgrade_tier), result_cache_options(options.result_cache), call_budget(call_budget) {
+        call_metrics = options.metrics;
+    }
+    WasmerPluginHost(const WasmerPluginHost&) = delete;
+    WasmerPluginHost& operator=(const WasmerPluginHost&) = delete;
+
+    // Starts out on `baseline` if given and recompiles for `optimized` in the background, unless optimized code
+    // is already in the cache. Both engines must outlive the host
+    bool load(const std::span<const uint8_t> wasm_binary, const TierEngine* baseline, const TierEngine& optimized) {
+        const TierEngine& first = baseline && !is_cached(optimized, wasm_binary) ? *baseline : optimized;
+        TierStats stats;
+        auto compiled = compile(first, wasm_binary, stats);
+        if (!compiled) {
+            return false;
+        }
+        // Tiers compile the same module, so export indices stay valid across upgrades
+        wasm_exporttype_vec_t export_types;
+        wasm_module_exports(compiled->module, &export_types);
+        exports = read_export_table(export_types);
+        wasm_exporttype_vec_delete(&export_types);
+        pure_results = create_result_cache(wasm_binary, result_cache_options);
+        code.publish(std::move(compiled), stats);
+
+        if (&first != &optimized && upgrade_tier) {
+            // The caller's bytes are only valid during load(), the background compile gets a copy
+            code.compile_in_background([this, &optimized, wasm = std::vector<uint8_t>(wasm_binary.begin(), wasm_binary.end())] {
+                TierStats stats;
+                if (auto compiled = compile(optimized, wasm, stats)) {
+                    code.publish(std::move(compiled), stats);
+                    std::println("Plugin \"{}\" switched to optimized code", plugin_path.string());
+                }
+            });
+        }
+        return true;
+    }
+
+    std::optional<uint32_t> find_function(const std::string_view name, const FunctionSignature& signature) const override {
+        return exports.find_function(name, signature);
+    }
+
+    std::unique_ptr<PluginSession> instantiate() override {
+        return instantiate_session(code.current(), exports, wasi_options, host_imports, call_metrics.get(), call_budget);
+    }
+
+    CompileTier current_tier() const override { return code.tier(); }
+    std::vector<TierStats> tier_stats() const override { return code.stats(); }
+    void wait_for_final_tier() override { code.wait(); }
+
+private:
+    std::optional<ModuleCache> module_cache(const TierEngine& target) const {
+        if (cache_dir.empty()) {
+            return std::nullopt;
+        }
+        return ModuleCache { cache_dir, engine_fingerprint(target.options) };
+    }
+
+    bool is_cached(const TierEngine& target, const std::span<const uint8_t> wasm_binary) const {
+        const auto cache = module_cache(target);
+        return cache && std::filesystem::exists(module_cache_entry_path(*cache, wasm_binary));
+    }
+
+    std::shared_ptr<const CompiledPlugin> compile(const TierEngine& target, const std::span<const uint8_t> wasm_binary, TierStats& stats) const {
+        const auto start = std::chrono::steady_clock::now();
+        const auto cache = module_cache(target);
+        stats.tier = target.tier;
+        stats.from_cache = is_cached(target, wasm_binary);
+
+        // Only used to compile the module, every instance gets a store of its own
+        auto store = wasm_store_new(target.engine);
+        if (!store) {
+            std::println("ERROR: Failed to create WASM store");
+            print_wasmer_error();
+            return nullptr;
+        }
+        auto compiled = std::make_shared<CompiledPlugin>();
+        compiled->engine = target.engine;
+        compiled->tier = target.tier;
+        compiled->module = load_plugin_module(store, plugin_path, wasm_binary, cache ? &*cache : nullptr);
+        wasm_store_delete(store);
+        if (!compiled->module) {
+            return nullptr;
+        }
+        stats.compile_time = std::chrono::steady_clock::now() - start;
+        return compiled;
+    }
+
+    std::filesystem::path plugin_path;
+    std::filesystem::path cache_dir;
+    WasiOptions wasi_options;
+    HostImports host_imports;
+    bool upgrade_tier = true;
+    ResultCacheOptions result_cache_options;
+    uint64_t call_budget = 0;
+    ExportTable exports;
+    // Last, so a background compile is joined before the members it uses go away
+    TieredCode<CompiledPlugin> code;
+};
+
+class WasmerPluginEngine final : public PluginEngine {
+public:
+    WasmerPluginEngine(const EngineOptions& options, const bool tiered) {
+        optimized = { create_engine(options), options, CompileTier::Optimized };
+        if (tiered) {
+            EngineOptions baseline_options = options;
+            baseline_options.compiler = SINGLEPASS;
+            baseline = TierEngine { create_engine(baseline_options), baseline_options, CompileTier::Baseline };
+        }
+    }
+    WasmerPluginEngine(const WasmerPluginEngine&) = delete;
+    WasmerPluginEngine& operator=(const WasmerPluginEngine&) = delete;
+
+    ~WasmerPluginEngine() override {
+        for (const TierEngine* tier : { &optimized, baseline ? &*baseline : nullptr }) {
+            if (tier && tier->engine) {
+                wasm_engine_delete(tier->engine);
+            }
+        }
+    }
+
+    bool is_valid() const { return optimized.engine && (!baseline || baseline->engine); }
+
+    std::string_view name() const override { return "wasmer"; }
+    std::string_view version() const override { return WASMER_VERSION; }
+
+    std::unique_ptr<PluginHost> load(const PluginHostOptions& options) override {
+        if (options.host_imports.host_fn_async) {
+            std::println("ERROR: Plugin \"{}\" has async host imports, which need an async engine", options.plugin_path.string());
+            return nullptr;
+        }
+        if (!options.guest_profile.empty()) {
+            std::println("ERROR: Plugin \"{}\" is profiled, but the wasmer C API has no guest profiler", options.plugin_path.string());
+            return nullptr;
+        }
+        uint64_t call_budget = 0;
+        if (options.call_timeout.count() > 0) {
+            if (!optimized.options.metering) {
+                std::println("ERROR: Plugin \"{}\" has a call timeout, but the engine is not interruptible", options.plugin_path.string());
+                return nullptr;
+            }
+            call_budget = static_cast<uint64_t>(options.call_timeout.count()) * metering_points_per_ms;
+        }
+        // Read up front, the cache lookup of the optimized tier needs the bytes before anything is compiled
+        std::optional<std::vector<uint8_t>> wasm_file;
+        auto wasm_binary = options.plugin_bytes;
+        if (wasm_binary.empty()) {
+            wasm_file = read_file_bytes(options.plugin_path);
+            if (!wasm_file) {
+                std::println("ERROR: Failed to read plugin file \"{}\"", options.plugin_path.string());
+                return nullptr;
+            }
+            wasm_binary = *wasm_file;
+        }
+        auto host = std::make_unique<WasmerPluginHost>(options, call_budget);
+        if (!host->load(wasm_binary, baseline ? &*baseline : nullptr, optimized)) {
+            return nullptr;
+        }
+        return host;
+    }
+
+private:
+    TierEngine optimized;
+    std::optional<TierEngine> baseline;
+};
+
+// Wasmer allocates instance memory on demand, so EngineSettings::max_instances needs no counterpart here.
+// Metering counts operators rather than time, so call budgets are converted at a rough operator rate
+PLUGIN_ENGINE_EXPORT PluginEngine* create_plugin_engine(const uint32_t abi_version, const EngineSettings& settings) {
+    if (abi_version != plugin_engine_abi_version) {
+        std::println("ERROR: Host expects plugin engine ABI {}, wasmer module implements {}", abi_version, plugin_engine_abi_version);
+        return nullptr;
+    }
+    if (settings.async_calls) {
+        std::println("ERROR: The wasmer C API has no async calls, create the engine without async_calls");
+        return nullptr;
+    }
+    if (settings.jit_profiler != JitProfiler::None) {
+        std::println("ERROR: The wasmer C API cannot announce compiled code to profilers, create the engine without jit_profiler");
+        return nullptr;
+    }
+    EngineOptions options;
+    options.metering = settings.interruptible;
+    auto engine = std::make_unique<WasmerPluginEngine>(options, settings.tiered);
+    if (!engine->is_valid()) {
+        std::println("ERROR: Failed to create wasmer engine");
+        print_wasmer_error();
+        return nullptr;
+    }
+    return engine.release();
+}
@@ -0,0 +1,30 @@
+#include "wasmer_errors.hpp"
+
+#include <print>
+#include <string>
+
+void print_wasmer_error() {
+    const int error_len = wasmer_last_error_length();
+    if (error_len > 0) {
+        std::string error_str(error_len, '\0');
+        wasmer_last_error_message(error_str.data(), error_len);
+        std::println("wasmer error: {}", error_str.c_str());
+    }
+}
+
+void print_wasm_trap(const wasm_trap_t& trap) {
+    wasm_message_t message;
+    wasm_trap_message(&trap, &message);
+    std::println("wasm trap: {}", std::string { message.data, message.size });
+    wasm_byte_vec_delete(&message);
+}
+
+bool check_wasmer_call(std::string_view fn_name, wasm_trap_t* trap) {
+    if (trap) {
+        std::println("ERROR: Failed to call plugin function {}", fn_name);
+        print_wasm_trap(*trap);
+        wasm_trap_delete(trap);
+        return true;
+    }
+    return false;
+}
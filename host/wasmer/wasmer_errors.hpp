@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string_view>
+
+#include <wasmer.h>
+
+// Use the last_error API to retrieve error messages
+void print_wasmer_error();
+
+void print_wasm_trap(const wasm_trap_t& trap);
+
+// Reports and releases the trap returned by a wasm call. Returns true if the call failed
+bool check_wasmer_call(std::string_view fn_name, wasm_trap_t* trap);
@@ -0,0 +1,318 @@
+#include "wasmer_session.hpp"
+
+#include <cstring>
+#include <format>
+#include <print>
+#include <string>
+#include <unordered_map>
+
+#include "host_files.hpp"
+#include "host_funcs.hpp"
+#include "plugin_metrics.hpp"
+#include "wasm_types.hpp"
+#include "wasmer_errors.hpp"
+
+CompiledPlugin::~CompiledPlugin() {
+    if (module) {
+        wasm_module_delete(module);
+    }
+}
+
+WasmerSession::~WasmerSession() {
+    wasm_extern_vec_delete(&instance_exports);
+    if (instance) {
+        wasm_instance_delete(instance);
+    }
+    for (auto created_import : created_imports) {
+        wasm_extern_delete(created_import);
+    }
+    if (host_func) {
+        wasm_func_delete(host_func);
+    }
+    wasmer_named_extern_vec_delete(&wasi_imports);
+    if (wasi_env) {
+        wasi_env_delete(wasi_env);
+    }
+    if (store) {
+        wasm_store_delete(store);
+    }
+    if (output) {
+        output->close();
+    }
+}
+
+void WasmerSession::collect_output() {
+    if (!piped_output) {
+        return;
+    }
+    // Pipes without an `output` are still drained, they would otherwise grow with everything the guest prints
+    char buffer[4096];
+    intptr_t size;
+    while ((size = wasi_env_read_stdout(wasi_env, buffer, sizeof(buffer))) > 0) {
+        if (output) {
+            output->write(OutputStream::Stdout, { buffer, static_cast<size_t>(size) });
+        }
+    }
+    while ((size = wasi_env_read_stderr(wasi_env, buffer, sizeof(buffer))) > 0) {
+        if (output) {
+            output->write(OutputStream::Stderr, { buffer, static_cast<size_t>(size) });
+        }
+    }
+}
+
+bool WasmerSession::call(const uint32_t index, const std::span<PluginValue> slots) {
+    const auto& function = *exports->functions[index];
+    wasm_val_t param_values[max_call_slots];
+    wasm_val_t result_values[max_call_slots];
+    for (size_t i = 0; i < function.signature.params.size(); i++) {
+        param_values[i].kind = to_wasm_valkind(function.signature.params[i]);
+        std::memcpy(&param_values[i].of, &slots[i], sizeof(PluginValue));
+    }
+    const wasm_val_vec_t params { function.signature.params.size(), param_values };
+    wasm_val_vec_t results { function.signature.results.size(), result_values };
+    if (call_budget) {
+        wasmer_metering_set_remaining_points(instance, call_budget);
+    }
+    wasm_trap_t* trap = wasm_func_call(functions[index], &params, &results);
+    // Also keeps what the guest printed before it trapped
+    collect_output();
+    if (trap && call_budget && wasmer_metering_points_are_exhausted(instance)) {
+        std::println("ERROR: Plugin function {} ran out of its time budget", function.name);
+    }
+    if (check_wasmer_call(function.name, trap)) {
+        poisoned = true;
+        return false;
+    }
+    for (size_t i = 0; i < function.signature.results.size(); i++) {
+        std::memcpy(&slots[i], &result_values[i].of, sizeof(PluginValue));
+    }
+    return true;
+}
+
+GuestMemoryView WasmerSession::memory_view() {
+    if (!memory) {
+        return GuestMemoryView({});
+    }
+    return GuestMemoryView({ reinterpret_cast<uint8_t*>(wasm_memory_data(memory)), wasm_memory_data_size(memory) });
+}
+
+using ImportsMap = std::unordered_map<std::string, wasm_extern_t*>;
+
+// Defines `func` as "env".`name` in `imports_map`. The session deletes it with its other imports, before its store
+static bool add_env_import(WasmerSession& session, ImportsMap& imports_map, const std::string_view name, wasm_func_t* func) {
+    if (!func) {
+        return false;
+    }
+    session.created_imports.push_back(wasm_func_as_extern(func));
+    imports_map[std::format(R"("env"."{}")", name)] = session.created_imports.back();
+    return true;
+}
+
+// Defines the whole-file imports in `imports_map`, reading and writing the memory of `session`
+static bool create_file_imports(WasmerSession& session, const std::shared_ptr<HostFiles>& files, PluginMetrics* metrics, ImportsMap& imports_map) {
+    const auto path = [](const int32_t address, const int32_t length) { return GuestString { { static_cast<uint32_t>(address), static_cast<uint32_t>(length) } }; };
+    const auto span = [](const int32_t address, const int32_t length) { return GuestSpan { static_cast<uint32_t>(address), static_cast<uint32_t>(length) }; };
+    const auto add = [&](const std::string_view name, wasm_func_t* func) { return add_env_import(session, imports_map, name, func); };
+    return add("file_size", create_host_func<int64_t(int32_t, int32_t)>(session.store, "file_size",
+               [&session, files, path, metrics = import_metrics_handle(metrics, "env.file_size")](const int32_t path_address, const int32_t path_length) {
+                   return record_import_call(metrics, [&] { return files->file_size(session.memory_view(), path(path_address, path_length)); });
+               }))
+        && add("read_file", create_host_func<int64_t(int32_t, int32_t, int32_t, int32_t)>(session.store, "read_file",
+            [&session, files, path, span, metrics = import_metrics_handle(metrics, "env.read_file")](const int32_t path_address, const int32_t path_length, const int32_t buffer, const int32_t capacity) {
+                return record_import_call(metrics, [&] { return files->read_file(session.memory_view(), path(path_address, path_length), span(buffer, capacity)); });
+            }))
+        && add("read_file_at", create_host_func<int64_t(int32_t, int32_t, int64_t, int32_t, int32_t)>(session.store, "read_file_at",
+            [&session, files, path, span, metrics = import_metrics_handle(metrics, "env.read_file_at")](const int32_t path_address, const int32_t path_length, const int64_t offset, const int32_t buffer, const int32_t length) {
+                return record_import_call(metrics, [&] { return files->read_file_at(session.memory_view(), path(path_address, path_length), offset, span(buffer, length)); });
+            }))
+        && add("write_file", create_host_func<int32_t(int32_t, int32_t, int32_t, int32_t)>(session.store, "write_file",
+            [&session, files, path, span, metrics = import_metrics_handle(metrics, "env.write_file")](const int32_t path_address, const int32_t path_length, const int32_t data, const int32_t length) {
+                return record_import_call(metrics, [&] { return files->write_file(session.memory_view(), path(path_address, path_length), span(data, length)); });
+            }));
+}
+
+// Environment of the "env"."host_fn" import, owned by its function
+struct HostFnEnv {
+    int32_t (*fn)();
+    [[no_unique_address]] CallMetricsHandle metrics;
+};
+
+std::unique_ptr<WasmerSession> instantiate_session(std::shared_ptr<const CompiledPlugin> code, const ExportTable& exports, const WasiOptions& wasi_options, const HostImports& host_imports, PluginMetrics* metrics, const uint64_t call_budget) {
+    auto plugin = std::make_unique<WasmerSession>(std::move(code));
+    const wasm_module_t* module = plugin->code->module;
+    plugin->call_budget = call_budget;
+    plugin->store = wasm_store_new(plugin->code->engine);
+    if (!plugin->store) {
+        std::println("ERROR: Failed to create WASM store");
+        print_wasmer_error();
+        return nullptr;
+    }
+
+    {
+        auto config = wasi_config_new("");
+        if (wasi_options.capture) {
+            plugin->capture = wasi_options.capture;
+            plugin->output = plugin->capture->open_instance();
+        }
+        // Output that is neither captured nor inherited is piped too, and discarded after every call
+        plugin->piped_output = wasi_options.capture || !wasi_options.inherit_stdio;
+        if (plugin->piped_output) {
+            wasi_config_capture_stdout(config);
+            wasi_config_capture_stderr(config);
+        }
+        std::filesystem::create_directories(wasi_options.data_dir);
+        wasi_config_mapdir(config, ".", std::filesystem::absolute(wasi_options.data_dir).string().c_str());
+        plugin->wasi_env = wasi_env_new(plugin->store, config);
+        if (!plugin->wasi_env) {
+            std::println("ERROR: Failed to create WASI env");
+            print_wasmer_error();
+            return nullptr;
+        }
+    }
+
+    // Imports left unset are simply not provided, plugins that need them fail to instantiate
+    if (host_imports.host_fn) {
+        auto host_func_type = wasm_functype_new_0_1(wasm_valtype_new_i32()); // 0 parameters, 1 return value (i32)
+        if (!host_func_type) {
+            std::println("ERROR: Failed to create \"host_func\" function type");
+            print_wasmer_error();
+            return nullptr;
+        }
+        auto* host_fn_env = new HostFnEnv { host_imports.host_fn, import_metrics_handle(metrics, "env.host_fn") };
+        plugin->host_func = wasm_func_new_with_env(plugin->store, host_func_type, [](void* env, const wasm_val_vec_t* args, wasm_val_vec_t* results) -> wasm_trap_t* {
+            const auto& host_fn = *static_cast<const HostFnEnv*>(env);
+            wasm_val_t value = WASM_I32_VAL(record_import_call(host_fn.metrics, host_fn.fn));
+            wasm_val_copy(&results->data[0], &value);
+            return nullptr;
+        }, host_fn_env, [](void* env) { delete static_cast<HostFnEnv*>(env); });
+        wasm_functype_delete(host_func_type);
+        if (!plugin->host_func) {
+            delete host_fn_env;
+            std::println("ERROR: Failed to create \"host_func\" function");
+            print_wasmer_error();
+            return nullptr;
+        }
+    }
+
+    ImportsMap imports_map;
+    if (!wasi_get_unordered_imports(plugin->wasi_env, module, &plugin->wasi_imports)) {
+        std::println("ERROR: Failed to get WASI imports");
+        print_wasmer_error();
+        return nullptr;
+    }
+    for (size_t i = 0; i < plugin->wasi_imports.size; i++) {
+        auto named_extern = plugin->wasi_imports.data[i];
+        auto module_name = wasmer_named_extern_module(named_extern);
+        auto import_name = wasmer_named_extern_name(named_extern);
+        const auto import_key = std::format(R"("{}"."{}")", std::string_view { module_name->data, module_name->size }, std::string_view { import_name->data, import_name->size });
+        if (imports_map.contains(import_key)) {
+            std::println("ERROR: WASM module contains duplicate import \"{}\"", import_key);
+            return nullptr;
+        }
+        imports_map[import_key] = const_cast<wasm_extern_t*>(wasmer_named_extern_unwrap(named_extern));
+    }
+    if (plugin->host_func) {
+        imports_map[R"("env"."host_fn")"] = wasm_func_as_extern(plugin->host_func);
+    }
+    if (host_imports.files && !create_file_imports(*plugin, host_imports.files, metrics, imports_map)) {
+        return nullptr;
+    }
+    for (const auto& batch_fn : host_imports.batch_fns) {
+        auto* func = create_host_func<int32_t(int32_t, int32_t, int32_t)>(plugin->store, batch_fn.name,
+            [&session = *plugin, batch_fn, metrics = import_metrics_handle(metrics, std::format("env.{}", batch_fn.name))](const int32_t requests, const int32_t count, const int32_t results) {
+                return record_import_call(metrics, [&] { return batch_fn.call(session.memory_view(), requests, count, results); });
+            });
+        if (!add_env_import(*plugin, imports_map, batch_fn.name, func)) {
+            return nullptr;
+        }
+    }
+
+    wasm_importtype_vec_t module_import_types;
+    wasm_module_imports(module, &module_import_types);
+    std::vector<wasm_extern_t*> imports(module_import_types.size, nullptr);
+    bool imports_resolved = true;
+    for (size_t i = 0; i < module_import_types.size && imports_resolved; i++) {
+        auto module_name = wasm_importtype_module(module_import_types.data[i]);
+        auto name = wasm_importtype_name(module_import_types.data[i]);
+        const auto import_key = std::format(R"("{}"."{}")", std::string_view { module_name->data, module_name->size }, std::string_view { name->data, name->size });
+        auto extern_type = wasm_importtype_type(module_import_types.data[i]);
+
+        switch (wasm_externtype_kind(extern_type)) {
+            case WASM_EXTERN_FUNC: {
+                if (const auto itr = imports_map.find(import_key); itr != imports_map.end()) {
+                    imports[i] = itr->second;
+                }
+                else {
+                    std::println("ERROR: Module import {} not found", import_key);
+                    imports_resolved = false;
+                }
+                break;
+            }
+            case WASM_EXTERN_GLOBAL: {
+                auto global_type = wasm_externtype_as_globaltype_const(extern_type);
+                wasm_val_t val = WASM_I32_VAL(0);
+                imports[i] = wasm_global_as_extern(wasm_global_new(plugin->store, global_type, &val));
+                plugin->created_imports.push_back(imports[i]);
+                break;
+            }
+            case WASM_EXTERN_MEMORY: {
+                auto memory_type = wasm_externtype_as_memorytype_const(extern_type);
+                imports[i] = wasm_memory_as_extern(wasm_memory_new(plugin->store, memory_type));
+                plugin->created_imports.push_back(imports[i]);
+                break;
+            }
+            default: {
+                std::println("ERROR: Module import {} has an unsupported kind", import_key);
+                imports_resolved = false;
+                break;
+            }
+        }
+    }
+    wasm_importtype_vec_delete(&module_import_types);
+    if (!imports_resolved) {
+        return nullptr;
+    }
+
+    // The store keeps ownership of every import, so hand the instance a borrowed view of them
+    const wasm_extern_vec_t import_vec { imports.size(), imports.data() };
+    plugin->instance = wasm_instance_new(plugin->store, module, &import_vec, nullptr);
+    if (!plugin->instance) {
+        std::println("ERROR: Failed to create instance");
+        print_wasmer_error();
+        return nullptr;
+    }
+    if (!wasi_env_initialize_instance(plugin->wasi_env, plugin->store, plugin->instance)) {
+        std::println("ERROR: Failed to initialize WASI environment");
+        print_wasmer_error();
+        return nullptr;
+    }
+    // Start functions may have printed already
+    plugin->collect_output();
+
+    wasm_instance_exports(plugin->instance, &plugin->instance_exports);
+    if (plugin->instance_exports.size != exports.functions.size()) {
+        std::println("ERROR: Module and instance have different number of exports");
+        return nullptr;
+    }
+    plugin->exports = &exports;
+    plugin->functions.resize(exports.functions.size(), nullptr);
+    for (size_t i = 0; i < exports.functions.size(); i++) {
+        if (exports.functions[i]) {
+            plugin->functions[i] = wasm_extern_as_func(plugin->instance_exports.data[i]);
+        }
+    }
+    if (exports.memory_index) {
+        plugin->memory = wasm_extern_as_memory(plugin->instance_exports.data[*exports.memory_index]);
+    }
+
+    // WASI reactors must run their initializer before any other export is called
+    if (const auto initialize = exports.find_function("_initialize", signature_of<void>())) {
+        wasm_val_vec_t no_values = WASM_EMPTY_VEC;
+        wasm_trap_t* trap = wasm_func_call(plugin->functions[*initialize], &no_values, &no_values);
+        plugin->collect_output();
+        if (check_wasmer_call("_initialize", trap)) {
+            return nullptr;
+        }
+    }
+    return plugin;
+}
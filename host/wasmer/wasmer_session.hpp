@@ -0,0 +1,62 @@
+#pragma once
+
+#include <memory>
+#include <span>
+#include <vector>
+
+#include <wasmer.h>
+
+#include "export_table.hpp"
+#include "host_imports.hpp"
+#include "output_capture.hpp"
+#include "plugin_host.hpp"
+
+// A plugin compiled on one engine, shared by every session instantiated from it
+struct CompiledPlugin {
+    wasm_engine_t* engine = nullptr;
+    wasm_module_t* module = nullptr;
+    CompileTier tier = CompileTier::Optimized;
+
+    CompiledPlugin() = default;
+    CompiledPlugin(const CompiledPlugin&) = delete;
+    CompiledPlugin& operator=(const CompiledPlugin&) = delete;
+    ~CompiledPlugin();
+};
+
+// One instantiated plugin in its own store and WASI environment, isolated from every other instance
+struct WasmerSession final : PluginSession {
+    // Keeps the code alive after the host moved on to a higher tier
+    std::shared_ptr<const CompiledPlugin> code;
+    wasm_store_t* store = nullptr;
+    wasi_env_t* wasi_env = nullptr;
+    wasmer_named_extern_vec_t wasi_imports {};
+    wasm_func_t* host_func = nullptr;
+    std::vector<wasm_extern_t*> created_imports;
+    wasm_instance_t* instance = nullptr;
+    wasm_extern_vec_t instance_exports {};
+    const ExportTable* exports = nullptr;
+    // Indexed like `exports`, entries of non-function exports are null
+    std::vector<const wasm_func_t*> functions;
+    wasm_memory_t* memory = nullptr;
+    // Metering points every call may use, 0 for no limit
+    uint64_t call_budget = 0;
+    // Buffer of the guest's stdout and stderr when the host captures them. Wasmer keeps WASI output in pipes of
+    // its own, which are moved into the buffer after every call
+    bool piped_output = false;
+    std::shared_ptr<OutputCapture> capture;
+    std::shared_ptr<InstanceOutput> output;
+
+    explicit WasmerSession(std::shared_ptr<const CompiledPlugin> code) : code(std::move(code)) { tier = this->code->tier; }
+    WasmerSession(const WasmerSession&) = delete;
+    WasmerSession& operator=(const WasmerSession&) = delete;
+    ~WasmerSession() override;
+
+    bool call(uint32_t index, std::span<PluginValue> slots) override;
+    GuestMemoryView memory_view() override;
+
+    // Moves what the guest wrote to its piped stdout and stderr into `output`, or discards it without one
+    void collect_output();
+};
+
+// Creates a store for `module`, gathers WASI and host imports into it and instantiates the plugin
+std::unique_ptr<WasmerSession> instantiate_session(std::shared_ptr<const CompiledPlugin> code, const ExportTable& exports, const WasiOptions& wasi_options, const HostImports& host_imports, PluginMetrics* metrics, uint64_t call_budget);
@@ -0,0 +1,31 @@
+#include "engine_config.hpp"
+
+#include <format>
+
+wasm_engine_t* create_engine(const EngineOptions& options) {
+    wasm_config_t* config = wasm_config_new();
+    if (!config) {
+        return nullptr;
+    }
+    wasmtime_config_strategy_set(config, options.strategy);
+    wasmtime_config_cranelift_opt_level_set(config, options.opt_level);
+    wasmtime_config_epoch_interruption_set(config, options.epoch_interruption);
+    wasmtime_config_async_support_set(config, options.async_support);
+    wasmtime_config_profiler_set(config, options.profiler);
+    if (options.pooled_instances > 0) {
+        wasmtime_pooling_allocation_config_t* pooling = wasmtime_pooling_allocation_config_new();
+        wasmtime_pooling_allocation_config_total_core_instances_set(pooling, options.pooled_instances);
+        wasmtime_pooling_allocation_config_total_memories_set(pooling, options.pooled_instances);
+        wasmtime_pooling_allocation_config_total_tables_set(pooling, options.pooled_instances);
+        wasmtime_pooling_allocation_config_max_memory_size_set(pooling, options.pooled_max_memory_size);
+        wasmtime_pooling_allocation_strategy_set(config, pooling);
+        wasmtime_pooling_allocation_config_delete(pooling);
+    }
+    return wasm_engine_new_with_config(config);
+}
+
+std::string engine_fingerprint(const EngineOptions& options) {
+    // The pooling allocator's memory limits change the bounds checks compiled into the code
+    const size_t pooled_max_memory_size = options.pooled_instances > 0 ? options.pooled_max_memory_size : 0;
+    return std::format("wasmtime-{};strategy={};opt_level={};epoch_interruption={};async={};pooling={};pooled_max_memory_size={}", WASMTIME_VERSION, options.strategy, options.opt_level, options.epoch_interruption, options.async_support, options.pooled_instances > 0, pooled_max_memory_size);
+}
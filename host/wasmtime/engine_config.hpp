@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+
+#include <wasmtime.h>
+
+// Engine-wide settings. Everything here that affects generated code must be part of engine_fingerprint()
+struct EngineOptions {
+    // Cranelift optimizes, Winch is a single-pass baseline compiler that compiles several times faster
+    wasmtime_strategy_t strategy = WASMTIME_STRATEGY_CRANELIFT;
+    wasmtime_opt_level_t opt_level = WASMTIME_OPT_LEVEL_SPEED;
+    // Reserve memory slots for this many concurrent instances up front so instantiating is a slot checkout.
+    // 0 keeps the on-demand allocator
+    uint32_t pooled_instances = 0;
+    size_t pooled_max_memory_size = 64 << 20;
+    // Emit epoch checks so stores can be given deadlines. The engine's epoch must then be advanced periodically
+    bool epoch_interruption = false;
+    // Run wasm on separate stacks so calls can be polled and host functions can suspend. Stores of such an
+    // engine only accept the async call and instantiation APIs
+    bool async_support = false;
+    // Announces compiled code to perf, the generated code itself does not change
+    wasmtime_profiling_strategy_t profiler = WASMTIME_PROFILING_STRATEGY_NONE;
+};
+
+wasm_engine_t* create_engine(const EngineOptions& options);
+
+// Identifies the engine version and code generation settings, used to key precompiled modules
+std::string engine_fingerprint(const EngineOptions& options);
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <print>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <wasmtime.h>
+
+#include "wasm_types.hpp"
+#include "wasmtime_errors.hpp"
+#include "wasmtime_values.hpp"
+
+template<typename Signature>
+struct HostFn;
+
+// Trampoline between wasmtime's unchecked host call convention and a typed C++ callable. The linker checks the
+// import's type against the declared signature at link time, so the raw slots can be read without checks
+template<typename R, typename... Args>
+struct HostFn<R(Args...)> {
+    static wasm_functype_t* functype() { return make_functype<R, Args...>(); }
+
+    template<typename F>
+    static wasm_trap_t* invoke(void* env, wasmtime_caller_t* caller, wasmtime_val_raw_t* slots, size_t) {
+        auto& fn = *static_cast<F*>(env);
+        return invoke_with(fn, caller, slots, std::index_sequence_for<Args...> {});
+    }
+
+private:
+    template<typename F, size_t... I>
+    static wasm_trap_t* invoke_with(F& fn, wasmtime_caller_t* caller, wasmtime_val_raw_t* slots, std::index_sequence<I...>) {
+        const std::tuple<Args...> args { load_raw<Args>(slots[I])... };
+        const auto call = [&] {
+            // Callables that need the calling instance, e.g. to reach its memory, take the caller first
+            if constexpr (std::is_invocable_v<F&, wasmtime_caller_t*, Args...>) {
+                return fn(caller, std::get<I>(args)...);
+            }
+            else {
+                return fn(std::get<I>(args)...);
+            }
+        };
+        if constexpr (std::is_void_v<R>) {
+            call();
+        }
+        else {
+            store_raw<R>(slots[0], call());
+        }
+        return nullptr;
+    }
+};
+
+// Defines `module.name` in the linker as a typed host function backed by `fn`, called through the unchecked path
+template<typename Signature, typename F>
+bool define_host_func(wasmtime_linker_t* linker, const std::string_view module, const std::string_view name, F&& fn) {
+    using Callable = std::decay_t<F>;
+    wasm_functype_t* type = HostFn<Signature>::functype();
+    auto* env = new Callable(std::forward<F>(fn));
+    auto error = wasmtime_linker_define_func_unchecked(linker, module.data(), module.size(), name.data(), name.size(), type,
+        &HostFn<Signature>::template invoke<Callable>, env, [](void* env) { delete static_cast<Callable*>(env); });
+    wasm_functype_delete(type);
+    if (error) {
+        std::println(R"(ERROR: Failed to define "{}"."{}" in the linker)", module, name);
+        print_wasmtime_error(*error);
+        wasmtime_error_delete(error);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,59 @@
+#include "module_loader.hpp"
+
+#include <print>
+
+#include "mapped_file.hpp"
+#include "wasmtime_errors.hpp"
+
+wasmtime_module_t* load_plugin_module(wasm_engine_t* engine, const std::filesystem::path& plugin_path, std::span<const uint8_t> wasm_binary, const ModuleCache* cache) {
+    std::optional<std::vector<uint8_t>> wasm_file;
+    if (wasm_binary.empty()) {
+        wasm_file = read_file_bytes(plugin_path);
+        if (!wasm_file) {
+            std::println("ERROR: Failed to read plugin file \"{}\"", plugin_path.string());
+            return nullptr;
+        }
+        wasm_binary = *wasm_file;
+    }
+
+    wasmtime_module_t* module = nullptr;
+    std::filesystem::path cache_entry;
+    if (cache) {
+        cache_entry = module_cache_entry_path(*cache, wasm_binary);
+        if (std::filesystem::exists(cache_entry)) {
+            // Deserializing from the file lets wasmtime map the native code directly, sharing it between processes
+            if (const auto error = wasmtime_module_deserialize_file(engine, cache_entry.string().c_str(), &module)) {
+                // Artifacts from an incompatible engine build are rejected here, recompile and overwrite them
+                std::println("Discarding stale module cache entry \"{}\"", cache_entry.string());
+                print_wasmtime_error(*error);
+                wasmtime_error_delete(error);
+                module = nullptr;
+            }
+            else {
+                std::println("Loaded precompiled module \"{}\"", cache_entry.string());
+                return module;
+            }
+        }
+    }
+
+    if (const auto error = wasmtime_module_new(engine, wasm_binary.data(), wasm_binary.size(), &module)) {
+        std::println("ERROR: Failed to compile WASM module \"{}\"", plugin_path.string());
+        print_wasmtime_error(*error);
+        wasmtime_error_delete(error);
+        return nullptr;
+    }
+
+    if (cache) {
+        wasm_byte_vec_t artifact;
+        if (const auto error = wasmtime_module_serialize(module, &artifact)) {
+            std::println("ERROR: Failed to serialize module for the cache");
+            print_wasmtime_error(*error);
+            wasmtime_error_delete(error);
+        }
+        else {
+            write_module_cache_entry(cache_entry, { reinterpret_cast<const uint8_t*>(artifact.data), artifact.size });
+            wasm_byte_vec_delete(&artifact);
+        }
+    }
+    return module;
+}
@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <print>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <wasmtime.h>
+
+#include "engine_config.hpp"
+#include "export_table.hpp"
+#include "mapped_file.hpp"
+#include "module_loader.hpp"
+#include "plugin_host.hpp"
+#include "tiered_code.hpp"
+#include "wasmtime_session.hpp"
+
+// An engine with the code generation settings of one tier
+struct TierEngine {
+    wasm_engine_t* engine = nullptr;
+    EngineOptions options;
+    CompileTier tier = CompileTier::Optimized;
+};
+
+class WasmtimePluginHost final : public PluginHost {
+public:
+    WasmtimePluginHost(const PluginHostOptions& options, const uint64_t deadline_ticks, const std::chrono::nanoseconds epoch_tick, const bool async)
+        : plugin_path(options.plugin_path), cache_dir(options.cache_dir), wasi_options(options.wasi), host_imports(options.host_imports),
+          guest_profile(options.guest_profile), upgrade_tier(options.upgrade_tier), result_cache_options(options.result_cache), deadline_ticks(deadline_ticks), epoch_tick(epoch_tick), async(async) {
+        call_metrics = options.metrics;
+    }
+    WasmtimePluginHost(const WasmtimePluginHost&) = delete;
+    WasmtimePluginHost& operator=(const WasmtimePluginHost&) = delete;
+
+    // Starts out on `baseline` if given and recompiles for `optimized` in the background, unless optimized code
+    // is already in the cache. Both engines must outlive the host
+    bool load(const std::span<const uint8_t> wasm_binary, const TierEngine* baseline, const TierEngine& optimized) {
+        const TierEngine& first = baseline && !is_cached(optimized, wasm_binary) ? *baseline : optimized;
+        TierStats stats;
+        auto compiled = compile(first, wasm_binary, stats);
+        if (!compiled) {
+            return false;
+        }
+        // Tiers compile the same module, so export indices stay valid across upgrades
+        wasm_exporttype_vec_t export_types;
+        wasmtime_module_exports(compiled->module, &export_types);
+        exports = read_export_table(export_types);
+        wasm_exporttype_vec_delete(&export_types);
+        pure_results = create_result_cache(wasm_binary, result_cache_options);
+        code.publish(std::move(compiled), stats);
+
+        if (&first != &optimized && upgrade_tier) {
+            // The caller's bytes are only valid during load(), the background compile gets a copy
+            code.compile_in_background([this, &optimized, wasm = std::vector<uint8_t>(wasm_binary.begin(), wasm_binary.end())] {
+                TierStats stats;
+                if (auto compiled = compile(optimized, wasm, stats)) {
+                    code.publish(std::move(compiled), stats);
+                    std::println("Plugin \"{}\" switched to optimized code", plugin_path.string());
+                }
+            });
+        }
+        return true;
+    }
+
+    std::optional<uint32_t> find_function(const std::string_view name, const FunctionSignature& signature) const override {
+        return exports.find_function(name, signature);
+    }
+
+    std::unique_ptr<PluginSession> instantiate() override {
+        return instantiate_session(code.current(), exports, wasi_options, deadline_ticks, async);
+    }
+
+    CompileTier current_tier() const override { return code.tier(); }
+    std::vector<TierStats> tier_stats() const override { return code.stats(); }
+    void wait_for_final_tier() override { code.wait(); }
+
+private:
+    std::optional<ModuleCache> module_cache(const TierEngine& target) const {
+        if (cache_dir.empty()) {
+            return std::nullopt;
+        }
+        return ModuleCache { cache_dir, engine_fingerprint(target.options) };
+    }
+
+    bool is_cached(const TierEngine& target, const std::span<const uint8_t> wasm_binary) const {
+        const auto cache = module_cache(target);
+        return cache && std::filesystem::exists(module_cache_entry_path(*cache, wasm_binary));
+    }
+
+    std::shared_ptr<const CompiledPlugin> compile(const TierEngine& target, const std::span<const uint8_t> wasm_binary, TierStats& stats) const {
+        const auto start = std::chrono::steady_clock::now();
+        const auto cache = module_cache(target);
+        stats.tier = target.tier;
+        stats.from_cache = is_cached(target, wasm_binary);
+
+        auto compiled = std::make_shared<CompiledPlugin>();
+        compiled->engine = target.engine;
+        compiled->tier = target.tier;
+        compiled->module = load_plugin_module(target.engine, plugin_path, wasm_binary, cache ? &*cache : nullptr);
+        if (!compiled->module) {
+            return nullptr;
+        }
+        compiled->linker = create_plugin_linker(target.engine, host_imports, call_metrics.get(), async);
+        if (!compiled->linker) {
+            return nullptr;
+        }
+        compiled->instance_pre = prepare_plugin(compiled->linker, compiled->module);
+        if (!compiled->instance_pre) {
+            return nullptr;
+        }
+        if (!guest_profile.empty()) {
+            start_guest_profile(*compiled);
+        }
+        stats.compile_time = std::chrono::steady_clock::now() - start;
+        return compiled;
+    }
+
+    // Each tier's code is profiled separately, a profile only covers the module it was created with
+    void start_guest_profile(CompiledPlugin& compiled) const {
+        compiled.profile_path = guest_profile;
+        if (compiled.tier == CompileTier::Baseline) {
+            compiled.profile_path.replace_filename(std::format("{}-baseline{}", guest_profile.stem().string(), guest_profile.extension().string()));
+        }
+        const auto name = plugin_path.filename().string();
+        wasm_name_t module_name;
+        wasm_byte_vec_new(&module_name, name.size(), name.data());
+        const wasmtime_guestprofiler_modules_t modules[] { { &module_name, compiled.module } };
+        compiled.profiler = wasmtime_guestprofiler_new(&module_name, static_cast<uint64_t>(epoch_tick.count()), modules, std::size(modules));
+        wasm_byte_vec_delete(&module_name);
+    }
+
+    std::filesystem::path plugin_path;
+    std::filesystem::path cache_dir;
+    WasiOptions wasi_options;
+    HostImports host_imports;
+    std::filesystem::path guest_profile;
+    bool upgrade_tier = true;
+    ResultCacheOptions result_cache_options;
+    uint64_t deadline_ticks = 0;
+    std::chrono::nanoseconds epoch_tick { 0 };
+    bool async = false;
+    ExportTable exports;
+    // Last, so a background compile is joined before the members it uses go away
+    TieredCode<CompiledPlugin> code;
+};
+
+class WasmtimePluginEngine final : public PluginEngine {
+public:
+    WasmtimePluginEngine(const EngineOptions& options, const std::chrono::milliseconds epoch_tick, const bool tiered) : epoch_tick(epoch_tick) {
+        optimized = { create_engine(options), options, CompileTier::Optimized };
+        if (tiered) {
+            // Each engine has its own instance pool, so tiering reserves slots twice
+            EngineOptions baseline_options = options;
+            baseline_options.strategy = WASMTIME_STRATEGY_WINCH;
+            baseline = TierEngine { create_engine(baseline_options), baseline_options, CompileTier::Baseline };
+        }
+        if (is_valid() && options.epoch_interruption) {
+            // One thread advances the epoch for every store of the engines, generated code only compares it
+            ticker = std::jthread([engines = std::array { optimized.engine, baseline ? baseline->engine : nullptr }, epoch_tick](const std::stop_token& stop) {
+                while (!stop.stop_requested()) {
+                    std::this_thread::sleep_for(epoch_tick);
+                    for (wasm_engine_t* engine : engines) {
+                        if (engine) {
+                            wasmtime_engine_increment_epoch(engine);
+                        }
+                    }
+                }
+            });
+        }
+    }
+    WasmtimePluginEngine(const WasmtimePluginEngine&) = delete;
+    WasmtimePluginEngine& operator=(const WasmtimePluginEngine&) = delete;
+
+    ~WasmtimePluginEngine() override {
+        if (ticker.joinable()) {
+            ticker.request_stop();
+            ticker.join();
+        }
+        for (const TierEngine* tier : { &optimized, baseline ? &*baseline : nullptr }) {
+            if (tier && tier->engine) {
+                wasm_engine_delete(tier->engine);
+            }
+        }
+    }
+
+    bool is_valid() const { return optimized.engine && (!baseline || baseline->engine); }
+
+    std::string_view name() const override { return "wasmtime"; }
+    std::string_view version() const override { return WASMTIME_VERSION; }
+
+    std::unique_ptr<PluginHost> load(const PluginHostOptions& options) override {
+        uint64_t deadline_ticks = 0;
+        if (options.call_timeout.count() > 0) {
+            if (!optimized.options.epoch_interruption) {
+                std::println("ERROR: Plugin \"{}\" has a call timeout, but the engine is not interruptible", options.plugin_path.string());
+                return nullptr;
+            }
+            // The next tick may come right away, so one extra tick guarantees at least the full budget
+            deadline_ticks = static_cast<uint64_t>((options.call_timeout + epoch_tick - std::chrono::milliseconds(1)) / epoch_tick) + 1;
+        }
+        if (!options.guest_profile.empty() && !optimized.options.epoch_interruption) {
+            // Samples are taken when the epoch advances
+            std::println("ERROR: Plugin \"{}\" is profiled, but the engine is not interruptible", options.plugin_path.string());
+            return nullptr;
+        }
+        // Read up front, the cache lookup of the optimized tier needs the bytes before anything is compiled
+        std::optional<std::vector<uint8_t>> wasm_file;
+        auto wasm_binary = options.plugin_bytes;
+        if (wasm_binary.empty()) {
+            wasm_file = read_file_bytes(options.plugin_path);
+            if (!wasm_file) {
+                std::println("ERROR: Failed to read plugin file \"{}\"", options.plugin_path.string());
+                return nullptr;
+            }
+            wasm_binary = *wasm_file;
+        }
+        auto host = std::make_unique<WasmtimePluginHost>(options, deadline_ticks, epoch_tick, optimized.options.async_support);
+        if (!host->load(wasm_binary, baseline ? &*baseline : nullptr, optimized)) {
+            return nullptr;
+        }
+        return host;
+    }
+
+private:
+    std::chrono::milliseconds epoch_tick;
+    TierEngine optimized;
+    std::optional<TierEngine> baseline;
+    std::jthread ticker;
+};
+
+PLUGIN_ENGINE_EXPORT PluginEngine* create_plugin_engine(const uint32_t abi_version, const EngineSettings& settings) {
+    if (abi_version != plugin_engine_abi_version) {
+        std::println("ERROR: Host expects plugin engine ABI {}, wasmtime module implements {}", abi_version, plugin_engine_abi_version);
+        return nullptr;
+    }
+    EngineOptions options;
+    options.pooled_instances = settings.max_instances;
+    options.epoch_interruption = settings.interruptible;
+    options.async_support = settings.async_calls;
+    switch (settings.jit_profiler) {
+        case JitProfiler::None:
+            options.profiler = WASMTIME_PROFILING_STRATEGY_NONE;
+            break;
+        case JitProfiler::PerfMap:
+            options.profiler = WASMTIME_PROFILING_STRATEGY_PERFMAP;
+            break;
+        case JitProfiler::JitDump:
+            options.profiler = WASMTIME_PROFILING_STRATEGY_JITDUMP;
+            break;
+    }
+    auto engine = std::make_unique<WasmtimePluginEngine>(options, std::max(settings.epoch_tick, std::chrono::milliseconds(1)), settings.tiered);
+    if (!engine->is_valid()) {
+        std::println("ERROR: Failed to create wasmtime engine");
+        return nullptr;
+    }
+    return engine.release();
+}
@@ -0,0 +1,34 @@
+#include "wasmtime_errors.hpp"
+
+#include <print>
+#include <string>
+
+void print_wasmtime_error(const wasmtime_error_t& error) {
+    wasm_name_t message;
+    wasmtime_error_message(&error, &message);
+    std::println("wasmtime error: {}", std::string { message.data, message.size });
+    wasm_byte_vec_delete(&message);
+}
+
+void print_wasm_trap(const wasm_trap_t& trap) {
+    wasm_message_t message;
+    wasm_trap_message(&trap, &message);
+    std::println("wasm trap: {}", std::string { message.data, message.size });
+    wasm_byte_vec_delete(&message);
+}
+
+bool check_wasmtime_call(std::string_view fn_name, wasmtime_error_t* error, wasm_trap_t* trap) {
+    if (error) {
+        std::println("ERROR: Failed to call plugin function {}", fn_name);
+        print_wasmtime_error(*error);
+        wasmtime_error_delete(error);
+        return true;
+    }
+    if (trap) {
+        std::println("ERROR: Plugin function {} trapped", fn_name);
+        print_wasm_trap(*trap);
+        wasm_trap_delete(trap);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string_view>
+
+#include <wasmtime.h>
+
+void print_wasmtime_error(const wasmtime_error_t& error);
+
+void print_wasm_trap(const wasm_trap_t& trap);
+
+// Reports and releases the error or trap returned by a wasmtime call. Returns true if the call failed
+bool check_wasmtime_call(std::string_view fn_name, wasmtime_error_t* error, wasm_trap_t* trap);
@@ -0,0 +1,485 @@
+#include "wasmtime_session.hpp"
+
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <limits>
+#include <print>
+
+#include "host_files.hpp"
+#include "host_funcs.hpp"
+#include "plugin_metrics.hpp"
+#include "wasm_types.hpp"
+#include "wasmtime_errors.hpp"
+#include "wasmtime_values.hpp"
+
+// Far enough in the future to never be reached, without overflowing when added to the current epoch
+constexpr uint64_t no_deadline = std::numeric_limits<uint64_t>::max() / 2;
+
+static void write_guest_profile(wasmtime_guestprofiler_t* profiler, const std::filesystem::path& path) {
+    wasm_byte_vec_t profile;
+    // Consumes the profiler
+    if (auto error = wasmtime_guestprofiler_finish(profiler, &profile)) {
+        std::println("ERROR: Failed to finish guest profile \"{}\"", path.string());
+        print_wasmtime_error(*error);
+        wasmtime_error_delete(error);
+        return;
+    }
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file || !file.write(profile.data, static_cast<std::streamsize>(profile.size))) {
+        std::println("ERROR: Failed to write guest profile \"{}\"", path.string());
+    }
+    else {
+        std::println("Wrote guest profile \"{}\"", path.string());
+    }
+    wasm_byte_vec_delete(&profile);
+}
+
+CompiledPlugin::~CompiledPlugin() {
+    if (profiler) {
+        write_guest_profile(profiler, profile_path);
+    }
+    if (instance_pre) {
+        wasmtime_instance_pre_delete(instance_pre);
+    }
+    if (linker) {
+        wasmtime_linker_delete(linker);
+    }
+    if (module) {
+        wasmtime_module_delete(module);
+    }
+}
+
+WasmtimeSession::~WasmtimeSession() {
+    if (store) {
+        wasmtime_store_delete(store);
+    }
+    if (output) {
+        output->close();
+    }
+}
+
+template<OutputStream stream>
+static ptrdiff_t write_captured_output(void* data, const unsigned char* bytes, const size_t size) {
+    static_cast<InstanceOutput*>(data)->write(stream, { reinterpret_cast<const char*>(bytes), size });
+    // Output dropped by a full buffer still counts as written, the guest is not meant to notice
+    return static_cast<ptrdiff_t>(size);
+}
+
+// Epoch deadline callback of sessions that stop on every tick: profiled ones take a sample, async ones with a time
+// budget yield to the event loop. Both count down the call's budget themselves
+static wasmtime_error_t* on_epoch_tick(wasmtime_context_t*, void* data, uint64_t* deadline_delta, wasmtime_update_deadline_kind_t* update_kind) {
+    auto& session = *static_cast<WasmtimeSession*>(data);
+    if (session.code->profiler) {
+        const auto now = std::chrono::steady_clock::now();
+        {
+            std::lock_guard lock(session.code->profiler_mutex);
+            wasmtime_guestprofiler_sample(session.code->profiler, session.store, static_cast<uint64_t>(std::chrono::nanoseconds(now - session.last_sample).count()));
+        }
+        session.last_sample = now;
+    }
+    if (session.deadline_ticks && --session.ticks_left == 0) {
+        return wasmtime_error_new("plugin call ran out of its time budget");
+    }
+    *deadline_delta = 1;
+    *update_kind = session.async ? WASMTIME_UPDATE_DEADLINE_YIELD : WASMTIME_UPDATE_DEADLINE_CONTINUE;
+    return nullptr;
+}
+
+void WasmtimeSession::arm_deadline() {
+    if (stops_every_tick) {
+        ticks_left = deadline_ticks;
+        last_sample = std::chrono::steady_clock::now();
+        wasmtime_context_set_epoch_deadline(context, 1);
+    }
+    else if (deadline_ticks) {
+        wasmtime_context_set_epoch_deadline(context, deadline_ticks);
+    }
+}
+
+static void report_interrupt(const std::string_view name, const wasm_trap_t* trap) {
+    if (wasmtime_trap_code_t code; trap && wasmtime_trap_code(trap, &code) && code == WASMTIME_TRAP_CODE_INTERRUPT) {
+        std::println("ERROR: Plugin function {} ran out of its time budget", name);
+    }
+}
+
+// Set while an async store is polled to completion on this thread, whose fibers run the guest
+static thread_local bool in_sync_call = false;
+
+// Drives a future to completion on the calling thread, async host imports trap meanwhile
+static void poll_to_completion(wasmtime_call_future_t* future) {
+    const bool outer_sync_call = in_sync_call;
+    in_sync_call = true;
+    while (!wasmtime_call_future_poll(future)) {
+    }
+    in_sync_call = outer_sync_call;
+    wasmtime_call_future_delete(future);
+}
+
+// Call on an async store. Owns the checked argument and result values wasmtime works on while it is polled
+class WasmtimePendingCall final : public PendingCall {
+public:
+    WasmtimePendingCall(WasmtimeSession& session, const uint32_t index, const std::span<PluginValue> slots) : session(session), index(index), slots(slots) {
+        const auto& signature = session.exports->functions[index]->signature;
+        for (size_t i = 0; i < signature.params.size(); i++) {
+            args[i] = to_wasmtime_val(signature.params[i], slots[i]);
+        }
+        session.arm_deadline();
+        future = wasmtime_func_call_async(session.context, &session.functions[index], args, signature.params.size(), results, signature.results.size(), &trap, &error);
+    }
+    WasmtimePendingCall(const WasmtimePendingCall&) = delete;
+    WasmtimePendingCall& operator=(const WasmtimePendingCall&) = delete;
+
+    // Dropping an unfinished call cancels it, which leaves the guest in an unknown state
+    ~WasmtimePendingCall() override {
+        if (future) {
+            wasmtime_call_future_delete(future);
+            session.poison();
+        }
+    }
+
+    bool poll() override {
+        if (!future) {
+            return true;
+        }
+        if (!wasmtime_call_future_poll(future)) {
+            return false;
+        }
+        wasmtime_call_future_delete(future);
+        future = nullptr;
+
+        const auto& function = *session.exports->functions[index];
+        report_interrupt(function.name, trap);
+        if (check_wasmtime_call(function.name, error, trap)) {
+            session.poison();
+            return true;
+        }
+        for (size_t i = 0; i < function.signature.results.size(); i++) {
+            slots[i] = from_wasmtime_val(results[i]);
+        }
+        success = true;
+        return true;
+    }
+
+    bool succeeded() const override { return success; }
+
+private:
+    WasmtimeSession& session;
+    uint32_t index;
+    std::span<PluginValue> slots;
+    wasmtime_val_t args[max_call_slots];
+    wasmtime_val_t results[max_call_slots];
+    wasmtime_call_future_t* future = nullptr;
+    wasm_trap_t* trap = nullptr;
+    wasmtime_error_t* error = nullptr;
+    bool success = false;
+};
+
+std::unique_ptr<PendingCall> WasmtimeSession::call_async(const uint32_t index, const std::span<PluginValue> slots) {
+    if (!async) {
+        return nullptr;
+    }
+    return std::make_unique<WasmtimePendingCall>(*this, index, slots);
+}
+
+bool WasmtimeSession::call(const uint32_t index, const std::span<PluginValue> slots) {
+    if (async) {
+        // Polled to completion here, so the guest only suspends when it yields on an epoch tick. An async host
+        // import would wait on an event loop that is not running, it traps instead
+        const bool outer_sync_call = in_sync_call;
+        in_sync_call = true;
+        WasmtimePendingCall pending(*this, index, slots);
+        while (!pending.poll()) {
+        }
+        in_sync_call = outer_sync_call;
+        return pending.succeeded();
+    }
+
+    // Only the low bytes of each raw slot carry a scalar, the same layout PluginValue has
+    wasmtime_val_raw_t raw[max_call_slots];
+    for (size_t i = 0; i < slots.size(); i++) {
+        std::memcpy(&raw[i], &slots[i], sizeof(PluginValue));
+    }
+    arm_deadline();
+    wasm_trap_t* trap = nullptr;
+    wasmtime_error_t* error = wasmtime_func_call_unchecked(context, &functions[index], raw, slots.size(), &trap);
+    const auto& name = exports->functions[index]->name;
+    report_interrupt(name, trap);
+    if (check_wasmtime_call(name, error, trap)) {
+        poisoned = true;
+        return false;
+    }
+    for (size_t i = 0; i < slots.size(); i++) {
+        std::memcpy(&slots[i], &raw[i], sizeof(PluginValue));
+    }
+    return true;
+}
+
+GuestMemoryView WasmtimeSession::memory_view() {
+    if (!has_memory) {
+        return GuestMemoryView({});
+    }
+    return GuestMemoryView({ wasmtime_memory_data(context, &memory), wasmtime_memory_data_size(context, &memory) });
+}
+
+// Host import whose result may come later. The guest's fiber is suspended until `pending` reports it done
+struct AsyncHostCallState {
+    std::unique_ptr<PendingHostCall> pending;
+    wasmtime_val_t* results;
+    const FunctionSignature* signature;
+};
+
+static bool define_async_host_func(wasmtime_linker_t* linker, const std::string_view module, const std::string_view name, const FunctionSignature& signature, AsyncHostFn fn) {
+    struct Env {
+        AsyncHostFn fn;
+        FunctionSignature signature;
+    };
+    const auto callback = [](void* env, wasmtime_caller_t*, const wasmtime_val_t* args, const size_t nargs, wasmtime_val_t* results, size_t, wasm_trap_t** trap,
+        wasmtime_async_continuation_t* continuation) {
+        if (in_sync_call) {
+            constexpr std::string_view message = "async host import called from a synchronous plugin call, use call_async";
+            *trap = wasmtime_trap_new(message.data(), message.size());
+            return;
+        }
+        auto& host = *static_cast<Env*>(env);
+        PluginValue values[max_call_slots];
+        for (size_t i = 0; i < nargs; i++) {
+            values[i] = from_wasmtime_val(args[i]);
+        }
+        auto pending = host.fn({ values, nargs });
+        if (!pending) {
+            constexpr std::string_view message = "async host import failed to start";
+            *trap = wasmtime_trap_new(message.data(), message.size());
+            return;
+        }
+        // `results` stays valid until the continuation reports completion
+        auto* state = new AsyncHostCallState { std::move(pending), results, &host.signature };
+        continuation->env = state;
+        continuation->finalizer = [](void* state) { delete static_cast<AsyncHostCallState*>(state); };
+        continuation->callback = [](void* env) {
+            auto& state = *static_cast<AsyncHostCallState*>(env);
+            PluginValue values[max_call_slots] {};
+            if (!state.pending->poll({ values, state.signature->results.size() })) {
+                return false;
+            }
+            for (size_t i = 0; i < state.signature->results.size(); i++) {
+                state.results[i] = to_wasmtime_val(state.signature->results[i], values[i]);
+            }
+            return true;
+        };
+    };
+
+    wasm_functype_t* type = make_functype(signature);
+    auto* env = new Env { std::move(fn), signature };
+    auto error = wasmtime_linker_define_async_func(linker, module.data(), module.size(), name.data(), name.size(), type,
+        callback, env, [](void* env) { delete static_cast<Env*>(env); });
+    wasm_functype_delete(type);
+    if (error) {
+        std::println(R"(ERROR: Failed to define async "{}"."{}" in the linker)", module, name);
+        print_wasmtime_error(*error);
+        wasmtime_error_delete(error);
+        return false;
+    }
+    return true;
+}
+
+// Memory of the instance calling a host import
+static GuestMemoryView caller_memory(wasmtime_caller_t* caller) {
+    wasmtime_extern_t item;
+    if (!wasmtime_caller_export_get(caller, "memory", strlen("memory"), &item) || item.kind != WASMTIME_EXTERN_MEMORY) {
+        return GuestMemoryView({});
+    }
+    const auto* context = wasmtime_caller_context(caller);
+    return GuestMemoryView({ wasmtime_memory_data(context, &item.of.memory), wasmtime_memory_data_size(context, &item.of.memory) });
+}
+
+static bool define_file_imports(wasmtime_linker_t* linker, const std::shared_ptr<HostFiles>& files, PluginMetrics* metrics) {
+    const auto path = [](const int32_t address, const int32_t length) { return GuestString { { static_cast<uint32_t>(address), static_cast<uint32_t>(length) } }; };
+    const auto span = [](const int32_t address, const int32_t length) { return GuestSpan { static_cast<uint32_t>(address), static_cast<uint32_t>(length) }; };
+    return define_host_func<int64_t(int32_t, int32_t)>(linker, "env", "file_size",
+               [files, path, metrics = import_metrics_handle(metrics, "env.file_size")](wasmtime_caller_t* caller, const int32_t path_address, const int32_t path_length) {
+                   return record_import_call(metrics, [&] { return files->file_size(caller_memory(caller), path(path_address, path_length)); });
+               })
+        && define_host_func<int64_t(int32_t, int32_t, int32_t, int32_t)>(linker, "env", "read_file",
+            [files, path, span, metrics = import_metrics_handle(metrics, "env.read_file")](wasmtime_caller_t* caller, const int32_t path_address, const int32_t path_length, const int32_t buffer, const int32_t capacity) {
+                return record_import_call(metrics, [&] { return files->read_file(caller_memory(caller), path(path_address, path_length), span(buffer, capacity)); });
+            })
+        && define_host_func<int64_t(int32_t, int32_t, int64_t, int32_t, int32_t)>(linker, "env", "read_file_at",
+            [files, path, span, metrics = import_metrics_handle(metrics, "env.read_file_at")](wasmtime_caller_t* caller, const int32_t path_address, const int32_t path_length, const int64_t offset, const int32_t buffer, const int32_t length) {
+                return record_import_call(metrics, [&] { return files->read_file_at(caller_memory(caller), path(path_address, path_length), offset, span(buffer, length)); });
+            })
+        && define_host_func<int32_t(int32_t, int32_t, int32_t, int32_t)>(linker, "env", "write_file",
+            [files, path, span, metrics = import_metrics_handle(metrics, "env.write_file")](wasmtime_caller_t* caller, const int32_t path_address, const int32_t path_length, const int32_t data, const int32_t length) {
+                return record_import_call(metrics, [&] { return files->write_file(caller_memory(caller), path(path_address, path_length), span(data, length)); });
+            });
+}
+
+wasmtime_linker_t* create_plugin_linker(wasm_engine_t* engine, const HostImports& host_imports, PluginMetrics* metrics, const bool async) {
+    auto linker = wasmtime_linker_new(engine);
+    if (!linker) {
+        std::println("ERROR: Failed to create wasmtime linker");
+        return nullptr;
+    }
+    if (auto error = wasmtime_linker_define_wasi(linker)) {
+        std::println("ERROR: Failed to define WASI symbols in the linker");
+        print_wasmtime_error(*error);
+        wasmtime_error_delete(error);
+        wasmtime_linker_delete(linker);
+        return nullptr;
+    }
+
+    // Imports left unset are simply not provided, plugins that need them fail to link
+    bool defined = true;
+    const auto host_fn_metrics = import_metrics_handle(metrics, "env.host_fn");
+    if (host_imports.host_fn_async) {
+        if (!async) {
+            std::println("ERROR: Async host imports need an engine created with async_calls");
+            defined = false;
+        }
+        else {
+            defined = define_async_host_func(linker, "env", "host_fn", signature_of<int32_t>(), record_async_import(host_fn_metrics, host_imports.host_fn_async));
+        }
+    }
+    else if (host_imports.host_fn) {
+        defined = define_host_func<int32_t()>(linker, "env", "host_fn", [host_fn = host_imports.host_fn, host_fn_metrics] {
+            return record_import_call(host_fn_metrics, host_fn);
+        });
+    }
+    if (defined && host_imports.files) {
+        defined = define_file_imports(linker, host_imports.files, metrics);
+    }
+    for (const auto& batch_fn : host_imports.batch_fns) {
+        if (!defined) {
+            break;
+        }
+        defined = define_host_func<int32_t(int32_t, int32_t, int32_t)>(linker, "env", batch_fn.name,
+            [batch_fn, metrics = import_metrics_handle(metrics, std::format("env.{}", batch_fn.name))](wasmtime_caller_t* caller, const int32_t requests, const int32_t count, const int32_t results) {
+                return record_import_call(metrics, [&] { return batch_fn.call(caller_memory(caller), requests, count, results); });
+            });
+    }
+    if (!defined) {
+        wasmtime_linker_delete(linker);
+        return nullptr;
+    }
+    return linker;
+}
+
+wasmtime_instance_pre_t* prepare_plugin(const wasmtime_linker_t* linker, const wasmtime_module_t* module) {
+    wasmtime_instance_pre_t* instance_pre = nullptr;
+    if (auto error = wasmtime_linker_instantiate_pre(linker, module, &instance_pre)) {
+        std::println("ERROR: Failed to link module");
+        print_wasmtime_error(*error);
+        wasmtime_error_delete(error);
+        return nullptr;
+    }
+    return instance_pre;
+}
+
+std::unique_ptr<WasmtimeSession> instantiate_session(std::shared_ptr<const CompiledPlugin> code, const ExportTable& exports, const WasiOptions& wasi_options, const uint64_t deadline_ticks, const bool async) {
+    auto plugin = std::make_unique<WasmtimeSession>(std::move(code));
+    const auto* instance_pre = plugin->code->instance_pre;
+    plugin->store = wasmtime_store_new(plugin->code->engine, nullptr, nullptr);
+    if (!plugin->store) {
+        std::println("ERROR: Failed to create wasmtime store");
+        return nullptr;
+    }
+    plugin->context = wasmtime_store_context(plugin->store);
+    // Stores start with a deadline of zero ticks, which traps at the first check of an interruptible engine
+    plugin->deadline_ticks = deadline_ticks;
+    plugin->async = async;
+    wasmtime_context_set_epoch_deadline(plugin->context, deadline_ticks ? deadline_ticks : no_deadline);
+    plugin->stops_every_tick = plugin->code->profiler || (async && deadline_ticks);
+    if (plugin->stops_every_tick) {
+        wasmtime_store_epoch_deadline_callback(plugin->store, on_epoch_tick, plugin.get(), nullptr);
+        plugin->arm_deadline();
+    }
+    else if (async) {
+        // Without a budget to count, a CPU-bound guest still gives the event loop back on every tick. Only takes
+        // effect on interruptible engines, the others emit no epoch checks
+        wasmtime_context_set_epoch_deadline(plugin->context, 1);
+        wasmtime_context_epoch_deadline_async_yield_and_update(plugin->context, 1);
+    }
+
+    {
+        const auto config = wasi_config_new();
+        if (wasi_options.capture) {
+            // The session outlives its store and with it the WASI context that writes to the buffer
+            plugin->capture = wasi_options.capture;
+            plugin->output = plugin->capture->open_instance();
+            wasi_config_set_stdout_custom(config, write_captured_output<OutputStream::Stdout>, plugin->output.get(), nullptr);
+            wasi_config_set_stderr_custom(config, write_captured_output<OutputStream::Stderr>, plugin->output.get(), nullptr);
+        }
+        else if (wasi_options.inherit_stdio) {
+            wasi_config_inherit_stdout(config);
+            wasi_config_inherit_stderr(config);
+        }
+        std::filesystem::create_directories(wasi_options.data_dir);
+        wasi_config_preopen_dir(config, std::filesystem::absolute(wasi_options.data_dir).string().c_str(), ".");
+        if (const auto error = wasmtime_context_set_wasi(plugin->context, config)) {
+            std::println("ERROR: Failed to create WASI env");
+            print_wasmtime_error(*error);
+            wasmtime_error_delete(error);
+            return nullptr;
+        }
+    }
+
+    wasm_trap_t* trap = nullptr;
+    wasmtime_error_t* error = nullptr;
+    if (async) {
+        poll_to_completion(wasmtime_instance_pre_instantiate_async(instance_pre, plugin->context, &plugin->instance, &trap, &error));
+    }
+    else {
+        error = wasmtime_instance_pre_instantiate(instance_pre, plugin->context, &plugin->instance, &trap);
+    }
+    if (error) {
+        std::println("ERROR: Failed to instantiate plugin");
+        print_wasmtime_error(*error);
+        wasmtime_error_delete(error);
+        return nullptr;
+    }
+    if (trap) {
+        std::println("ERROR: Plugin trapped during instantiation");
+        print_wasm_trap(*trap);
+        wasm_trap_delete(trap);
+        return nullptr;
+    }
+
+    // WASI reactors must run their initializer before any other export is called
+    wasmtime_extern_t initialize;
+    if (wasmtime_instance_export_get(plugin->context, &plugin->instance, "_initialize", strlen("_initialize"), &initialize) && initialize.kind == WASMTIME_EXTERN_FUNC) {
+        trap = nullptr;
+        if (async) {
+            poll_to_completion(wasmtime_func_call_async(plugin->context, &initialize.of.func, nullptr, 0, nullptr, 0, &trap, &error));
+        }
+        else {
+            error = wasmtime_func_call(plugin->context, &initialize.of.func, nullptr, 0, nullptr, 0, &trap);
+        }
+        if (check_wasmtime_call("_initialize", error, trap)) {
+            return nullptr;
+        }
+    }
+
+    plugin->exports = &exports;
+    plugin->functions.resize(exports.functions.size());
+    for (size_t i = 0; i < exports.functions.size(); i++) {
+        const bool is_memory = exports.memory_index == i;
+        if (!exports.functions[i] && !is_memory) {
+            continue;
+        }
+        char* name = nullptr;
+        size_t name_len = 0;
+        wasmtime_extern_t item;
+        if (!wasmtime_instance_export_nth(plugin->context, &plugin->instance, i, &name, &name_len, &item)) {
+            std::println("ERROR: Instance is missing export {}", i);
+            return nullptr;
+        }
+        if (is_memory && item.kind == WASMTIME_EXTERN_MEMORY) {
+            plugin->memory = item.of.memory;
+            plugin->has_memory = true;
+        }
+        else if (item.kind == WASMTIME_EXTERN_FUNC) {
+            plugin->functions[i] = item.of.func;
+        }
+    }
+    return plugin;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include <wasmtime.h>
+
+#include "export_table.hpp"
+#include "host_imports.hpp"
+#include "output_capture.hpp"
+#include "plugin_host.hpp"
+
+// A plugin compiled and linked on one engine, shared by every session instantiated from it
+struct CompiledPlugin {
+    wasm_engine_t* engine = nullptr;
+    wasmtime_module_t* module = nullptr;
+    wasmtime_linker_t* linker = nullptr;
+    wasmtime_instance_pre_t* instance_pre = nullptr;
+    CompileTier tier = CompileTier::Optimized;
+    // Samples the guest stacks of every session instantiated from this code, written to `profile_path` on
+    // destruction. Sessions run on any thread, so they sample under the mutex
+    wasmtime_guestprofiler_t* profiler = nullptr;
+    std::filesystem::path profile_path;
+    mutable std::mutex profiler_mutex;
+
+    CompiledPlugin() = default;
+    CompiledPlugin(const CompiledPlugin&) = delete;
+    CompiledPlugin& operator=(const CompiledPlugin&) = delete;
+    ~CompiledPlugin();
+};
+
+// One instantiated plugin in its own store, isolated from every other instance
+struct WasmtimeSession final : PluginSession {
+    // Keeps the code alive after the host moved on to a higher tier
+    std::shared_ptr<const CompiledPlugin> code;
+    wasmtime_store_t* store = nullptr;
+    wasmtime_context_t* context = nullptr;
+    wasmtime_instance_t instance {};
+    const ExportTable* exports = nullptr;
+    // Indexed like `exports`, entries of non-function exports are unused
+    std::vector<wasmtime_func_t> functions;
+    wasmtime_memory_t memory {};
+    bool has_memory = false;
+    // Epoch ticks every call may take, 0 for no limit
+    uint64_t deadline_ticks = 0;
+    // The store belongs to an async engine and only takes async calls
+    bool async = false;
+    // Profiled sessions, and async ones with a budget, stop on every tick to take a sample or yield, and count
+    // the ticks of the call's budget themselves
+    bool stops_every_tick = false;
+    uint64_t ticks_left = 0;
+    std::chrono::steady_clock::time_point last_sample;
+    // Buffer of the guest's stdout and stderr when the host captures them, written by WASI while the guest runs
+    std::shared_ptr<OutputCapture> capture;
+    std::shared_ptr<InstanceOutput> output;
+
+    explicit WasmtimeSession(std::shared_ptr<const CompiledPlugin> code) : code(std::move(code)) { tier = this->code->tier; }
+    WasmtimeSession(const WasmtimeSession&) = delete;
+    WasmtimeSession& operator=(const WasmtimeSession&) = delete;
+    ~WasmtimeSession() override;
+
+    bool call(uint32_t index, std::span<PluginValue> slots) override;
+    std::unique_ptr<PendingCall> call_async(uint32_t index, std::span<PluginValue> slots) override;
+    GuestMemoryView memory_view() override;
+
+    void poison() { poisoned = true; }
+
+    // Gives the next call, or the instantiation, its full time budget
+    void arm_deadline();
+};
+
+// Linker with WASI and the host functions plugins may import. Holds no store state, so one linker serves every instance
+wasmtime_linker_t* create_plugin_linker(wasm_engine_t* engine, const HostImports& host_imports, PluginMetrics* metrics, bool async);
+
+// Resolves the module's imports once, leaving only store creation and initialization per instance
+wasmtime_instance_pre_t* prepare_plugin(const wasmtime_linker_t* linker, const wasmtime_module_t* module);
+
+std::unique_ptr<WasmtimeSession> instantiate_session(std::shared_ptr<const CompiledPlugin> code, const ExportTable& exports, const WasiOptions& wasi_options, uint64_t deadline_ticks, bool async);
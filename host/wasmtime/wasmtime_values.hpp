@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+#include <wasmtime.h>
+
+#include "plugin_values.hpp"
+
+// Conversions between C++ scalars and the untyped slots used by wasmtime's unchecked call path
+
+template<typename T>
+void store_raw(wasmtime_val_raw_t& slot, const T value) {
+    if constexpr (std::is_same_v<T, int32_t>) slot.i32 = value;
+    else if constexpr (std::is_same_v<T, int64_t>) slot.i64 = value;
+    else if constexpr (std::is_same_v<T, float>) slot.f32 = value;
+    else if constexpr (std::is_same_v<T, double>) slot.f64 = value;
+}
+
+template<typename T>
+T load_raw(const wasmtime_val_raw_t& slot) {
+    if constexpr (std::is_same_v<T, int32_t>) return slot.i32;
+    else if constexpr (std::is_same_v<T, int64_t>) return slot.i64;
+    else if constexpr (std::is_same_v<T, float>) return slot.f32;
+    else if constexpr (std::is_same_v<T, double>) return slot.f64;
+}
+
+// Checked values, used where wasmtime has no unchecked variant such as async calls
+inline wasmtime_val_t to_wasmtime_val(const ValKind kind, const PluginValue& value) {
+    wasmtime_val_t val;
+    switch (kind) {
+        case ValKind::I32: val.kind = WASMTIME_I32; val.of.i32 = value.i32; break;
+        case ValKind::I64: val.kind = WASMTIME_I64; val.of.i64 = value.i64; break;
+        case ValKind::F32: val.kind = WASMTIME_F32; val.of.f32 = value.f32; break;
+        case ValKind::F64: val.kind = WASMTIME_F64; val.of.f64 = value.f64; break;
+    }
+    return val;
+}
+
+inline PluginValue from_wasmtime_val(const wasmtime_val_t& val) {
+    PluginValue value {};
+    switch (val.kind) {
+        case WASMTIME_I32: value.i32 = val.of.i32; break;
+        case WASMTIME_I64: value.i64 = val.of.i64; break;
+        case WASMTIME_F32: value.f32 = val.of.f32; break;
+        case WASMTIME_F64: value.f64 = val.of.f64; break;
+        default: break;
+    }
+    return value;
+}
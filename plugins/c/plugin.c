@@ -1,23 +1,86 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+
+#include "plugin_arena.h"
+#include "plugin_ring.h"
+#include "points_schema.h"
+
+// Run once before the host snapshots the plugin. The first path lookup makes wasi-libc resolve its preopens,
+// which every instance then starts out with
+void plugin_init() {
+    access(".", F_OK);
+}
 
 int sum(const int a, const int b) {
     return a + b;
 }
 
-char* get_heap_allocated_string() {
-    const char* str = "Greetings from the C plugin!";
-    char* heap_str = malloc(strlen(str) + 1);
-    strcpy(heap_str, str);
-    heap_str[strlen(str)] = '\0';
-    printf("ptr: %lld\n", (intptr_t)heap_str);
-    return heap_str;
+// Exports whose result only depends on their arguments, one per line. The host answers repeated calls of them from
+// its result cache without calling into the plugin
+__asm__(
+    ".section .custom_section.plugin.pure,\"\",@\n"
+    ".ascii \"sum\\n\"\n"
+    ".text\n");
+
+// Sums `count` (a, b) pairs packed back to back in `pairs`, amortizing one call over the whole batch
+void sum_batch(const int* pairs, const int count, int* results) {
+    for (int i = 0; i < count; i++) {
+        results[i] = sum(pairs[2 * i], pairs[2 * i + 1]);
+    }
 }
 
-void free_heap_allocated_string(char* str) {
-    memset(str, 0, strlen(str));
-    free(str);
+// Sums every (a, b) pair the host queued in `requests` and queues the results in `responses`, one call for any
+// number of records. Stops early once `responses` is full and returns how many pairs it summed
+int sum_ring(plugin_ring* requests, plugin_ring* responses) {
+    int count = 0;
+    uint32_t length;
+    const int* pair;
+    while ((pair = plugin_ring_peek(requests, &length))) {
+        const int result = length == 2 * sizeof(int) ? sum(pair[0], pair[1]) : 0;
+        if (!plugin_ring_push(responses, &result, sizeof(result))) {
+            break;
+        }
+        plugin_ring_pop(requests, length);
+        count++;
+    }
+    return count;
+}
+
+// The string lives in the host's arena, which the host resets once it has read it
+const char* get_arena_string(plugin_arena* arena) {
+    return plugin_arena_strdup(arena, "Greetings from the C plugin!");
+}
+
+// Sums the points of `request`, read in place, into a PointsSummary allocated from `results`. Returns NULL if
+// `results` is full
+PointsSummary* sum_points(const PointsRequest* request, plugin_arena* results) {
+    PointsSummary* summary = PointsSummary_new(results);
+    if (!summary) {
+        return NULL;
+    }
+    uint32_t count;
+    const Point* points = PointsRequest_points(request, &count);
+    for (uint32_t i = 0; i < count; i++) {
+        summary->sum.x = sum(summary->sum.x, points[i].x);
+        summary->sum.y = sum(summary->sum.y, points[i].y);
+    }
+    summary->count = count;
+    uint32_t length;
+    const char* label = PointsRequest_label(request, &length);
+    if (!PointsSummary_set_label(summary, results, label, length)) {
+        return NULL;
+    }
+    return summary;
+}
+
+void* plugin_alloc(const size_t size) {
+    return malloc(size);
+}
+
+void plugin_free(void* ptr, const size_t size) {
+    free(ptr);
 }
 
 void test_print() {
@@ -65,3 +128,12 @@ __attribute__((import_name("host_fn"))) extern int host_fn();
 void test_host_fn() {
     printf("test_host_fn(): Got value: %d\n", host_fn());
 }
+
+// Calls back into the host `count` times, used to measure guest to host call cost
+int sum_host_fn(const int count) {
+    int total = 0;
+    for (int i = 0; i < count; i++) {
+        total += host_fn();
+    }
+    return total;
+}
@@ -0,0 +1,41 @@
+#ifndef PLUGIN_ARENA_H
+#define PLUGIN_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Plugin side of the host's GuestArena (host/common/guest_arena.hpp): a bump arena the host passes to an export
+// for its results. Nothing allocated from it is ever freed by the plugin, the host resets the whole arena once it
+// has read the results
+
+typedef struct plugin_arena {
+    uint32_t capacity;
+    // Bytes handed out since the host last reset the arena
+    uint32_t used;
+    uint32_t reserved[2];
+    uint8_t data[];
+} plugin_arena;
+
+_Static_assert(offsetof(plugin_arena, used) == 4 && offsetof(plugin_arena, data) == 16, "layout must match the host's");
+
+// Returns `size` bytes aligned to `align`, a power of two of at most 16, or NULL if the arena is full
+static inline void* plugin_arena_alloc(plugin_arena* arena, const size_t size, const size_t align) {
+    const size_t start = (arena->used + align - 1) & ~(align - 1);
+    if (start > arena->capacity || size > arena->capacity - start) {
+        return NULL;
+    }
+    arena->used = (uint32_t)(start + size);
+    return arena->data + start;
+}
+
+static inline char* plugin_arena_strdup(plugin_arena* arena, const char* str) {
+    const size_t length = strlen(str);
+    char* copy = plugin_arena_alloc(arena, length + 1, 1);
+    if (copy) {
+        memcpy(copy, str, length + 1);
+    }
+    return copy;
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef PLUGIN_FILES_H
+#define PLUGIN_FILES_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Whole-file imports of the host (host/common/host_files.hpp). Each moves a whole file, or a window of one, in one
+// call to the host instead of going through WASI. Paths are relative to the host's data directory and cannot
+// leave it. Every function returns one of the negative errors below on failure
+
+#define PLUGIN_FILE_INVALID_ARGUMENT -1
+#define PLUGIN_FILE_NOT_FOUND -2
+#define PLUGIN_FILE_IO_ERROR -3
+
+__attribute__((import_module("env"), import_name("file_size"))) extern int64_t plugin_file_size_import(const char* path, uint32_t path_length);
+__attribute__((import_module("env"), import_name("read_file"))) extern int64_t plugin_read_file_import(const char* path, uint32_t path_length, void* buffer, uint32_t capacity);
+__attribute__((import_module("env"), import_name("read_file_at"))) extern int64_t plugin_read_file_at_import(const char* path, uint32_t path_length, int64_t offset, void* buffer, uint32_t length);
+__attribute__((import_module("env"), import_name("write_file"))) extern int32_t plugin_write_file_import(const char* path, uint32_t path_length, const void* data, uint32_t length);
+
+static inline int64_t plugin_file_size(const char* path) {
+    return plugin_file_size_import(path, (uint32_t)strlen(path));
+}
+
+// Copies up to `capacity` bytes of the file to `buffer` and returns its full size, so a larger result means the
+// buffer was too small
+static inline int64_t plugin_read_file(const char* path, void* buffer, const uint32_t capacity) {
+    return plugin_read_file_import(path, (uint32_t)strlen(path), buffer, capacity);
+}
+
+// Copies up to `length` bytes starting at `offset` and returns how many were copied, 0 past the end of the file
+static inline int64_t plugin_read_file_at(const char* path, const int64_t offset, void* buffer, const uint32_t length) {
+    return plugin_read_file_at_import(path, (uint32_t)strlen(path), offset, buffer, length);
+}
+
+// Replaces the file with `length` bytes of `data`. Returns 0 on success
+static inline int32_t plugin_write_file(const char* path, const void* data, const uint32_t length) {
+    return plugin_write_file_import(path, (uint32_t)strlen(path), data, length);
+}
+
+#endif
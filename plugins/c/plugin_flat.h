@@ -0,0 +1,66 @@
+#ifndef PLUGIN_FLAT_H
+#define PLUGIN_FLAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "plugin_arena.h"
+
+// Plugin side of the host's flat messages (host/common/flat_message.hpp). Headers generated by plugin_bindgen lay
+// out each message as plain structs that are read in place, and use these helpers to follow their string and
+// list references and to build results in a plugin_arena
+
+// Reference to a string or list: offset from the reference itself to the first element, and the element count
+typedef struct flat_ref {
+    int32_t offset;
+    uint32_t count;
+} flat_ref;
+
+static inline const void* flat_list(const flat_ref* ref, uint32_t* count) {
+    *count = ref->count;
+    return (const uint8_t*)ref + ref->offset;
+}
+
+// Strings are followed by a NUL that `length` leaves out
+static inline const char* flat_string(const flat_ref* ref, uint32_t* length) {
+    *length = ref->count;
+    return ref->count ? (const char*)ref + ref->offset : "";
+}
+
+static inline void flat_ref_set(flat_ref* ref, const void* first, const uint32_t count) {
+    ref->offset = count ? (int32_t)((const uint8_t*)first - (const uint8_t*)ref) : 0;
+    ref->count = count;
+}
+
+// Allocates a zeroed struct from `arena`, or returns NULL if it is full
+static inline void* flat_new(plugin_arena* arena, const size_t size, const size_t align) {
+    void* message = plugin_arena_alloc(arena, size, align);
+    if (message) {
+        memset(message, 0, size);
+    }
+    return message;
+}
+
+// Allocates `count` zeroed elements from `arena` and points `ref` at them, or returns NULL if it is full
+static inline void* flat_init_list(flat_ref* ref, plugin_arena* arena, const size_t size, const size_t align, const uint32_t count) {
+    void* list = flat_new(arena, size * count, align);
+    if (list) {
+        flat_ref_set(ref, list, count);
+    }
+    return list;
+}
+
+// Copies `value` into `arena` and points `ref` at it. Returns 0 if the arena is full
+static inline int flat_set_string(flat_ref* ref, plugin_arena* arena, const char* value, const uint32_t length) {
+    char* copy = plugin_arena_alloc(arena, length + 1, 1);
+    if (!copy) {
+        return 0;
+    }
+    memcpy(copy, value, length);
+    copy[length] = '\0';
+    flat_ref_set(ref, copy, length);
+    return 1;
+}
+
+#endif
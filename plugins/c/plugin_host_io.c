@@ -0,0 +1,88 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "plugin_files.h"
+
+// Exports that need the host's optional env imports, the whole-file imports and host_lookup_batch. Linked with
+// plugin.c into plugin_host_io.wasm, so plugin.wasm itself loads on hosts that do not provide them
+
+// Same as test_file_io() of plugin.c, with each file moved in one call to the host
+void test_bulk_file_io() {
+    const char* filename = "hello_bulk_c.txt";
+    const char* contents = "Hello in bulk from C!";
+    const uint32_t length = (uint32_t)strlen(contents);
+
+    if (plugin_write_file(filename, contents, length) != 0) {
+        fprintf(stderr, "test_bulk_file_io(): Failed to write file\n");
+        return;
+    }
+
+    char read[64];
+    const int64_t size = plugin_read_file(filename, read, sizeof(read));
+    if (size != length || memcmp(read, contents, length) != 0) {
+        fprintf(stderr, "test_bulk_file_io(): File content is not as expected\n");
+        return;
+    }
+    // The last word, read as a window of the file
+    char window[8];
+    const int64_t window_length = plugin_read_file_at(filename, length - 6, window, sizeof(window));
+    if (window_length != 6 || memcmp(window, contents + length - 6, 6) != 0) {
+        fprintf(stderr, "test_bulk_file_io(): File window is not as expected\n");
+        return;
+    }
+    fprintf(stdout, "test_bulk_file_io(): File content is as expected\n");
+}
+
+// Sums the bytes of `filename` read in 64 KiB chunks, through WASI or with the host's file imports. Returns -1
+// if the file cannot be read
+int64_t sum_file_bytes(const char* filename, const int use_file_imports) {
+    static unsigned char chunk[64 * 1024];
+    int64_t total = 0;
+    if (use_file_imports) {
+        int64_t offset = 0;
+        int64_t length;
+        while ((length = plugin_read_file_at(filename, offset, chunk, sizeof(chunk))) > 0) {
+            for (int64_t i = 0; i < length; i++) {
+                total += chunk[i];
+            }
+            offset += length;
+        }
+        return length < 0 ? -1 : total;
+    }
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        return -1;
+    }
+    size_t length;
+    while ((length = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        for (size_t i = 0; i < length; i++) {
+            total += chunk[i];
+        }
+    }
+    fclose(file);
+    return total;
+}
+
+// Looks up the host's value of each of `count` keys in one call
+__attribute__((import_name("host_lookup_batch"))) extern int host_lookup_batch(const int* keys, int count, int* values);
+
+// Sums the host's values of keys 0 to `count` - 1, looked up 256 at a time instead of one host call per key
+int sum_host_lookups(const int count) {
+    int keys[256];
+    int values[256];
+    int total = 0;
+    for (int first = 0; first < count; first += 256) {
+        const int batch = count - first < 256 ? count - first : 256;
+        for (int i = 0; i < batch; i++) {
+            keys[i] = first + i;
+        }
+        if (host_lookup_batch(keys, batch, values) != batch) {
+            return -1;
+        }
+        for (int i = 0; i < batch; i++) {
+            total += values[i];
+        }
+    }
+    return total;
+}
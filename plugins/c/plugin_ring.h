@@ -0,0 +1,81 @@
+#ifndef PLUGIN_RING_H
+#define PLUGIN_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Plugin side of the host's GuestRing (host/common/guest_ring.hpp): a single-producer, single-consumer ring of
+// variable-length records that the host allocates in this plugin's memory and passes in by address
+
+#define PLUGIN_RING_SKIP_MARKER 0xffffffffu
+
+typedef struct plugin_ring {
+    uint32_t capacity;
+    uint8_t padding0[60];
+    // Bytes ever written, only stored by the producer
+    uint32_t head;
+    uint8_t padding1[60];
+    // Bytes ever read, only stored by the consumer
+    uint32_t tail;
+    uint8_t padding2[60];
+    uint8_t data[];
+} plugin_ring;
+
+_Static_assert(offsetof(plugin_ring, head) == 64 && offsetof(plugin_ring, tail) == 128 && offsetof(plugin_ring, data) == 192, "layout must match the host's");
+
+static inline uint32_t plugin_ring_record_size(const uint32_t length) {
+    return (uint32_t)sizeof(uint32_t) + ((length + 3) & ~3u);
+}
+
+// Appends one record. Returns 0 if the ring is too full for it
+static inline int plugin_ring_push(plugin_ring* ring, const void* record, const uint32_t length) {
+    const uint32_t capacity = ring->capacity;
+    if (length > capacity) {
+        return 0;
+    }
+    const uint32_t head = ring->head;
+    const uint32_t needed = plugin_ring_record_size(length);
+    uint32_t position = head & (capacity - 1);
+    const uint32_t skipped = position + needed > capacity ? capacity - position : 0;
+    const uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    if (skipped + needed > capacity || head - tail + skipped + needed > capacity) {
+        return 0;
+    }
+    if (skipped) {
+        const uint32_t marker = PLUGIN_RING_SKIP_MARKER;
+        memcpy(ring->data + position, &marker, sizeof(marker));
+        position = 0;
+    }
+    memcpy(ring->data + position, &length, sizeof(length));
+    memcpy(ring->data + position + sizeof(length), record, length);
+    __atomic_store_n(&ring->head, head + skipped + needed, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// Oldest unread record, or NULL if the ring is empty. It stays valid until plugin_ring_pop()
+static inline const void* plugin_ring_peek(plugin_ring* ring, uint32_t* length) {
+    const uint32_t capacity = ring->capacity;
+    const uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = ring->tail;
+    if (tail == head) {
+        return NULL;
+    }
+    uint32_t position = tail & (capacity - 1);
+    memcpy(length, ring->data + position, sizeof(*length));
+    if (*length == PLUGIN_RING_SKIP_MARKER) {
+        // Skipped space is released right away, the record itself starts at offset 0
+        tail += capacity - position;
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+        position = 0;
+        memcpy(length, ring->data, sizeof(*length));
+    }
+    return ring->data + position + sizeof(uint32_t);
+}
+
+// Frees the record plugin_ring_peek() returned
+static inline void plugin_ring_pop(plugin_ring* ring, const uint32_t length) {
+    __atomic_store_n(&ring->tail, ring->tail + plugin_ring_record_size(length), __ATOMIC_RELEASE);
+}
+
+#endif
@@ -0,0 +1,67 @@
+// Generated by plugin_bindgen from points.schema, do not edit
+#ifndef POINTS_SCHEMA_H
+#define POINTS_SCHEMA_H
+
+#include <stdbool.h>
+
+#include "plugin_flat.h"
+
+typedef struct Point {
+    int32_t x;
+    int32_t y;
+} Point;
+
+_Static_assert(sizeof(Point) == 8 && offsetof(Point, x) == 0 && offsetof(Point, y) == 4, "layout must match the host's");
+
+static inline Point* Point_new(plugin_arena* arena) {
+    return flat_new(arena, sizeof(Point), _Alignof(Point));
+}
+
+typedef struct PointsRequest {
+    flat_ref label; // string
+    flat_ref points; // list<Point>
+} PointsRequest;
+
+_Static_assert(sizeof(PointsRequest) == 16 && offsetof(PointsRequest, label) == 0 && offsetof(PointsRequest, points) == 8, "layout must match the host's");
+
+static inline PointsRequest* PointsRequest_new(plugin_arena* arena) {
+    return flat_new(arena, sizeof(PointsRequest), _Alignof(PointsRequest));
+}
+
+static inline const char* PointsRequest_label(const PointsRequest* message, uint32_t* length) {
+    return flat_string(&message->label, length);
+}
+
+static inline int PointsRequest_set_label(PointsRequest* message, plugin_arena* arena, const char* value, const uint32_t length) {
+    return flat_set_string(&message->label, arena, value, length);
+}
+
+static inline const Point* PointsRequest_points(const PointsRequest* message, uint32_t* count) {
+    return flat_list(&message->points, count);
+}
+
+static inline Point* PointsRequest_init_points(PointsRequest* message, plugin_arena* arena, const uint32_t count) {
+    return flat_init_list(&message->points, arena, sizeof(Point), _Alignof(Point), count);
+}
+
+typedef struct PointsSummary {
+    flat_ref label; // string
+    Point sum;
+    uint32_t count;
+} PointsSummary;
+
+_Static_assert(sizeof(PointsSummary) == 20 && offsetof(PointsSummary, label) == 0 && offsetof(PointsSummary, sum) == 8 && offsetof(PointsSummary, count) == 16, "layout must match the host's");
+
+static inline PointsSummary* PointsSummary_new(plugin_arena* arena) {
+    return flat_new(arena, sizeof(PointsSummary), _Alignof(PointsSummary));
+}
+
+static inline const char* PointsSummary_label(const PointsSummary* message, uint32_t* length) {
+    return flat_string(&message->label, length);
+}
+
+static inline int PointsSummary_set_label(PointsSummary* message, plugin_arena* arena, const char* value, const uint32_t length) {
+    return flat_set_string(&message->label, arena, value, length);
+}
+
+#endif
@@ -0,0 +1,37 @@
+const std = @import("std");
+
+// Plugin side of the host's GuestArena (host/common/guest_arena.hpp): a bump arena the host passes to an export
+// for its results. Nothing allocated from it is ever freed by the plugin, the host resets the whole arena once it
+// has read the results
+
+pub const Arena = extern struct {
+    capacity: u32,
+    // Bytes handed out since the host last reset the arena
+    used: u32,
+    reserved: [2]u32,
+
+    fn data(self: *Arena) [*]u8 {
+        return @as([*]u8, @ptrCast(self)) + @sizeOf(Arena);
+    }
+
+    // Returns `size` bytes aligned to `alignment`, a power of two of at most 16, or null if the arena is full
+    pub fn alloc(self: *Arena, size: usize, alignment: usize) ?[*]u8 {
+        const start = std.mem.alignForward(usize, self.used, alignment);
+        if (start > self.capacity or size > self.capacity - start) {
+            return null;
+        }
+        self.used = @intCast(start + size);
+        return self.data() + start;
+    }
+
+    pub fn dupeZ(self: *Arena, bytes: []const u8) ?[*:0]u8 {
+        const copy = self.alloc(bytes.len + 1, 1) orelse return null;
+        @memcpy(copy[0..bytes.len], bytes);
+        copy[bytes.len] = 0;
+        return @ptrCast(copy);
+    }
+};
+
+comptime {
+    std.debug.assert(@offsetOf(Arena, "used") == 4 and @sizeOf(Arena) == 16);
+}
@@ -0,0 +1,41 @@
+// Whole-file imports of the host (host/common/host_files.hpp). Each moves a whole file, or a window of one, in one
+// call to the host instead of going through WASI. Paths are relative to the host's data directory and cannot
+// leave it
+
+pub const Error = error{ InvalidArgument, NotFound, IoError };
+
+extern "env" fn file_size(path: [*]const u8, path_length: u32) i64;
+extern "env" fn read_file(path: [*]const u8, path_length: u32, buffer: [*]u8, capacity: u32) i64;
+extern "env" fn read_file_at(path: [*]const u8, path_length: u32, offset: i64, buffer: [*]u8, length: u32) i64;
+extern "env" fn write_file(path: [*]const u8, path_length: u32, data: [*]const u8, length: u32) i32;
+
+fn check(result: i64) Error!u64 {
+    return switch (result) {
+        -1 => Error.InvalidArgument,
+        -2 => Error.NotFound,
+        -3 => Error.IoError,
+        else => @intCast(result),
+    };
+}
+
+pub fn size(path: []const u8) Error!u64 {
+    return check(file_size(path.ptr, @intCast(path.len)));
+}
+
+// Copies as much of the file as fits into `buffer` and returns its full size, so a larger result means the
+// buffer was too small
+pub fn read(path: []const u8, buffer: []u8) Error!u64 {
+    return check(read_file(path.ptr, @intCast(path.len), buffer.ptr, @intCast(buffer.len)));
+}
+
+// Copies the window of the file starting at `offset` into `buffer` and returns the part of it that was filled,
+// empty past the end of the file
+pub fn readAt(path: []const u8, offset: u64, buffer: []u8) Error![]u8 {
+    const length = try check(read_file_at(path.ptr, @intCast(path.len), @intCast(offset), buffer.ptr, @intCast(buffer.len)));
+    return buffer[0..@intCast(length)];
+}
+
+// Replaces the file with `data`
+pub fn write(path: []const u8, data: []const u8) Error!void {
+    _ = try check(write_file(path.ptr, @intCast(path.len), data.ptr, @intCast(data.len)));
+}
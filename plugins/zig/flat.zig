@@ -0,0 +1,69 @@
+const arena = @import("arena.zig");
+
+// Plugin side of the host's flat messages (host/common/flat_message.hpp). Files generated by plugin_bindgen lay
+// out each message as extern structs that are read in place, with these references for their strings and lists
+
+fn resolve(ref: anytype) usize {
+    const address: isize = @bitCast(@intFromPtr(ref));
+    return @bitCast(address + ref.offset);
+}
+
+fn offsetTo(ref: anytype, first: usize) i32 {
+    return @intCast(@as(isize, @bitCast(first)) - @as(isize, @bitCast(@intFromPtr(ref))));
+}
+
+// Reference to `count` consecutive elements of type T
+pub fn List(comptime T: type) type {
+    return extern struct {
+        offset: i32,
+        count: u32,
+
+        const Self = @This();
+
+        pub fn items(self: *const Self) []const T {
+            if (self.count == 0) {
+                return &.{};
+            }
+            const first: [*]const T = @ptrFromInt(resolve(self));
+            return first[0..self.count];
+        }
+
+        // Allocates `count` zeroed elements from `results` and points the reference at them
+        pub fn init(self: *Self, results: *arena.Arena, count: u32) ?[]T {
+            const size = @sizeOf(T) * count;
+            const bytes = results.alloc(size, @alignOf(T)) orelse return null;
+            @memset(bytes[0..size], 0);
+            const first: [*]T = @ptrCast(@alignCast(bytes));
+            self.* = .{ .offset = if (count == 0) 0 else offsetTo(self, @intFromPtr(first)), .count = count };
+            return first[0..count];
+        }
+    };
+}
+
+// Reference to a string, which is followed by a NUL that `count` leaves out
+pub const String = extern struct {
+    offset: i32,
+    count: u32,
+
+    pub fn slice(self: *const String) []const u8 {
+        if (self.count == 0) {
+            return "";
+        }
+        const first: [*]const u8 = @ptrFromInt(resolve(self));
+        return first[0..self.count];
+    }
+
+    // Copies `value` into `results` and points the reference at it. Returns false if the arena is full
+    pub fn set(self: *String, results: *arena.Arena, value: []const u8) bool {
+        const copy = results.dupeZ(value) orelse return false;
+        self.* = .{ .offset = if (value.len == 0) 0 else offsetTo(self, @intFromPtr(copy)), .count = @intCast(value.len) };
+        return true;
+    }
+};
+
+// Allocates a zeroed T from `results`, or returns null if it is full
+pub fn new(comptime T: type, results: *arena.Arena) ?*T {
+    const bytes = results.alloc(@sizeOf(T), @alignOf(T)) orelse return null;
+    @memset(bytes[0..@sizeOf(T)], 0);
+    return @ptrCast(@alignCast(bytes));
+}
@@ -2,26 +2,98 @@ const std = @import("std");
 const io = std.io;
 const fs = std.fs;
 const process = std.process;
+const arena = @import("arena.zig");
+const flat = @import("flat.zig");
+const points = @import("points_schema.zig");
+const ring = @import("ring.zig");
 
 var general_purpose_allocator: std.heap.GeneralPurposeAllocator(.{}) = .init;
 const gpa = general_purpose_allocator.allocator();
 
+var cached_preopens: ?fs.wasi.Preopens = null;
+
+// Run once before the host snapshots the plugin, so every instance starts out with the preopens resolved
+export fn plugin_init() void {
+    cached_preopens = fs.wasi.preopensAlloc(gpa) catch null;
+}
+
+// The directory the host maps as ".", null if the host maps none
+pub fn dataDir() ?fs.Dir {
+    if (cached_preopens == null) {
+        cached_preopens = fs.wasi.preopensAlloc(gpa) catch return null;
+    }
+    const preopens = cached_preopens.?;
+    // wasmer includes the null-terminator in the name
+    const fd = preopens.find(".") orelse preopens.find(".\x00") orelse return null;
+    return fs.Dir{ .fd = fd };
+}
+
 export fn sum(x: i32, y: i32) i32 {
     return x + y;
 }
 
-export fn get_heap_allocated_string() [*c]const u8 {
-    const str = "Greetings from the Zig plugin!";
-    const heap_str = gpa.dupeZ(u8, str) catch return null;
-    return heap_str.ptr;
+// Exports whose result only depends on their arguments, one per line. The host answers repeated calls of them from
+// its result cache without calling into the plugin
+comptime {
+    asm (
+        \\.section .custom_section.plugin.pure,"",@
+        \\.ascii "sum\n"
+        \\.text
+    );
+}
+
+// Sums `count` (x, y) pairs packed back to back in `pairs`, amortizing one call over the whole batch
+export fn sum_batch(pairs: [*]const i32, count: usize, results: [*]i32) void {
+    for (0..count) |i| {
+        results[i] = sum(pairs[2 * i], pairs[2 * i + 1]);
+    }
+}
+
+// Sums every (x, y) pair the host queued in `requests` and queues the results in `responses`, one call for any
+// number of records. Stops early once `responses` is full and returns how many pairs it summed
+export fn sum_ring(requests: *ring.Ring, responses: *ring.Ring) i32 {
+    var count: i32 = 0;
+    while (requests.peek()) |record| {
+        var result: i32 = 0;
+        if (record.len == 8) {
+            result = sum(std.mem.readInt(i32, record[0..4], .little), std.mem.readInt(i32, record[4..8], .little));
+        }
+        if (!responses.push(std.mem.asBytes(&result))) {
+            break;
+        }
+        requests.pop(record);
+        count += 1;
+    }
+    return count;
+}
+
+// The string lives in the host's arena, which the host resets once it has read it
+export fn get_arena_string(results: *arena.Arena) ?[*:0]const u8 {
+    return results.dupeZ("Greetings from the Zig plugin!");
 }
 
-export fn free_heap_allocated_string(heap_str: [*c]u8) void {
-    var str: [:0]u8 = std.mem.span(heap_str);
-    for (0..str.len) |i| {
-        str[i] = 0;
+// Sums the points of `request`, read in place, into a PointsSummary allocated from `results`. Returns null if
+// `results` is full
+export fn sum_points(request: *const points.PointsRequest, results: *arena.Arena) ?*points.PointsSummary {
+    const summary = flat.new(points.PointsSummary, results) orelse return null;
+    for (request.points.items()) |point| {
+        summary.sum.x +%= point.x;
+        summary.sum.y +%= point.y;
+    }
+    summary.count = request.points.count;
+    if (!summary.label.set(results, request.label.slice())) {
+        return null;
     }
-    gpa.free(str);
+    return summary;
+}
+
+export fn plugin_alloc(size: usize) ?[*]u8 {
+    const buffer = gpa.alloc(u8, size) catch return null;
+    return buffer.ptr;
+}
+
+export fn plugin_free(ptr: [*]u8, size: usize) void {
+    gpa.free(ptr[0..size]);
 }
 
 export fn test_print() void {
@@ -33,7 +105,7 @@ export fn test_file_io() void {
     var arena_instance = std.heap.ArenaAllocator.init(gpa);
     defer arena_instance.deinit();
     const arena = arena_instance.allocator();
-    const preopens = fs.wasi.preopensAlloc(arena) catch return;
+    const preopens = cached_preopens orelse (fs.wasi.preopensAlloc(arena) catch return);
 
     std.debug.print("Preopens:\n", .{});
     for (preopens.names, 0..) |name, i| {
@@ -77,3 +149,13 @@ extern fn host_fn() i32;
 export fn test_host_fn() void {
     io.getStdOut().writer().print("test_host_fn(): Got value: {d}", .{host_fn()}) catch return;
 }
+
+// Calls back into the host `count` times, used to measure guest to host call cost
+export fn sum_host_fn(count: i32) i32 {
+    var total: i32 = 0;
+    var i: i32 = 0;
+    while (i < count) : (i += 1) {
+        total +%= host_fn();
+    }
+    return total;
+}
@@ -0,0 +1,95 @@
+// Exports that need the host's optional env imports, the whole-file imports and host_lookup_batch, on top of
+// those of plugin.zig. Built into plugin_host_io.wasm, so plugin.wasm itself loads on hosts that do not provide them
+const std = @import("std");
+const files = @import("files.zig");
+const plugin = @import("plugin.zig");
+
+comptime {
+    // Exports every function of the base plugin as well
+    _ = plugin;
+}
+
+// Same as test_file_io() of plugin.zig, with each file moved in one call to the host
+export fn test_bulk_file_io() void {
+    const filename = "hello_bulk_zig.txt";
+    const contents = "Hello in bulk from Zig!";
+
+    files.write(filename, contents) catch {
+        std.debug.print("test_bulk_file_io(): Failed to write file\n", .{});
+        return;
+    };
+
+    var read_contents: [64]u8 = undefined;
+    const size = files.read(filename, &read_contents) catch 0;
+    if (size != contents.len or !std.mem.eql(u8, contents, read_contents[0..contents.len])) {
+        std.debug.print("test_bulk_file_io(): File content is not as expected\n", .{});
+        return;
+    }
+    // The last word, read as a window of the file
+    var window: [8]u8 = undefined;
+    const last_word = files.readAt(filename, contents.len - 4, &window) catch window[0..0];
+    if (!std.mem.eql(u8, contents[contents.len - 4 ..], last_word)) {
+        std.debug.print("test_bulk_file_io(): File window is not as expected\n", .{});
+        return;
+    }
+    std.debug.print("test_bulk_file_io(): File content is as expected\n", .{});
+}
+
+var file_chunk: [64 * 1024]u8 = undefined;
+
+// Sums the bytes of `filename` read in 64 KiB chunks, through WASI or with the host's file imports. Returns -1
+// if the file cannot be read
+export fn sum_file_bytes(filename: [*:0]const u8, use_file_imports: i32) i64 {
+    const name = std.mem.span(filename);
+    var total: i64 = 0;
+    if (use_file_imports != 0) {
+        var offset: u64 = 0;
+        while (true) {
+            const chunk = files.readAt(name, offset, &file_chunk) catch return -1;
+            if (chunk.len == 0) {
+                return total;
+            }
+            for (chunk) |byte| {
+                total += byte;
+            }
+            offset += chunk.len;
+        }
+    }
+
+    const dir = plugin.dataDir() orelse return -1;
+    const file = dir.openFile(name, .{}) catch return -1;
+    defer file.close();
+    while (true) {
+        const length = file.read(&file_chunk) catch return -1;
+        if (length == 0) {
+            return total;
+        }
+        for (file_chunk[0..length]) |byte| {
+            total += byte;
+        }
+    }
+}
+
+// Looks up the host's value of each of `count` keys in one call
+extern fn host_lookup_batch(keys: [*]const i32, count: i32, values: [*]i32) i32;
+
+// Sums the host's values of keys 0 to `count` - 1, looked up 256 at a time instead of one host call per key
+export fn sum_host_lookups(count: i32) i32 {
+    var keys: [256]i32 = undefined;
+    var values: [256]i32 = undefined;
+    var total: i32 = 0;
+    var first: i32 = 0;
+    while (first < count) : (first += keys.len) {
+        const batch = @min(count - first, keys.len);
+        for (keys[0..@intCast(batch)], 0..) |*key, i| {
+            key.* = first + @as(i32, @intCast(i));
+        }
+        if (host_lookup_batch(&keys, batch, &values) != batch) {
+            return -1;
+        }
+        for (values[0..@intCast(batch)]) |value| {
+            total +%= value;
+        }
+    }
+    return total;
+}
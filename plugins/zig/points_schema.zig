@@ -0,0 +1,32 @@
+// Generated by plugin_bindgen from points.schema, do not edit
+const std = @import("std");
+const flat = @import("flat.zig");
+
+pub const Point = extern struct {
+    x: i32,
+    y: i32,
+};
+
+pub const PointsRequest = extern struct {
+    label: flat.String,
+    points: flat.List(Point),
+};
+
+pub const PointsSummary = extern struct {
+    label: flat.String,
+    sum: Point,
+    count: u32,
+};
+
+comptime {
+    std.debug.assert(@sizeOf(Point) == 8);
+    std.debug.assert(@offsetOf(Point, "x") == 0);
+    std.debug.assert(@offsetOf(Point, "y") == 4);
+    std.debug.assert(@sizeOf(PointsRequest) == 16);
+    std.debug.assert(@offsetOf(PointsRequest, "label") == 0);
+    std.debug.assert(@offsetOf(PointsRequest, "points") == 8);
+    std.debug.assert(@sizeOf(PointsSummary) == 20);
+    std.debug.assert(@offsetOf(PointsSummary, "label") == 0);
+    std.debug.assert(@offsetOf(PointsSummary, "sum") == 8);
+    std.debug.assert(@offsetOf(PointsSummary, "count") == 16);
+}
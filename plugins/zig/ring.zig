@@ -0,0 +1,80 @@
+const std = @import("std");
+
+// Plugin side of the host's GuestRing (host/common/guest_ring.hpp): a single-producer, single-consumer ring of
+// variable-length records that the host allocates in this plugin's memory and passes in by address
+
+pub const skip_marker: u32 = 0xffff_ffff;
+
+pub const Ring = extern struct {
+    capacity: u32,
+    padding0: [60]u8,
+    // Bytes ever written, only stored by the producer
+    head: u32,
+    padding1: [60]u8,
+    // Bytes ever read, only stored by the consumer
+    tail: u32,
+    padding2: [60]u8,
+
+    fn data(self: *Ring) [*]u8 {
+        return @as([*]u8, @ptrCast(self)) + @sizeOf(Ring);
+    }
+
+    fn recordSize(length: u32) u32 {
+        return 4 + ((length + 3) & ~@as(u32, 3));
+    }
+
+    // Appends one record. Returns false if the ring is too full for it
+    pub fn push(self: *Ring, record: []const u8) bool {
+        const capacity = self.capacity;
+        if (record.len > capacity) {
+            return false;
+        }
+        const length: u32 = @intCast(record.len);
+        const head = self.head;
+        const needed = recordSize(length);
+        var position = head & (capacity - 1);
+        const skipped: u32 = if (position + needed > capacity) capacity - position else 0;
+        const tail = @atomicLoad(u32, &self.tail, .acquire);
+        if (skipped + needed > capacity or (head -% tail) + skipped + needed > capacity) {
+            return false;
+        }
+        const bytes = self.data();
+        if (skipped != 0) {
+            std.mem.writeInt(u32, bytes[position..][0..4], skip_marker, .little);
+            position = 0;
+        }
+        std.mem.writeInt(u32, bytes[position..][0..4], length, .little);
+        @memcpy(bytes[position + 4 ..][0..record.len], record);
+        @atomicStore(u32, &self.head, head +% skipped +% needed, .release);
+        return true;
+    }
+
+    // Oldest unread record, or null if the ring is empty. It stays valid until pop()
+    pub fn peek(self: *Ring) ?[]const u8 {
+        const capacity = self.capacity;
+        const head = @atomicLoad(u32, &self.head, .acquire);
+        const tail = self.tail;
+        if (tail == head) {
+            return null;
+        }
+        const bytes = self.data();
+        var position = tail & (capacity - 1);
+        var length = std.mem.readInt(u32, bytes[position..][0..4], .little);
+        if (length == skip_marker) {
+            // Skipped space is released right away, the record itself starts at offset 0
+            @atomicStore(u32, &self.tail, tail +% (capacity - position), .release);
+            position = 0;
+            length = std.mem.readInt(u32, bytes[0..4], .little);
+        }
+        return bytes[position + 4 ..][0..length];
+    }
+
+    // Frees the record peek() returned
+    pub fn pop(self: *Ring, record: []const u8) void {
+        @atomicStore(u32, &self.tail, self.tail +% recordSize(@intCast(record.len)), .release);
+    }
+};
+
+comptime {
+    std.debug.assert(@offsetOf(Ring, "head") == 64 and @offsetOf(Ring, "tail") == 128 and @sizeOf(Ring) == 192);
+}